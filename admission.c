@@ -0,0 +1,55 @@
+#include "admission.h"
+
+void admission_init(struct admission *admission, uint64_t rate, int max_lobby, uint64_t now) {
+    admission->rate = rate;
+    admission->capacity = rate * ADMISSION_BURST_MS * 1000;
+    if (rate > 0 && admission->capacity < 1000000) {
+        admission->capacity = 1000000; // Always let at least one connection through
+    }
+    admission->tokens = admission->capacity;
+    admission->refilled = now;
+    admission->max_lobby = max_lobby;
+    admission->shed = 0;
+    admission->reported = now;
+}
+
+// Admit a new connection if the lobby has room and the bucket has a token for it, otherwise count it as shed.
+// Tokens are kept in millionths so a rate below one connection per microsecond still refills smoothly
+enum admission_result admission_check(struct admission *admission, int lobby_players, uint64_t now) {
+    if (lobby_players >= admission->max_lobby) {
+        admission->shed++;
+        return SHED_LOBBY_FULL;
+    }
+    if (admission->rate == 0) {
+        return ADMIT;
+    }
+
+    if (now > admission->refilled) {
+        uint64_t tokens = admission->tokens + (now - admission->refilled) * admission->rate;
+        admission->tokens = tokens < admission->capacity ? tokens : admission->capacity;
+        admission->refilled = now;
+    }
+    if (admission->tokens < 1000000) {
+        admission->shed++;
+        return SHED_RATE;
+    }
+    admission->tokens -= 1000000;
+    return ADMIT;
+}
+
+// Count a connection shed without a check, such as one the worker had no descriptor to accept
+void admission_count_shed(struct admission *admission) {
+    admission->shed++;
+}
+
+// The number shed since the last report once ADMISSION_REPORT_MS has passed, so rejections are logged
+// once a second rather than once per connection. Returns 0 while it isn't time to report
+uint64_t admission_take_report(struct admission *admission, uint64_t now) {
+    if (admission->shed == 0 || now - admission->reported < (uint64_t)ADMISSION_REPORT_MS * 1000) {
+        return 0;
+    }
+    uint64_t shed = admission->shed;
+    admission->shed = 0;
+    admission->reported = now;
+    return shed;
+}
@@ -0,0 +1,36 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>     // Fixed width integer types (uint64_t)
+
+#define ADMISSION_BURST_MS 100 // A worker can admit this many milliseconds worth of its rate at once
+#define ADMISSION_REPORT_MS 1000 // Shed connections are logged as one line at most this often
+
+// Why a new connection was turned away
+enum admission_result {
+    ADMIT,
+    SHED_LOBBY_FULL,    // The worker already has as many players outside games as it takes
+    SHED_RATE           // Connections are arriving faster than the admission rate
+};
+
+// Decides per worker, without locks, whether a connection just accepted is let into the lobby.
+// A token bucket holds the rate of new players at what the worker can take on, so a burst of
+// connects is turned away with a single send and close instead of crowding out games in progress
+struct admission {
+    uint64_t rate;          // Connections admitted per second, 0 for no limit
+    uint64_t tokens;        // Connections the bucket holds right now, in millionths
+    uint64_t capacity;      // Largest burst, in millionths
+    uint64_t refilled;      // metrics_now_us() of the last refill
+    int max_lobby;          // Players allowed in the lobby at once
+
+    uint64_t shed;          // Shed since the last report
+    uint64_t reported;      // metrics_now_us() of the last report
+};
+
+// Function Declarations
+void admission_init(struct admission *admission, uint64_t rate, int max_lobby, uint64_t now);
+enum admission_result admission_check(struct admission *admission, int lobby_players, uint64_t now);
+void admission_count_shed(struct admission *admission);
+uint64_t admission_take_report(struct admission *admission, uint64_t now);
+
+#endif
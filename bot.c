@@ -0,0 +1,68 @@
+#include <stdio.h>      // Name formatting (snprintf)
+#include <stdlib.h>     // Standard library functions (calloc, free)
+#include <string.h>     // String manipulation functions (strncmp)
+#include "bot.h"
+
+// Bots are named after the slot they fill
+static const char *bot_names[] = {
+    BOT_NAME_PREFIX "Ada", BOT_NAME_PREFIX "Alan", BOT_NAME_PREFIX "Grace", BOT_NAME_PREFIX "Edsger",
+    BOT_NAME_PREFIX "Barbara", BOT_NAME_PREFIX "Ken", BOT_NAME_PREFIX "Dennis", BOT_NAME_PREFIX "Frances",
+    BOT_NAME_PREFIX "John", BOT_NAME_PREFIX "Margaret", BOT_NAME_PREFIX "Donald", BOT_NAME_PREFIX "Radia",
+    BOT_NAME_PREFIX "Niklaus", BOT_NAME_PREFIX "Sophie", BOT_NAME_PREFIX "Tony", BOT_NAME_PREFIX "Hedy"
+};
+
+#define BOT_NAME_COUNT (int)(sizeof(bot_names) / sizeof(bot_names[0]))
+
+// A bot for slot of room, playing a goal word of length letters. on_think is called with the bot each time
+// its think timer fires. Returns NULL if memory ran out
+struct bot *bot_create(struct room *room, int slot, int length, reactor_timer_callback on_think) {
+    struct bot *bot = calloc(1, sizeof(struct bot));
+    if (bot == NULL) {
+        return NULL;
+    }
+    bot->room = room;
+    bot->slot = slot;
+    // The names repeat every BOT_NAME_COUNT slots, so bots past the first few are told apart by their slot number
+    if (slot < BOT_NAME_COUNT) {
+        snprintf(bot->name, sizeof(bot->name), "%s", bot_names[slot]);
+    } else {
+        snprintf(bot->name, sizeof(bot->name), "%s %d", bot_names[slot % BOT_NAME_COUNT], slot);
+    }
+    bot->length = length;
+    reactor_timer_init(&bot->think_timer, on_think, bot);
+    return bot;
+}
+
+// The think timer must already be cancelled
+void bot_destroy(struct bot *bot) {
+    if (bot == NULL) {
+        return;
+    }
+    dictionary_filter_free(&bot->filter);
+    free(bot);
+}
+
+// The letter the bot guesses next, or 0 if it has guessed them all
+char bot_next_guess(struct bot *bot) {
+    return dictionary_next_guess(&bot->filter, bot->pattern, bot->length, bot->guessed, bot->wrong);
+}
+
+// Take in what a guess revealed: the positions of the letter, 0 if it isn't in the word
+void bot_observe(struct bot *bot, char guess, uint64_t revealed) {
+    uint32_t letter = 1u << (guess - 'A');
+    bot->guessed |= letter;
+    if (revealed == 0) {
+        bot->wrong |= letter;
+    }
+    for (int i = 0; i < bot->length; i++) {
+        if ((revealed >> i) & 1) {
+            bot->pattern[i] = guess;
+        }
+    }
+}
+
+// Whether name could be mistaken for a bot. Bots never go through the name table, so their names are kept
+// apart by refusing the prefix to humans instead
+int bot_name_reserved(const char *name) {
+    return strncmp(name, BOT_NAME_PREFIX, sizeof(BOT_NAME_PREFIX) - 1) == 0;
+}
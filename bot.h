@@ -0,0 +1,35 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <stdint.h>     // Fixed width integer types (uint32_t)
+#include "game.h"       // Longest goal word (MAX_WORD_LENGTH)
+#include "reactor.h"    // Think timer
+#include "dictionary.h" // Candidate words
+
+#define BOT_NAME_PREFIX "[bot] " // Every bot name starts with this, and no human may register one that does
+#define BOT_NAME_SIZE 24          // Longest bot name, slot number included, with the terminating NUL
+
+struct room;
+
+// A server side player seated in a slot no human took. It guesses on its think timer, working out the
+// letter from the dictionary words that still fit what its guesses have revealed
+struct bot {
+    struct room *room;
+    int slot;
+    char name[BOT_NAME_SIZE];           // Shown in the room's player names while the bot is seated
+    int length;                         // Goal word length
+    char pattern[MAX_WORD_LENGTH + 1];  // Letters revealed so far, '\0' where hidden
+    uint32_t guessed;                   // Letters guessed, bit c - 'A' for letter c
+    uint32_t wrong;                     // Guessed letters that aren't in the word
+    struct dictionary_filter filter;
+    struct reactor_timer think_timer;   // Armed until the bot has finished
+};
+
+// Function Declarations
+struct bot *bot_create(struct room *room, int slot, int length, reactor_timer_callback on_think);
+void bot_destroy(struct bot *bot);
+char bot_next_guess(struct bot *bot);
+void bot_observe(struct bot *bot, char guess, uint64_t revealed);
+int bot_name_reserved(const char *name);
+
+#endif
@@ -0,0 +1,312 @@
+#include <stdlib.h>     // Standard library functions (malloc, realloc, free)
+#include <string.h>     // String manipulation functions (memcpy)
+#include <errno.h>      // Error codes (EAGAIN, EWOULDBLOCK, EINTR)
+#include <sys/uio.h>    // Scatter input and gather output (struct iovec)
+#include "buffer.h"
+#include "reactor.h"    // Socket reads and writes through the event loop backend
+
+#define INPUT_BUFFER_MASK (INPUT_BUFFER_SIZE - 1)
+
+void input_buffer_init(struct input_buffer *buffer) {
+    buffer->head = 0;
+    buffer->tail = 0;
+}
+
+unsigned int input_buffer_used(const struct input_buffer *buffer) {
+    return buffer->tail - buffer->head;
+}
+
+// Read as much as the socket has into the free space of the ring. The free space may wrap around
+// the end of the array, so both parts are filled by a single reactor_readv() call.
+// peer_closed is set once the event loop has reported a hang up, the socket is then read until end of stream
+enum input_status input_buffer_fill(struct input_buffer *buffer, struct reactor *reactor, int sd, int peer_closed) {
+    for (;;) {
+        unsigned int free_space = INPUT_BUFFER_SIZE - input_buffer_used(buffer);
+        if (free_space == 0) {
+            return INPUT_FULL;
+        }
+
+        unsigned int start = buffer->tail & INPUT_BUFFER_MASK;
+        unsigned int first_part = INPUT_BUFFER_SIZE - start;
+        if (first_part > free_space) {
+            first_part = free_space;
+        }
+
+        struct iovec parts[2];
+        parts[0].iov_base = buffer->data + start;
+        parts[0].iov_len = first_part;
+        parts[1].iov_base = buffer->data;
+        parts[1].iov_len = free_space - first_part;
+
+        ssize_t valread = reactor_readv(reactor, sd, parts, parts[1].iov_len > 0 ? 2 : 1);
+        if (valread < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return INPUT_DRAINED;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return INPUT_CLOSED;
+        }
+        if (valread == 0) {
+            return INPUT_CLOSED;
+        }
+
+        buffer->tail += (unsigned int)valread;
+
+        // A short read means the socket buffer is empty, skip the extra call that would return EAGAIN.
+        // After a hang up that extra call is the one that sees the end of stream, so it can't be skipped
+        if ((unsigned int)valread < free_space && !peer_closed) {
+            return INPUT_DRAINED;
+        }
+    }
+}
+
+// Frame a single byte. Returns 1 if a byte was taken, 0 if the buffer is empty
+int input_buffer_next_byte(struct input_buffer *buffer, char *byte) {
+    if (buffer->head == buffer->tail) {
+        return 0;
+    }
+    *byte = buffer->data[buffer->head & INPUT_BUFFER_MASK];
+    buffer->head++;
+    return 1;
+}
+
+// Copy the next count bytes without consuming them. Returns 1 if they have all arrived, 0 otherwise
+int input_buffer_peek(const struct input_buffer *buffer, void *out, unsigned int count) {
+    if (input_buffer_used(buffer) < count) {
+        return 0;
+    }
+
+    unsigned int start = buffer->head & INPUT_BUFFER_MASK;
+    unsigned int first_part = INPUT_BUFFER_SIZE - start;
+    if (first_part > count) {
+        first_part = count;
+    }
+
+    memcpy(out, buffer->data + start, first_part);
+    memcpy((char *)out + first_part, buffer->data, count - first_part);
+    return 1;
+}
+
+// Drop count bytes that have already been looked at with input_buffer_peek()
+void input_buffer_skip(struct input_buffer *buffer, unsigned int count) {
+    buffer->head += count;
+}
+
+// Frame exactly count bytes. Returns 1 if they were taken, 0 if fewer have arrived so far
+int input_buffer_next_bytes(struct input_buffer *buffer, void *out, unsigned int count) {
+    if (!input_buffer_peek(buffer, out, count)) {
+        return 0;
+    }
+    buffer->head += count;
+    return 1;
+}
+
+// Frame a newline terminated message into line (NUL terminated, without the "\n" or "\r\n").
+// Lines longer than line_size - 1 are truncated. If the ring is full without a newline its
+// contents are returned as one line so a client can't stall its connection.
+// Returns the line length, or -1 if no complete line has arrived yet
+int input_buffer_next_line(struct input_buffer *buffer, char *line, int line_size) {
+    unsigned int used = input_buffer_used(buffer);
+    unsigned int frame_length = 0;
+    int found = 0;
+
+    for (unsigned int i = 0; i < used; i++) {
+        if (buffer->data[(buffer->head + i) & INPUT_BUFFER_MASK] == '\n') {
+            frame_length = i;
+            found = 1;
+            break;
+        }
+    }
+
+    if (!found) {
+        if (used < INPUT_BUFFER_SIZE) {
+            return -1; // Partial line, wait for the rest
+        }
+        frame_length = used;
+    }
+
+    int length = 0;
+    for (unsigned int i = 0; i < frame_length && length < line_size - 1; i++) {
+        line[length++] = buffer->data[(buffer->head + i) & INPUT_BUFFER_MASK];
+    }
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    line[length] = '\0';
+
+    buffer->head += frame_length + (found ? 1 : 0);
+    return length;
+}
+
+void output_queue_init(struct output_queue *queue) {
+    memset(queue, 0, sizeof(*queue));
+}
+
+// A shared chunk with a single reference, held by whoever is filling it
+struct output_chunk *output_chunk_create_shared(int capacity) {
+    struct output_chunk *chunk = malloc(sizeof(struct output_chunk) + capacity);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->length = 0;
+    chunk->capacity = capacity;
+    chunk->refs = 1;
+    return chunk;
+}
+
+// Drop a reference to a shared chunk, freeing it with the last one
+void output_chunk_release(struct output_chunk *chunk) {
+    if (--chunk->refs == 0) {
+        free(chunk);
+    }
+}
+
+// Let go of a chunk that has been written or is being thrown away
+static void drop_chunk(struct output_chunk *chunk) {
+    if (chunk->refs > 0) {
+        output_chunk_release(chunk);
+    } else {
+        free(chunk);
+    }
+}
+
+void output_queue_destroy(struct output_queue *queue) {
+    for (int i = 0; i < queue->count; i++) {
+        drop_chunk(queue->chunks[(queue->head + i) & (queue->capacity - 1)]);
+    }
+    free(queue->chunks);
+    free(queue->spare);
+    memset(queue, 0, sizeof(*queue));
+}
+
+// Double the ring, copying the queued chunks to the front so they stay in order
+static int grow_ring(struct output_queue *queue) {
+    int new_capacity = queue->capacity > 0 ? queue->capacity * 2 : 8;
+    struct output_chunk **chunks = malloc(new_capacity * sizeof(struct output_chunk *));
+    if (chunks == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < queue->count; i++) {
+        chunks[i] = queue->chunks[(queue->head + i) & (queue->capacity - 1)];
+    }
+    free(queue->chunks);
+    queue->chunks = chunks;
+    queue->head = 0;
+    queue->capacity = new_capacity;
+    return 0;
+}
+
+// Queue length bytes to be written. Returns 0, or -1 if memory ran out
+int output_queue_append(struct output_queue *queue, const void *data, int length) {
+    if (length <= 0) {
+        return 0;
+    }
+
+    // Pack the message into the newest chunk if it fits. Shared chunks are read only once queued
+    if (queue->count > 0) {
+        struct output_chunk *tail = queue->chunks[(queue->head + queue->count - 1) & (queue->capacity - 1)];
+        if (tail->refs == 0 && tail->capacity - tail->length >= length) {
+            memcpy(tail->data + tail->length, data, length);
+            tail->length += length;
+            queue->pending += length;
+            return 0;
+        }
+    }
+
+    if (queue->count == queue->capacity && grow_ring(queue) < 0) {
+        return -1;
+    }
+
+    struct output_chunk *chunk;
+    if (queue->spare != NULL && length <= OUTPUT_CHUNK_SIZE) {
+        chunk = queue->spare;
+        queue->spare = NULL;
+    } else {
+        int capacity = length > OUTPUT_CHUNK_SIZE ? length : OUTPUT_CHUNK_SIZE;
+        chunk = malloc(sizeof(struct output_chunk) + capacity);
+        if (chunk == NULL) {
+            return -1;
+        }
+        chunk->capacity = capacity;
+        chunk->refs = 0;
+    }
+
+    memcpy(chunk->data, data, length);
+    chunk->length = length;
+    queue->chunks[(queue->head + queue->count) & (queue->capacity - 1)] = chunk;
+    queue->count++;
+    queue->pending += length;
+    return 0;
+}
+
+// Queue a reference to a shared chunk instead of a copy of its bytes. Returns 0, or -1 if memory ran out
+int output_queue_append_shared(struct output_queue *queue, struct output_chunk *chunk) {
+    if (chunk->length == 0) {
+        return 0;
+    }
+    if (queue->count == queue->capacity && grow_ring(queue) < 0) {
+        return -1;
+    }
+
+    chunk->refs++;
+    queue->chunks[(queue->head + queue->count) & (queue->capacity - 1)] = chunk;
+    queue->count++;
+    queue->pending += chunk->length;
+    return 0;
+}
+
+// Drop the oldest chunk once it has been written
+static void pop_chunk(struct output_queue *queue) {
+    struct output_chunk *chunk = queue->chunks[queue->head];
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->count--;
+    queue->offset = 0;
+
+    if (queue->spare == NULL && chunk->refs == 0 && chunk->capacity == OUTPUT_CHUNK_SIZE) {
+        queue->spare = chunk;
+    } else {
+        drop_chunk(chunk);
+    }
+}
+
+// Write as much of the queue as the socket takes without blocking, up to OUTPUT_MAX_IOVECS chunks per reactor_writev()
+enum output_status output_queue_flush(struct output_queue *queue, struct reactor *reactor, int sd) {
+    while (queue->count > 0) {
+        struct iovec parts[OUTPUT_MAX_IOVECS];
+        int part_count = 0;
+
+        for (; part_count < queue->count && part_count < OUTPUT_MAX_IOVECS; part_count++) {
+            struct output_chunk *chunk = queue->chunks[(queue->head + part_count) & (queue->capacity - 1)];
+            int skip = part_count == 0 ? queue->offset : 0;
+            parts[part_count].iov_base = chunk->data + skip;
+            parts[part_count].iov_len = chunk->length - skip;
+        }
+
+        ssize_t written = reactor_writev(reactor, sd, parts, part_count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return OUTPUT_PENDING;
+            }
+            return OUTPUT_ERROR;
+        }
+
+        queue->pending -= written;
+        while (written > 0) {
+            struct output_chunk *chunk = queue->chunks[queue->head];
+            int remaining = chunk->length - queue->offset;
+            if (written < remaining) {
+                queue->offset += written;
+                break;
+            }
+            written -= remaining;
+            pop_chunk(queue);
+        }
+    }
+    return OUTPUT_FLUSHED;
+}
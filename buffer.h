@@ -0,0 +1,74 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stddef.h>     // Size type (size_t)
+
+struct reactor;
+
+#define INPUT_BUFFER_SIZE 512 // Must be a power of two, positions wrap with a mask
+#define OUTPUT_CHUNK_SIZE 4096         // Small messages are packed together into chunks of this size
+#define OUTPUT_HIGH_WATER (256 * 1024) // Unsent bytes allowed before a client counts as a slow consumer
+#define OUTPUT_MAX_IOVECS 64           // Chunks handed to a single writev() call
+
+// Result of reading a socket into an input buffer
+enum input_status {
+    INPUT_DRAINED, // Everything the socket had has been read
+    INPUT_FULL,    // The buffer filled up, the socket may have more to read
+    INPUT_CLOSED   // The peer disconnected or the socket failed
+};
+
+// Result of writing an output queue to a socket
+enum output_status {
+    OUTPUT_FLUSHED, // Everything queued has been written
+    OUTPUT_PENDING, // The socket is full, the rest goes out when it becomes writable
+    OUTPUT_ERROR    // The peer disconnected or the socket failed
+};
+
+// Per connection ring buffer. head and tail are free running counters, so head == tail means empty
+// and tail - head is the number of buffered bytes
+struct input_buffer {
+    char data[INPUT_BUFFER_SIZE];
+    unsigned int head;  // Next byte to be framed
+    unsigned int tail;  // Next byte to be written by recv
+};
+
+// A block of bytes waiting to be written. A shared chunk is queued on many connections at once, such as
+// the events a room sends to all of its spectators, and is freed once the last reference is dropped
+struct output_chunk {
+    int length;        // Bytes written into data
+    int capacity;
+    int refs;          // References to a shared chunk, 0 for a chunk owned by a single queue
+    unsigned char data[];
+};
+
+// Per connection queue of output chunks, written oldest first with writev() when the socket is writable.
+// Messages are appended to the newest chunk while it has room, so a burst of small messages costs one
+// write instead of one per message
+struct output_queue {
+    struct output_chunk **chunks;   // Ring of queued chunks
+    int head;                       // Oldest chunk
+    int count;
+    int capacity;                   // Size of the ring, a power of two
+    int offset;                     // Bytes of the oldest chunk already written
+    size_t pending;                 // Bytes queued and not yet written
+    struct output_chunk *spare;     // Emptied chunk kept to save an allocation on the next message
+};
+
+// Function Declarations
+void input_buffer_init(struct input_buffer *buffer);
+unsigned int input_buffer_used(const struct input_buffer *buffer);
+enum input_status input_buffer_fill(struct input_buffer *buffer, struct reactor *reactor, int sd, int peer_closed);
+int input_buffer_peek(const struct input_buffer *buffer, void *out, unsigned int count);
+void input_buffer_skip(struct input_buffer *buffer, unsigned int count);
+int input_buffer_next_byte(struct input_buffer *buffer, char *byte);
+int input_buffer_next_bytes(struct input_buffer *buffer, void *out, unsigned int count);
+int input_buffer_next_line(struct input_buffer *buffer, char *line, int line_size);
+void output_queue_init(struct output_queue *queue);
+void output_queue_destroy(struct output_queue *queue);
+int output_queue_append(struct output_queue *queue, const void *data, int length);
+int output_queue_append_shared(struct output_queue *queue, struct output_chunk *chunk);
+struct output_chunk *output_chunk_create_shared(int capacity);
+void output_chunk_release(struct output_chunk *chunk);
+enum output_status output_queue_flush(struct output_queue *queue, struct reactor *reactor, int sd);
+
+#endif
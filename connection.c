@@ -0,0 +1,116 @@
+#include <stdlib.h>     // Standard library functions (malloc, free)
+#include "connection.h"
+#include "protocol.h"
+#include "names.h"      // Usernames are given up with the connection
+
+// New connections start in the lobby, waiting for a username
+struct connection *connection_create(int fd, struct reactor *reactor, struct worker *worker, struct connection **flush_list) {
+    struct connection *connection = malloc(sizeof(struct connection));
+    if (connection == NULL) {
+        return NULL;
+    }
+
+    connection->fd = fd;
+    connection->serial = 0;
+    connection->reactor = reactor;
+    connection->worker = worker;
+    connection->room = NULL;
+    connection->player = 0;
+    connection->name = NULL;
+    connection->phase = PHASE_NAME_INPUT;
+    connection->phase_started = 0;
+    connection->requeue = 0;
+    connection->resume_token = 0;
+    connection->spectate_room = 0;
+    connection->handoff_done = 0;
+    connection->protocol = PROTOCOL_UNKNOWN;
+    input_buffer_init(&connection->input);
+    output_queue_init(&connection->output);
+    connection->send_failed = 0;
+    connection->shutdown_after_flush = 0;
+    connection->peer_closed = 0;
+    connection->flush_list = flush_list;
+    connection->flush_prev = NULL;
+    connection->flush_next = NULL;
+    connection->flush_queued = 0;
+    connection->lobby_prev = NULL;
+    connection->lobby_next = NULL;
+    connection->in_lobby = 0;
+    connection->queue_prev = NULL;
+    connection->queue_next = NULL;
+    connection->in_queue = 0;
+    connection->queued_at = 0;
+    return connection;
+}
+
+static void unlink_flush(struct connection *connection) {
+    if (!connection->flush_queued) {
+        return;
+    }
+
+    if (connection->flush_prev != NULL) {
+        connection->flush_prev->flush_next = connection->flush_next;
+    } else {
+        *connection->flush_list = connection->flush_next;
+    }
+    if (connection->flush_next != NULL) {
+        connection->flush_next->flush_prev = connection->flush_prev;
+    }
+    connection->flush_prev = NULL;
+    connection->flush_next = NULL;
+    connection->flush_queued = 0;
+}
+
+void connection_destroy(struct connection *connection) {
+    if (connection->name != NULL) {
+        names_release(connection->name);
+    }
+    unlink_flush(connection);
+    output_queue_destroy(&connection->output);
+    free(connection);
+}
+
+// Put the connection on its workers flush list, once
+void connection_schedule_flush(struct connection *connection) {
+    if (connection->flush_queued) {
+        return;
+    }
+
+    connection->flush_prev = NULL;
+    connection->flush_next = *connection->flush_list;
+    if (*connection->flush_list != NULL) {
+        (*connection->flush_list)->flush_prev = connection;
+    }
+    *connection->flush_list = connection;
+    connection->flush_queued = 1;
+}
+
+// Queue bytes for the client. Nothing is written here: everything queued while handling an event
+// is written together when the worker flushes
+void connection_send(struct connection *connection, const void *data, int length) {
+    if (output_queue_append(&connection->output, data, length) < 0) {
+        connection->send_failed = 1;
+    }
+    connection_schedule_flush(connection);
+}
+
+// Take the connection off the flush list and write what the socket will take
+enum output_status connection_flush(struct connection *connection) {
+    unlink_flush(connection);
+    if (connection->send_failed) {
+        return OUTPUT_ERROR;
+    }
+
+    enum output_status status = output_queue_flush(&connection->output, connection->reactor, connection->fd);
+    if (status == OUTPUT_FLUSHED && connection->shutdown_after_flush) {
+        reactor_shutdown(connection->reactor, connection->fd);
+        connection->shutdown_after_flush = 0;
+    }
+    return status;
+}
+
+// Send the client end of stream after the output queued so far, the socket stays open for reading
+void connection_shutdown_after_flush(struct connection *connection) {
+    connection->shutdown_after_flush = 1;
+    connection_schedule_flush(connection);
+}
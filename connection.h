@@ -0,0 +1,60 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stdint.h>     // Fixed width integer types (uint32_t, uint64_t)
+#include "buffer.h"     // Per connection input ring buffer and output queue
+#include "reactor.h"    // Phase deadline timer
+#include "room.h"       // Game phases and player handles
+
+struct worker;
+
+// State kept for every client socket, passed as its event loop argument
+struct connection {
+    int fd;
+    uint32_t serial;            // Connection number in the journal, see journal.h
+    struct reactor *reactor;    // Event loop the socket is registered with, reads and writes go through it
+    struct worker *worker;      // Worker that owns the socket
+    struct room *room;          // Room the player is in, NULL while they are in the lobby
+    player_id player;           // Handle to the players slot in the room, see room.h
+    const char *name;           // Interned username claimed when it was registered, NULL until then. See names.h
+    enum game_phase phase;      // Where the player is in the lobby, rooms keep their own phase
+    uint64_t phase_started;     // metrics_now_us() when the player entered their lobby phase
+    int requeue;                // Asked to go back into the queue once their game is finished
+    uint64_t resume_token;      // Token a connection handed to another worker is resuming with
+    int spectate_room;          // Room a connection handed to another worker is going to watch
+    int handoff_done;           // Set once the worker that handed the connection over has finished with its socket
+    int protocol;               // Wire protocol version, see protocol.h
+    struct input_buffer input;  // Bytes received but not yet framed
+    struct output_queue output; // Bytes queued but not yet written
+    int send_failed;            // Output couldn't be queued, the client is dropped on the next flush
+    int shutdown_after_flush;   // Half-close the socket once everything queued has been written
+    int peer_closed;            // The event loop reported a hang up, read until end of stream
+    struct reactor_timer deadline; // Armed while the room or lobby is waiting on this player
+
+    // Links in the workers lobby, and in its queue of ready players, see lobby.h. A connection
+    // being handed to another worker is linked into that workers inbox through lobby_next, and a
+    // spectator into its rooms spectators through both lobby links
+    struct connection *lobby_prev;
+    struct connection *lobby_next;
+    int in_lobby;
+    struct connection *queue_prev;
+    struct connection *queue_next;
+    int in_queue;
+    uint64_t queued_at;
+
+    // Connections with queued output are linked into their workers flush list until it is written
+    struct connection **flush_list;
+    struct connection *flush_prev;
+    struct connection *flush_next;
+    int flush_queued;
+};
+
+// Function Declarations
+struct connection *connection_create(int fd, struct reactor *reactor, struct worker *worker, struct connection **flush_list);
+void connection_destroy(struct connection *connection);
+void connection_send(struct connection *connection, const void *data, int length);
+void connection_schedule_flush(struct connection *connection);
+enum output_status connection_flush(struct connection *connection);
+void connection_shutdown_after_flush(struct connection *connection);
+
+#endif
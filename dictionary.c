@@ -0,0 +1,778 @@
+#include <stdlib.h>     // Standard library functions (malloc, calloc, free)
+#include <string.h>     // String manipulation functions (memcpy, memchr, strcmp, strerror)
+#include <errno.h>      // Error codes reported by open and mmap
+#include <unistd.h>     // POSIX API functions (close, sysconf)
+#include <fcntl.h>      // File control options (open)
+#include <pthread.h>    // Reader/writer lock guarding reloads, scoring threads
+#include <time.h>       // Load time measurement (clock_gettime)
+#include <sys/mman.h>   // Memory mapped word list (mmap, madvise, munmap)
+#include <sys/stat.h>   // File size (fstat)
+#include "dictionary.h"
+#include "log.h"        // Load times and failures, which a reload reports while the server is running
+
+// The dictionary in use. Workers only hold the read lock while copying a word out, so a reload
+// swaps the pointer under the write lock and frees the old dictionary once nobody can be reading it
+static struct dictionary *current_dictionary = NULL;
+static pthread_rwlock_t dictionary_lock = PTHREAD_RWLOCK_INITIALIZER;
+static uint64_t dictionary_generation = 0;
+
+// Letter sets are filtered and counted LETTER_LANES at a time with GCC vector extensions, which become
+// SSE2 or NEON instructions on the targets we build for
+#define LETTER_LANES 4
+typedef uint32_t letter_vector __attribute__((vector_size(LETTER_LANES * sizeof(uint32_t))));
+
+static const char guess_order[] = "ETAOINSHRDLCUMWFGYPBVKJXQZ"; // Most common letters first, breaks ties
+
+#define MAX_SCORE_THREADS 64
+#define DIFFICULTY_LEVELS 65536 // Scores fit in a uint16_t
+
+static int score_words(struct dictionary *dictionary, int *threads_used);
+
+static void free_dictionary(struct dictionary *dictionary) {
+    if (dictionary == NULL) {
+        return;
+    }
+    free(dictionary->arena);
+    free(dictionary->offsets);
+    free(dictionary->lengths);
+    free(dictionary->categories);
+    free(dictionary->by_length);
+    free(dictionary->letter_sets);
+    free(dictionary->by_category);
+    free(dictionary->category_start);
+    free(dictionary->category_names);
+    free(dictionary->difficulty);
+    free(dictionary->bands);
+    free(dictionary->by_difficulty);
+    free(dictionary);
+}
+
+// FNV-1a hash of an upper cased word
+static uint32_t hash_word(const char *word, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)word[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int find_or_add_category(struct dictionary *dictionary, const char *name, int length) {
+    if (length >= DICTIONARY_CATEGORY_SIZE) {
+        length = DICTIONARY_CATEGORY_SIZE - 1;
+    }
+
+    for (int i = 0; i < dictionary->category_count; i++) {
+        if (strncmp(dictionary->category_names[i], name, length) == 0 && dictionary->category_names[i][length] == '\0') {
+            return i;
+        }
+    }
+
+    if (dictionary->category_count >= DICTIONARY_MAX_CATEGORIES) {
+        return dictionary->category_count - 1; // Out of categories, fold the rest into the last one
+    }
+
+    int category = dictionary->category_count++;
+    memcpy(dictionary->category_names[category], name, length);
+    dictionary->category_names[category][length] = '\0';
+    return category;
+}
+
+// Group word indexes by key (a counting sort), filling order and start with key_count + 1 entries.
+// Returns 0, or -1 if memory ran out
+static int build_index(uint32_t *order, int *start, int key_count, int word_count, const void *keys, int key_size) {
+    memset(start, 0, (key_count + 1) * sizeof(int));
+
+    for (int i = 0; i < word_count; i++) {
+        int key = key_size == 1 ? ((const uint8_t *)keys)[i] : ((const uint16_t *)keys)[i];
+        start[key + 1]++;
+    }
+    for (int key = 0; key < key_count; key++) {
+        start[key + 1] += start[key];
+    }
+
+    int *next = malloc((key_count + 1) * sizeof(int));
+    if (next == NULL) {
+        return -1;
+    }
+    memcpy(next, start, (key_count + 1) * sizeof(int));
+    for (int i = 0; i < word_count; i++) {
+        int key = key_size == 1 ? ((const uint8_t *)keys)[i] : ((const uint16_t *)keys)[i];
+        order[next[key]++] = (uint32_t)i;
+    }
+    free(next);
+    return 0;
+}
+
+// Parse a memory mapped word list into a new dictionary.
+// Lines are words or "[category]" headers, blank lines and lines starting with '#' are skipped
+static struct dictionary *parse_word_list(const char *text, size_t size, int *duplicates, int *skipped) {
+    // Every word takes at least one line, so the line count bounds the number of words
+    size_t line_count = 1;
+    for (const char *p = text; (p = memchr(p, '\n', text + size - p)) != NULL; p++) {
+        line_count++;
+    }
+
+    size_t table_size = 16;
+    while (table_size < line_count * 2) {
+        table_size *= 2;
+    }
+
+    struct dictionary *dictionary = calloc(1, sizeof(struct dictionary));
+    uint32_t *table = calloc(table_size, sizeof(uint32_t)); // Word index + 1, 0 marks an empty slot
+    if (dictionary == NULL || table == NULL) {
+        free(dictionary);
+        free(table);
+        return NULL;
+    }
+
+    dictionary->arena = malloc(size + 1);
+    dictionary->offsets = malloc(line_count * sizeof(uint32_t));
+    dictionary->lengths = malloc(line_count * sizeof(uint8_t));
+    dictionary->categories = malloc(line_count * sizeof(uint16_t));
+    dictionary->category_names = calloc(DICTIONARY_MAX_CATEGORIES, DICTIONARY_CATEGORY_SIZE);
+    if (!dictionary->arena || !dictionary->offsets || !dictionary->lengths || !dictionary->categories ||
+        !dictionary->category_names) {
+        free(table);
+        free_dictionary(dictionary);
+        return NULL;
+    }
+
+    size_t arena_used = 0;
+    int category = 0;
+    *duplicates = 0;
+    *skipped = 0;
+
+    const char *end = text + size;
+    const char *line = text;
+    while (line < end) {
+        const char *line_end = memchr(line, '\n', end - line);
+        if (line_end == NULL) {
+            line_end = end;
+        }
+
+        // Trim surrounding whitespace (including the '\r' of CRLF files)
+        const char *start = line;
+        const char *stop = line_end;
+        while (start < stop && (*start == ' ' || *start == '\t')) {
+            start++;
+        }
+        while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t' || stop[-1] == '\r')) {
+            stop--;
+        }
+        int length = stop - start;
+        line = line_end + 1;
+
+        if (length == 0 || start[0] == '#') {
+            continue;
+        }
+
+        if (start[0] == '[') {
+            if (stop[-1] == ']' && length > 2) {
+                category = find_or_add_category(dictionary, start + 1, length - 2);
+            }
+            continue;
+        }
+
+        if (length > MAX_WORD_LENGTH) {
+            (*skipped)++;
+            continue;
+        }
+
+        // Upper case the word straight into the arena, it is only kept if it is valid and new
+        char *word = dictionary->arena + arena_used;
+        int valid = 1;
+        for (int i = 0; i < length; i++) {
+            char c = start[i];
+            if (c >= 'a' && c <= 'z') {
+                c -= 'a' - 'A';
+            }
+            if (c < 'A' || c > 'Z') {
+                valid = 0;
+                break;
+            }
+            word[i] = c;
+        }
+        if (!valid) {
+            (*skipped)++;
+            continue;
+        }
+
+        // Deduplicate with an open addressing hash set of word indexes
+        size_t slot = hash_word(word, length) & (table_size - 1);
+        int duplicate = 0;
+        while (table[slot] != 0) {
+            uint32_t other = table[slot] - 1;
+            if (dictionary->lengths[other] == length &&
+                memcmp(dictionary->arena + dictionary->offsets[other], word, length) == 0) {
+                duplicate = 1;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (duplicate) {
+            (*duplicates)++;
+            continue;
+        }
+
+        if (dictionary->category_count == 0) {
+            category = find_or_add_category(dictionary, "general", 7);
+        }
+
+        int index = dictionary->word_count++;
+        word[length] = '\0';
+        dictionary->offsets[index] = (uint32_t)arena_used;
+        dictionary->lengths[index] = (uint8_t)length;
+        dictionary->categories[index] = (uint16_t)category;
+        table[slot] = (uint32_t)index + 1;
+        arena_used += length + 1;
+    }
+
+    free(table);
+
+    // Give back the space taken by comments, headers and duplicates
+    char *arena = realloc(dictionary->arena, arena_used > 0 ? arena_used : 1);
+    if (arena != NULL) {
+        dictionary->arena = arena;
+    }
+
+    int word_count = dictionary->word_count;
+    dictionary->by_length = malloc((word_count > 0 ? word_count : 1) * sizeof(uint32_t));
+    dictionary->by_category = malloc((word_count > 0 ? word_count : 1) * sizeof(uint32_t));
+    dictionary->category_start = malloc((dictionary->category_count + 1) * sizeof(int));
+    if (!dictionary->by_length || !dictionary->by_category || !dictionary->category_start) {
+        free_dictionary(dictionary);
+        return NULL;
+    }
+
+    if (build_index(dictionary->by_length, dictionary->length_start, MAX_WORD_LENGTH + 1, word_count, dictionary->lengths, 1) < 0 ||
+        build_index(dictionary->by_category, dictionary->category_start, dictionary->category_count, word_count,
+                    dictionary->categories, 2) < 0) {
+        free_dictionary(dictionary);
+        return NULL;
+    }
+
+    // Padded to whole vectors, the padding has every letter set so it never passes a filter
+    int padded = (word_count + LETTER_LANES - 1) / LETTER_LANES * LETTER_LANES + LETTER_LANES;
+    dictionary->letter_sets = malloc(padded * sizeof(uint32_t));
+    if (dictionary->letter_sets == NULL) {
+        free_dictionary(dictionary);
+        return NULL;
+    }
+    for (int position = 0; position < padded; position++) {
+        dictionary->letter_sets[position] = position < word_count ? 0 : ~(uint32_t)0;
+    }
+    for (int position = 0; position < word_count; position++) {
+        uint32_t index = dictionary->by_length[position];
+        const char *word = dictionary->arena + dictionary->offsets[index];
+        for (int i = 0; i < dictionary->lengths[index]; i++) {
+            dictionary->letter_sets[position] |= 1u << (word[i] - 'A');
+        }
+    }
+    return dictionary;
+}
+
+// Load the word list at path and make it the dictionary used for new rooms. Safe to call while
+// workers are picking words, which is how the dictionary is reloaded without a restart.
+// Returns 0 on success, -1 if the file can't be read or has no usable words (the old dictionary is kept)
+int dictionary_load(const char *path) {
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log_error("Dictionary: opening %s failed: %s", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || file_stat.st_size == 0) {
+        log_error("Dictionary: %s is empty", path);
+        close(fd);
+        return -1;
+    }
+
+    size_t size = file_stat.st_size;
+    char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        log_error("Dictionary: mapping %s failed: %s", path, strerror(errno));
+        return -1;
+    }
+    madvise(text, size, MADV_SEQUENTIAL);
+
+    int duplicates = 0;
+    int skipped = 0;
+    struct dictionary *dictionary = parse_word_list(text, size, &duplicates, &skipped);
+    munmap(text, size);
+
+    if (dictionary == NULL) {
+        log_error("Dictionary: out of memory loading %s", path);
+        return -1;
+    }
+    if (dictionary->word_count == 0) {
+        log_error("Dictionary: %s has no usable words", path);
+        free_dictionary(dictionary);
+        return -1;
+    }
+
+    // Scored before the swap, so picking a word by difficulty never waits on it
+    struct timespec parsed;
+    int threads = 0;
+    clock_gettime(CLOCK_MONOTONIC, &parsed);
+    if (score_words(dictionary, &threads) < 0) {
+        log_error("Dictionary: out of memory scoring %s", path);
+        free_dictionary(dictionary);
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&dictionary_lock);
+    struct dictionary *old_dictionary = current_dictionary;
+    dictionary->generation = ++dictionary_generation;
+    current_dictionary = dictionary;
+    pthread_rwlock_unlock(&dictionary_lock);
+    free_dictionary(old_dictionary);
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    double elapsed_ms = (finished.tv_sec - started.tv_sec) * 1000.0 + (finished.tv_nsec - started.tv_nsec) / 1e6;
+    double scoring_ms = (finished.tv_sec - parsed.tv_sec) * 1000.0 + (finished.tv_nsec - parsed.tv_nsec) / 1e6;
+    log_info("Dictionary: loaded %d words in %d categories from %s in %.2f ms (%d duplicates, %d invalid skipped)",
+             dictionary->word_count, dictionary->category_count, path, elapsed_ms, duplicates, skipped);
+    log_info("Dictionary: scored difficulty in %.2f ms on %d threads, bands of %d, %d and %d words", scoring_ms, threads,
+             dictionary->band_start[1] - dictionary->band_start[0], dictionary->band_start[2] - dictionary->band_start[1],
+             dictionary->band_start[3] - dictionary->band_start[2]);
+    return 0;
+}
+
+void dictionary_unload(void) {
+    pthread_rwlock_wrlock(&dictionary_lock);
+    struct dictionary *old_dictionary = current_dictionary;
+    current_dictionary = NULL;
+    pthread_rwlock_unlock(&dictionary_lock);
+    free_dictionary(old_dictionary);
+}
+
+// Returns the index of the named category, or DICTIONARY_ANY if there is no such category
+int dictionary_find_category(const char *name) {
+    int category = DICTIONARY_ANY;
+
+    pthread_rwlock_rdlock(&dictionary_lock);
+    if (current_dictionary != NULL) {
+        for (int i = 0; i < current_dictionary->category_count; i++) {
+            if (strcmp(current_dictionary->category_names[i], name) == 0) {
+                category = i;
+                break;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&dictionary_lock);
+    return category;
+}
+
+// Returns the index of the named difficulty band ("easy", "medium" or "hard"), or DICTIONARY_ANY if there is none
+int dictionary_find_band(const char *name) {
+    static const char *band_names[DICTIONARY_BANDS] = {"easy", "medium", "hard"};
+    for (int band = 0; band < DICTIONARY_BANDS; band++) {
+        if (strcmp(band_names[band], name) == 0) {
+            return band;
+        }
+    }
+    return DICTIONARY_ANY;
+}
+
+// Copy a random word into word, optionally restricted to a length, category and/or difficulty band
+// (DICTIONARY_ANY for no restriction). Picking is a lookup into the matching index, nothing is allocated.
+// Returns the word length, or -1 if no word matches
+int dictionary_random_word(char *word, int word_size, unsigned int *seed, int length, int category, int band) {
+    int result = -1;
+
+    pthread_rwlock_rdlock(&dictionary_lock);
+    struct dictionary *dictionary = current_dictionary;
+
+    if (dictionary != NULL && category < dictionary->category_count && length <= MAX_WORD_LENGTH &&
+        band < DICTIONARY_BANDS) {
+        const uint32_t *candidates = NULL;
+        int count = dictionary->word_count;
+
+        if (category != DICTIONARY_ANY) {
+            candidates = dictionary->by_category + dictionary->category_start[category];
+            count = dictionary->category_start[category + 1] - dictionary->category_start[category];
+        } else if (band != DICTIONARY_ANY) {
+            candidates = dictionary->by_difficulty + dictionary->band_start[band];
+            count = dictionary->band_start[band + 1] - dictionary->band_start[band];
+        } else if (length != DICTIONARY_ANY) {
+            candidates = dictionary->by_length + dictionary->length_start[length];
+            count = dictionary->length_start[length + 1] - dictionary->length_start[length];
+        }
+
+        // Restrictions together are sampled from the category, or else the band, and the picks that miss the
+        // others are drawn again
+        for (int attempt = 0; count > 0 && attempt < 64; attempt++) {
+            int pick = rand_r(seed) % count;
+            uint32_t index = candidates != NULL ? candidates[pick] : (uint32_t)pick;
+
+            if ((length != DICTIONARY_ANY && dictionary->lengths[index] != length) ||
+                (band != DICTIONARY_ANY && dictionary->bands[index] != band)) {
+                continue;
+            }
+            if (dictionary->lengths[index] < word_size) {
+                memcpy(word, dictionary->arena + dictionary->offsets[index], dictionary->lengths[index] + 1);
+                result = dictionary->lengths[index];
+            }
+            break;
+        }
+    }
+
+    pthread_rwlock_unlock(&dictionary_lock);
+    return result;
+}
+
+// Whether the word at position in by_length fits pattern: every revealed letter in place, and no guessed
+// letter where the pattern is still hidden, as guessing it would have revealed it there
+static int matches_pattern(const struct dictionary *dictionary, uint32_t position, const char *pattern, int length, uint32_t guessed) {
+    const char *word = dictionary->arena + dictionary->offsets[dictionary->by_length[position]];
+    for (int i = 0; i < length; i++) {
+        if (pattern[i] != '\0' ? word[i] != pattern[i] : (guessed >> (word[i] - 'A')) & 1) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Make room for count candidates, plus a vectors worth of padding. Returns 0, or -1 if memory ran out
+static int reserve_filter(struct dictionary_filter *filter, int count) {
+    int capacity = count + LETTER_LANES;
+    if (capacity <= filter->capacity) {
+        return 0;
+    }
+
+    dictionary_filter_free(filter);
+    filter->positions = malloc(capacity * sizeof(uint32_t));
+    filter->letter_sets = malloc(capacity * sizeof(uint32_t));
+    if (filter->positions == NULL || filter->letter_sets == NULL) {
+        dictionary_filter_free(filter);
+        return -1;
+    }
+    filter->capacity = capacity;
+    return 0;
+}
+
+// Start the candidates over from every word of the goal words length. A vector of letter sets is checked
+// against the wrong and the correct letters at once, only words that pass are compared letter by letter
+static void fill_filter(struct dictionary_filter *filter, const struct dictionary *dictionary, const char *pattern,
+                        int length, uint32_t guessed, uint32_t wrong) {
+    int start = dictionary->length_start[length];
+    int end = dictionary->length_start[length + 1];
+
+    filter->count = 0;
+    filter->generation = 0;
+    if (reserve_filter(filter, end - start) < 0) {
+        return;
+    }
+
+    uint32_t required = guessed & ~wrong;
+    letter_vector wrong_letters = (letter_vector){0} + wrong;
+    letter_vector required_letters = (letter_vector){0} + required;
+    for (int position = start; position < end; position += LETTER_LANES) {
+        letter_vector sets;
+        memcpy(&sets, dictionary->letter_sets + position, sizeof(sets));
+        letter_vector fits = (letter_vector)(((sets & wrong_letters) == 0) & ((sets & required_letters) == required_letters));
+
+        for (int lane = 0; lane < LETTER_LANES && position + lane < end; lane++) {
+            if (fits[lane] && matches_pattern(dictionary, position + lane, pattern, length, guessed)) {
+                filter->positions[filter->count] = position + lane;
+                filter->letter_sets[filter->count] = sets[lane];
+                filter->count++;
+            }
+        }
+    }
+    filter->generation = dictionary->generation;
+}
+
+// Drop the candidates that no longer fit after the latest guess, keeping the rest packed in order
+static void narrow_filter(struct dictionary_filter *filter, const struct dictionary *dictionary, const char *pattern,
+                          int length, uint32_t guessed, uint32_t wrong) {
+    uint32_t required = guessed & ~wrong;
+    letter_vector wrong_letters = (letter_vector){0} + wrong;
+    letter_vector required_letters = (letter_vector){0} + required;
+    int kept = 0;
+
+    for (int n = 0; n < filter->count; n += LETTER_LANES) {
+        letter_vector sets;
+        memcpy(&sets, filter->letter_sets + n, sizeof(sets));
+        letter_vector fits = (letter_vector)(((sets & wrong_letters) == 0) & ((sets & required_letters) == required_letters));
+
+        for (int lane = 0; lane < LETTER_LANES && n + lane < filter->count; lane++) {
+            if (fits[lane] && matches_pattern(dictionary, filter->positions[n + lane], pattern, length, guessed)) {
+                filter->positions[kept] = filter->positions[n + lane];
+                filter->letter_sets[kept] = sets[lane];
+                kept++;
+            }
+        }
+    }
+    filter->count = kept;
+}
+
+// The unguessed letter found in the most candidates, so the likeliest to be in the goal word. Each letter is
+// counted a vector of candidates at a time. Ties, and a bot with no candidates left, go by letter frequency.
+// Returns 0 once every letter has been guessed
+static char best_letter(const struct dictionary_filter *filter, uint32_t guessed) {
+    letter_vector counts[ALPHABET_SIZE];
+    int totals[ALPHABET_SIZE];
+    memset(counts, 0, sizeof(counts));
+    memset(totals, 0, sizeof(totals));
+
+    int whole = filter->count / LETTER_LANES * LETTER_LANES;
+    for (int n = 0; n < whole; n += LETTER_LANES) {
+        letter_vector sets;
+        memcpy(&sets, filter->letter_sets + n, sizeof(sets));
+        for (int letter = 0; letter < ALPHABET_SIZE; letter++) {
+            counts[letter] += (sets >> letter) & 1;
+        }
+    }
+    for (int letter = 0; letter < ALPHABET_SIZE; letter++) {
+        for (int lane = 0; lane < LETTER_LANES; lane++) {
+            totals[letter] += counts[letter][lane];
+        }
+        for (int n = whole; n < filter->count; n++) {
+            totals[letter] += (filter->letter_sets[n] >> letter) & 1;
+        }
+    }
+
+    char best = 0;
+    int best_total = -1;
+    for (const char *letter = guess_order; *letter != '\0'; letter++) {
+        int bit = *letter - 'A';
+        if (!((guessed >> bit) & 1) && totals[bit] > best_total) {
+            best = *letter;
+            best_total = totals[bit];
+        }
+    }
+    return best;
+}
+
+// Pick a bot players next guess. pattern holds the goal words letters revealed so far and '\0' where they
+// are hidden, guessed and wrong are letter sets (bit c - 'A' for letter c). The candidates in filter are
+// narrowed to the words that still fit, and rebuilt from scratch if the dictionary has been reloaded.
+// Returns the letter to guess, or 0 once every letter has been guessed
+char dictionary_next_guess(struct dictionary_filter *filter, const char *pattern, int length, uint32_t guessed, uint32_t wrong) {
+    pthread_rwlock_rdlock(&dictionary_lock);
+    struct dictionary *dictionary = current_dictionary;
+
+    if (dictionary == NULL || length <= 0 || length > MAX_WORD_LENGTH) {
+        filter->count = 0;
+    } else if (filter->generation != dictionary->generation) {
+        fill_filter(filter, dictionary, pattern, length, guessed, wrong);
+    } else {
+        narrow_filter(filter, dictionary, pattern, length, guessed, wrong);
+    }
+    char guess = best_letter(filter, guessed);
+
+    pthread_rwlock_unlock(&dictionary_lock);
+    return guess;
+}
+
+void dictionary_filter_free(struct dictionary_filter *filter) {
+    free(filter->positions);
+    free(filter->letter_sets);
+    filter->positions = NULL;
+    filter->letter_sets = NULL;
+    filter->count = 0;
+    filter->capacity = 0;
+    filter->generation = 0;
+}
+
+// A word being scored, see score_class()
+struct score_entry {
+    uint64_t mask;                // Positions the latest guess revealed
+    uint32_t position;            // Position in by_length
+    uint32_t letter_set;
+};
+
+// Work shared by the threads scoring a dictionary
+struct score_job {
+    struct dictionary *dictionary;
+    int surprisal[ALPHABET_SIZE]; // Sixteenths of a bit each letter tells a guesser, rarer letters tell more
+    int order[MAX_WORD_LENGTH + 1]; // Lengths from the most words to the fewest, so the biggest bucket starts first
+    int next;                     // Next entry of order to claim
+    int failed;
+};
+
+// log2(value) in sixteenths, exact at powers of two and linear between them
+static int log2_sixteenths(uint32_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    int top = 31 - __builtin_clz(value);
+    return top * 16 + (int)(((uint64_t)value << 4 >> top) - 16);
+}
+
+// Units of 1024 are the wrong guesses a bot makes before it solves the word. Below that, words made of letters
+// rare across the dictionary, and that repeat fewer of them, score higher
+static void record_score(const struct score_job *job, uint32_t position, int wrong_guesses) {
+    struct dictionary *dictionary = job->dictionary;
+    uint32_t index = dictionary->by_length[position];
+    int rarity = 0;
+    for (int letter = 0; letter < ALPHABET_SIZE; letter++) {
+        if ((dictionary->letter_sets[position] >> letter) & 1) {
+            rarity += job->surprisal[letter];
+        }
+    }
+    rarity /= dictionary->lengths[index];
+    dictionary->difficulty[index] = (uint16_t)(wrong_guesses * 1024 + (rarity < 1023 ? rarity : 1023));
+}
+
+static int compare_score_entries(const void *a, const void *b) {
+    uint64_t first = ((const struct score_entry *)a)->mask;
+    uint64_t second = ((const struct score_entry *)b)->mask;
+    return (first > second) - (first < second);
+}
+
+// Play the bot strategy against a class of words at once: words of one length that every guess so far has
+// revealed the same way, so a bot playing any of them has them all as its candidates and guesses the same next.
+// The class is split by what that guess reveals, down to single words, whose guesses are all in the word from
+// then on. Each word scores the wrong guesses on its way down, as many as a bot playing it alone would make
+static void score_class(const struct score_job *job, struct score_entry *entries, int count, uint32_t *sets,
+                        uint32_t guessed, int wrong_guesses) {
+    const struct dictionary *dictionary = job->dictionary;
+    char guess = 0;
+    if (count > 1) {
+        for (int n = 0; n < count; n++) {
+            sets[n] = entries[n].letter_set;
+        }
+        struct dictionary_filter candidates = {.letter_sets = sets, .count = count};
+        guess = best_letter(&candidates, guessed);
+    }
+    if (guess == 0) {
+        for (int n = 0; n < count; n++) {
+            record_score(job, entries[n].position, wrong_guesses);
+        }
+        return;
+    }
+
+    for (int n = 0; n < count; n++) {
+        const char *word = dictionary->arena + dictionary->offsets[dictionary->by_length[entries[n].position]];
+        entries[n].mask = 0;
+        for (int i = 0; word[i] != '\0'; i++) {
+            entries[n].mask |= (uint64_t)(word[i] == guess) << i;
+        }
+    }
+    qsort(entries, count, sizeof(struct score_entry), compare_score_entries);
+
+    guessed |= 1u << (guess - 'A');
+    for (int start = 0, end; start < count; start = end) {
+        for (end = start + 1; end < count && entries[end].mask == entries[start].mask; end++) {
+        }
+        score_class(job, entries + start, end - start, sets, guessed, wrong_guesses + (entries[start].mask == 0));
+    }
+}
+
+// Score length buckets until none are left to claim
+static void *score_thread(void *arg) {
+    struct score_job *job = arg;
+    struct dictionary *dictionary = job->dictionary;
+
+    for (;;) {
+        int claimed = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (claimed > MAX_WORD_LENGTH) {
+            break;
+        }
+        int length = job->order[claimed];
+        int start = dictionary->length_start[length];
+        int count = dictionary->length_start[length + 1] - start;
+        if (count == 0) {
+            continue;
+        }
+
+        struct score_entry *entries = malloc(count * sizeof(struct score_entry));
+        uint32_t *sets = malloc(count * sizeof(uint32_t));
+        if (entries == NULL || sets == NULL) {
+            __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        } else {
+            for (int n = 0; n < count; n++) {
+                entries[n].position = start + n;
+                entries[n].letter_set = dictionary->letter_sets[start + n];
+            }
+            score_class(job, entries, count, sets, 0, 0);
+        }
+        free(entries);
+        free(sets);
+    }
+    return NULL;
+}
+
+// Score every word of a dictionary that hasn't been published yet, then rank them into by_difficulty and cut
+// the ranking into bands of a third each. Length buckets are scored on a thread per core, the loading thread
+// included. Returns 0, or -1 if memory ran out
+static int score_words(struct dictionary *dictionary, int *threads_used) {
+    int word_count = dictionary->word_count;
+    dictionary->difficulty = malloc(word_count * sizeof(uint16_t));
+    dictionary->bands = malloc(word_count * sizeof(uint8_t));
+    dictionary->by_difficulty = malloc(word_count * sizeof(uint32_t));
+    int *level_start = malloc((DIFFICULTY_LEVELS + 1) * sizeof(int));
+    if (!dictionary->difficulty || !dictionary->bands || !dictionary->by_difficulty || !level_start) {
+        free(level_start);
+        return -1;
+    }
+
+    struct score_job job;
+    memset(&job, 0, sizeof(job));
+    job.dictionary = dictionary;
+    for (int letter = 0; letter < ALPHABET_SIZE; letter++) {
+        int containing = 0;
+        for (int position = 0; position < word_count; position++) {
+            containing += (dictionary->letter_sets[position] >> letter) & 1;
+        }
+        job.surprisal[letter] = log2_sixteenths(word_count) - log2_sixteenths(containing > 0 ? containing : 1);
+    }
+
+    int buckets = 0;
+    for (int length = 0; length <= MAX_WORD_LENGTH; length++) {
+        int size = dictionary->length_start[length + 1] - dictionary->length_start[length];
+        int n = length;
+        for (; n > 0 && dictionary->length_start[job.order[n - 1] + 1] - dictionary->length_start[job.order[n - 1]] < size; n--) {
+            job.order[n] = job.order[n - 1];
+        }
+        job.order[n] = length;
+        buckets += size > 0;
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int thread_count = cores > 0 ? (cores < MAX_SCORE_THREADS ? (int)cores : MAX_SCORE_THREADS) : 1;
+    if (thread_count > buckets) {
+        thread_count = buckets > 0 ? buckets : 1;
+    }
+
+    // A thread that can't be started only makes scoring slower, the rest claim its buckets
+    pthread_t threads[MAX_SCORE_THREADS];
+    int started = 0;
+    while (started < thread_count - 1 && pthread_create(&threads[started], NULL, score_thread, &job) == 0) {
+        started++;
+    }
+    score_thread(&job);
+    for (int n = 0; n < started; n++) {
+        pthread_join(threads[n], NULL);
+    }
+    *threads_used = started + 1;
+    if (job.failed) {
+        free(level_start);
+        return -1;
+    }
+
+    int indexed = build_index(dictionary->by_difficulty, level_start, DIFFICULTY_LEVELS, word_count, dictionary->difficulty, 2);
+    free(level_start);
+    if (indexed < 0) {
+        return -1;
+    }
+
+    for (int band = 0; band < DICTIONARY_BANDS; band++) {
+        dictionary->band_start[band] = (int)((int64_t)word_count * band / DICTIONARY_BANDS);
+    }
+    dictionary->band_start[DICTIONARY_BANDS] = word_count;
+    for (int band = 0; band < DICTIONARY_BANDS; band++) {
+        for (int n = dictionary->band_start[band]; n < dictionary->band_start[band + 1]; n++) {
+            dictionary->bands[dictionary->by_difficulty[n]] = band;
+        }
+    }
+    return 0;
+}
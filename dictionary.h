@@ -0,0 +1,64 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stdint.h>     // Fixed width integer types
+#include "game.h"       // MAX_WORD_LENGTH
+
+#define DICTIONARY_ANY -1          // Match words of any length or category
+#define DICTIONARY_MAX_CATEGORIES 1024
+#define DICTIONARY_CATEGORY_SIZE 64
+
+// Difficulty bands, each a third of the words ranked by difficulty score
+enum dictionary_band {
+    DICTIONARY_EASY,
+    DICTIONARY_MEDIUM,
+    DICTIONARY_HARD,
+    DICTIONARY_BANDS
+};
+
+// A word list loaded into one contiguous string arena. Words are stored NUL terminated back to back
+// and addressed by index, with indexes grouped by length, by category and by difficulty so that picking
+// a random word from any group is a single array lookup
+struct dictionary {
+    char *arena;
+    uint32_t *offsets;            // Word index -> offset of the word in the arena
+    uint8_t *lengths;             // Word index -> word length
+    uint16_t *categories;         // Word index -> category index
+    int word_count;
+
+    uint32_t *by_length;          // Word indexes ordered by length
+    int length_start[MAX_WORD_LENGTH + 2]; // Words of length l are by_length[length_start[l] .. length_start[l + 1])
+    uint32_t *letter_sets;        // Parallel to by_length: bit c - 'A' is set when letter c is in the word
+    uint64_t generation;          // Bumped by every load, so positions in by_length can't be mixed up across reloads
+
+    uint32_t *by_category;        // Word indexes ordered by category
+    int *category_start;          // Same layout as length_start, category_count + 1 entries
+    char (*category_names)[DICTIONARY_CATEGORY_SIZE];
+    int category_count;
+
+    uint16_t *difficulty;         // Word index -> difficulty score, see record_score()
+    uint8_t *bands;               // Word index -> difficulty band
+    uint32_t *by_difficulty;      // Word indexes from easiest to hardest
+    int band_start[DICTIONARY_BANDS + 1]; // Same layout as length_start
+};
+
+// A bot players candidate words: positions in by_length of the words of the goal words length that still
+// fit everything the bot has seen. It only shrinks, so each guess filters what the last one left
+struct dictionary_filter {
+    uint64_t generation;          // Dictionary the positions are in, 0 before the first guess
+    uint32_t *positions;
+    uint32_t *letter_sets;        // Letter set of each candidate, packed so letters can be counted a vector at a time
+    int count;
+    int capacity;
+};
+
+// Function Declarations
+int dictionary_load(const char *path);
+void dictionary_unload(void);
+int dictionary_find_category(const char *name);
+int dictionary_find_band(const char *name);
+int dictionary_random_word(char *word, int word_size, unsigned int *seed, int length, int category, int band);
+char dictionary_next_guess(struct dictionary_filter *filter, const char *pattern, int length, uint32_t guessed, uint32_t wrong);
+void dictionary_filter_free(struct dictionary_filter *filter);
+
+#endif
@@ -0,0 +1,37 @@
+#include <string.h>     // String manipulation functions (strlen, memset)
+#include "game.h"
+
+// Build the letter to position mask table for word (upper case A-Z).
+// Returns -1 if the word is empty or too long to fit in a progress mask
+int game_word_init(struct game_word *game_word, const char *word) {
+    int length = strlen(word);
+    if (length == 0 || length > MAX_WORD_LENGTH) {
+        return -1;
+    }
+
+    memset(game_word, 0, sizeof(*game_word));
+    game_word->word = word;
+    game_word->length = length;
+
+    for (int i = 0; i < length; i++) {
+        if (word[i] >= 'A' && word[i] <= 'Z') {
+            game_word->letter_masks[word[i] - 'A'] |= (uint64_t)1 << i;
+        }
+    }
+
+    game_word->complete_mask = length == 64 ? ~(uint64_t)0 : ((uint64_t)1 << length) - 1;
+    return 0;
+}
+
+// Apply a guess (upper case A-Z) to a players progress mask.
+// Returns the positions the letter occupies, 0 if the guess was wrong
+uint64_t evaluate_guess(const struct game_word *game_word, uint64_t *progress, char guess) {
+    uint64_t revealed = game_word->letter_masks[guess - 'A'];
+    *progress |= revealed;
+    return revealed;
+}
+
+// Function to check if the player has guessed the word in full
+int is_word_guessed(const struct game_word *game_word, uint64_t progress) {
+    return progress == game_word->complete_mask;
+}
@@ -0,0 +1,23 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>     // Fixed width integer types (uint64_t)
+
+#define MAX_WORD_LENGTH 64 // One bit per letter position in a 64 bit progress mask
+#define ALPHABET_SIZE 26
+
+// A goal word precomputed for guess evaluation. Bit j of letter_masks[c - 'A'] is set when
+// letter c appears at position j, so evaluating a guess is a single table lookup
+struct game_word {
+    const char *word;
+    int length;
+    uint64_t letter_masks[ALPHABET_SIZE];
+    uint64_t complete_mask;  // Bits 0..length-1, the progress of a player who has guessed every letter
+};
+
+// Function Declarations
+int game_word_init(struct game_word *game_word, const char *word);
+uint64_t evaluate_guess(const struct game_word *game_word, uint64_t *progress, char guess);
+int is_word_guessed(const struct game_word *game_word, uint64_t progress);
+
+#endif
@@ -0,0 +1,288 @@
+#include <stdlib.h>     // Standard library functions (malloc, free)
+#include <string.h>     // String manipulation functions (memset, memcpy, strnlen)
+#include <unistd.h>     // POSIX API functions (write, fdatasync, close)
+#include <fcntl.h>      // File control options (open)
+#include <errno.h>      // Error codes (EINTR)
+#include <time.h>       // Record timestamps (clock_gettime) and writer sleeps (nanosleep)
+#include <pthread.h>    // Writer thread
+#include "journal.h"
+#include "ring.h"       // Per thread record rings
+#include "log.h"        // Open and write failures, dropped records
+
+#define JOURNAL_BATCH_RECORDS 4096 // Records copied out and written with one write() call
+
+_Static_assert(sizeof(struct journal_record) == JOURNAL_RECORD_SIZE, "journal records must be JOURNAL_RECORD_SIZE bytes");
+
+// Records copied out of the rings, waiting to be appended with one write()
+struct journal_batch {
+    struct journal_record *records;
+    int used;
+};
+
+int journal_enabled = 0;
+
+static int journal_fd = -1;
+static struct ring_set rings = RING_SET_INITIALIZER(sizeof(struct journal_record), JOURNAL_RING_SLOTS);
+static __thread struct ring *thread_ring = NULL;
+static pthread_t writer_thread;
+static int writer_running = 0;
+static __thread int write_through = 0;
+static __thread struct journal_record write_through_record;
+
+// Function Declarations
+static int write_all(const void *data, size_t length);
+static void *run_writer_thread(void *arg);
+
+// Open the journal at path for appending and start the writer thread. Returns 0 on success, -1 on failure
+int journal_open(const char *path) {
+    journal_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (journal_fd < 0) {
+        log_error("Journal open failed: %s", strerror(errno));
+        return -1;
+    }
+
+    // Anything torn off the end by a crash is cut back to a whole record, so records stay aligned
+    off_t size = lseek(journal_fd, 0, SEEK_END);
+    if (size > 0 && size % JOURNAL_RECORD_SIZE != 0 && ftruncate(journal_fd, size - size % JOURNAL_RECORD_SIZE) < 0) {
+        log_error("Journal truncate failed: %s", strerror(errno));
+    }
+
+    __atomic_store_n(&writer_running, 1, __ATOMIC_RELEASE);
+    int error = pthread_create(&writer_thread, NULL, run_writer_thread, NULL);
+    if (error != 0) {
+        log_error("Thread creation failed: %s", strerror(error));
+        writer_running = 0;
+        close(journal_fd);
+        journal_fd = -1;
+        return -1;
+    }
+
+    journal_enabled = 1;
+    log_info("Journal: appending to %s", path);
+    return 0;
+}
+
+// Write out and sync everything journaled so far, then stop the writer thread
+void journal_close(void) {
+    if (!__atomic_exchange_n(&writer_running, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    pthread_join(writer_thread, NULL);
+    journal_enabled = 0;
+    close(journal_fd);
+    journal_fd = -1;
+}
+
+// While enabled, the calling threads records are appended as they are made instead of going through its ring,
+// and synced when it is turned off. The main thread journals restored games this way before the workers start,
+// so they are on disk ahead of any worker event however many there are
+void journal_write_through(int enabled) {
+    if (!journal_enabled) {
+        return;
+    }
+    write_through = enabled;
+    if (!enabled && fdatasync(journal_fd) < 0) {
+        log_error("Journal: fdatasync failed");
+    }
+}
+
+// Claim the next slot of the calling threads ring, cleared and stamped with type and the time.
+// Never blocks: returns NULL, and counts the record as dropped, if the writer is a full ring behind
+static struct journal_record *begin_record(int type, int worker) {
+    struct journal_record *record = write_through ? &write_through_record : ring_claim(&rings, &thread_ring);
+    if (record == NULL) {
+        return NULL;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    memset(record, 0, sizeof(*record));
+    record->time_us = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    record->type = (uint8_t)type;
+    record->worker = (uint16_t)worker;
+    return record;
+}
+
+// Copy as much of text as fits, with its length. The record is already cleared, so the rest stays zero
+static void copy_text(struct journal_record *record, const char *text) {
+    size_t length = strnlen(text, JOURNAL_TEXT_SIZE);
+    memcpy(record->text, text, length);
+    record->text_length = (uint8_t)length;
+}
+
+// Hand the record filled in since begin_record() to the writer thread, or append it now when writing through
+static void commit_record(void) {
+    if (write_through) {
+        if (write_all(&write_through_record, sizeof(write_through_record)) < 0) {
+            log_error("Journal: write failed, 1 record lost");
+        }
+        return;
+    }
+    ring_commit(thread_ring);
+}
+
+void journal_accept(int worker, uint32_t connection) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_ACCEPT, worker)) == NULL) {
+        return;
+    }
+    record->connection = connection;
+    commit_record();
+}
+
+void journal_name(int worker, uint32_t connection, const char *name) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_NAME, worker)) == NULL) {
+        return;
+    }
+    record->connection = connection;
+    copy_text(record, name);
+    commit_record();
+}
+
+void journal_ready(int worker, uint32_t connection) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_READY, worker)) == NULL) {
+        return;
+    }
+    record->connection = connection;
+    commit_record();
+}
+
+void journal_game_start(int worker, int room, const char *goal_word, int players, int max_guesses) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_GAME_START, worker)) == NULL) {
+        return;
+    }
+    record->room = room;
+    record->count = (uint16_t)players;
+    record->guesses_left = (uint8_t)max_guesses;
+    copy_text(record, goal_word);
+    commit_record();
+}
+
+void journal_join(int worker, int room, int slot, uint32_t connection, const char *name) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_JOIN, worker)) == NULL) {
+        return;
+    }
+    record->room = room;
+    record->slot = (uint16_t)slot;
+    record->connection = connection;
+    copy_text(record, name);
+    commit_record();
+}
+
+void journal_guess(int worker, int room, int slot, char letter, int correct, int guesses_left, uint64_t revealed) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_GUESS, worker)) == NULL) {
+        return;
+    }
+    record->room = room;
+    record->slot = (uint16_t)slot;
+    record->letter = (uint8_t)letter;
+    record->correct = (uint8_t)(correct != 0);
+    record->guesses_left = (uint8_t)guesses_left;
+    record->mask = revealed;
+    commit_record();
+}
+
+void journal_finish(int worker, int room, int slot, int solved, int score) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_FINISH, worker)) == NULL) {
+        return;
+    }
+    record->room = room;
+    record->slot = (uint16_t)slot;
+    record->correct = (uint8_t)(solved != 0);
+    record->count = (uint16_t)score;
+    commit_record();
+}
+
+void journal_restore(int worker, int room, int slot, const char *name, uint64_t progress, int guesses_left, int finished, int score) {
+    struct journal_record *record;
+    if (!journal_enabled || (record = begin_record(JOURNAL_RESTORE, worker)) == NULL) {
+        return;
+    }
+    record->room = room;
+    record->slot = (uint16_t)slot;
+    record->mask = progress;
+    record->guesses_left = (uint8_t)guesses_left;
+    record->correct = (uint8_t)(finished != 0);
+    record->count = (uint16_t)score;
+    copy_text(record, name);
+    commit_record();
+}
+
+static int write_all(const void *data, size_t length) {
+    const char *bytes = data;
+    while (length > 0) {
+        ssize_t written = write(journal_fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Append the batch to the journal and empty it
+static void write_batch(struct journal_batch *batch) {
+    if (batch->used > 0 && write_all(batch->records, batch->used * sizeof(struct journal_record)) < 0) {
+        log_error("Journal: write failed, %d records lost", batch->used);
+    }
+    batch->used = 0;
+}
+
+static void consume_record(const void *record, void *arg) {
+    struct journal_batch *batch = arg;
+    if (batch->used == JOURNAL_BATCH_RECORDS) {
+        write_batch(batch);
+    }
+    memcpy(&batch->records[batch->used++], record, sizeof(struct journal_record));
+}
+
+// Copy every record waiting in every ring into batch and append them, then make them durable with a
+// single fdatasync() for the whole group. Returns the number of records written
+static int drain_rings(struct journal_batch *batch) {
+    uint64_t dropped = 0;
+    int drained = ring_drain(&rings, consume_record, batch, &dropped);
+    if (dropped > 0) {
+        log_warn("Journal: %llu records dropped, the writer fell behind", (unsigned long long)dropped);
+    }
+
+    write_batch(batch);
+    if (drained > 0 && fdatasync(journal_fd) < 0) {
+        log_error("Journal: fdatasync failed");
+    }
+    return drained;
+}
+
+// Group commit: drain and sync the rings until journal_close(), sleeping between passes while they are empty.
+// Whatever piles up while one fdatasync() runs goes out together on the next
+static void *run_writer_thread(void *arg) {
+    (void)arg;
+    struct journal_batch batch = {.records = malloc(JOURNAL_BATCH_RECORDS * sizeof(struct journal_record)), .used = 0};
+    if (batch.records == NULL) {
+        return NULL;
+    }
+
+    for (;;) {
+        int running = __atomic_load_n(&writer_running, __ATOMIC_ACQUIRE);
+        int drained = drain_rings(&batch);
+        if (!running) {
+            break; // That was the final pass after journal_close()
+        }
+        if (drained == 0) {
+            struct timespec interval = {0, JOURNAL_FLUSH_INTERVAL_MS * 1000000L};
+            nanosleep(&interval, NULL);
+        }
+    }
+
+    free(batch.records);
+    return NULL;
+}
@@ -0,0 +1,59 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>     // Fixed width integer types (uint8_t, uint16_t, uint32_t, uint64_t)
+#include "game.h"       // Longest goal word (MAX_WORD_LENGTH)
+
+// Journal file layout: JOURNAL_RECORD_SIZE byte records in host byte order, appended in the order the
+// writer thread drains them. Records of one worker stay in order; records of different workers interleave
+#define JOURNAL_RECORD_SIZE 104
+#define JOURNAL_TEXT_SIZE MAX_WORD_LENGTH // text_length bytes are used, the rest are zero
+#define JOURNAL_MAX_INDEX UINT16_MAX // Largest worker index or slot a record holds
+#define JOURNAL_RING_SLOTS 8192 // Records buffered per thread, a power of two
+#define JOURNAL_FLUSH_INTERVAL_MS 5 // How long the writer thread sleeps when the rings are empty
+
+enum journal_event {
+    JOURNAL_ACCEPT = 1,   // connection
+    JOURNAL_NAME,         // connection, text: username
+    JOURNAL_READY,        // connection
+    JOURNAL_GAME_START,   // room, count: players, guesses_left: guesses allowed, text: goal word
+    JOURNAL_JOIN,         // room, slot, connection, text: username
+    JOURNAL_GUESS,        // room, slot, letter, correct, guesses_left afterwards, mask: positions revealed
+    JOURNAL_FINISH,       // room, slot, correct: solved, count: score
+    JOURNAL_RESTORE       // room, slot, text: username, mask: progress, guesses_left, correct: finished,
+                          // count: score. A slot of a game read back from a snapshot, after its JOURNAL_GAME_START
+};
+
+struct journal_record {
+    uint64_t time_us;         // CLOCK_REALTIME when the event happened
+    uint64_t mask;
+    uint32_t connection;      // Numbered when accepted, unique within a run. 0 if not tied to a connection
+    int32_t room;             // 0 outside a room
+    uint16_t worker;
+    uint16_t slot;
+    uint16_t count;
+    uint8_t type;             // enum journal_event
+    uint8_t letter;
+    uint8_t correct;
+    uint8_t guesses_left;
+    uint8_t text_length;
+    uint8_t reserved[5];      // Zero
+    char text[JOURNAL_TEXT_SIZE];
+};
+
+extern int journal_enabled;   // Set while a journal is open, every journal_*() call returns straight away otherwise
+
+// Function Declarations
+int journal_open(const char *path);
+void journal_close(void);
+void journal_write_through(int enabled);
+void journal_accept(int worker, uint32_t connection);
+void journal_name(int worker, uint32_t connection, const char *name);
+void journal_ready(int worker, uint32_t connection);
+void journal_game_start(int worker, int room, const char *goal_word, int players, int max_guesses);
+void journal_join(int worker, int room, int slot, uint32_t connection, const char *name);
+void journal_guess(int worker, int room, int slot, char letter, int correct, int guesses_left, uint64_t revealed);
+void journal_finish(int worker, int room, int slot, int solved, int score);
+void journal_restore(int worker, int room, int slot, const char *name, uint64_t progress, int guesses_left, int finished, int score);
+
+#endif
@@ -0,0 +1,345 @@
+#include <stdio.h>      // Standard input/output functions (snprintf)
+#include <stdlib.h>     // Standard library functions (malloc, calloc, realloc, free)
+#include <string.h>     // String manipulation functions (strcmp, strncpy, memcpy)
+#include "leaderboard.h"
+
+#define LEADERBOARD_INITIAL_BUCKETS 64
+
+static struct leaderboard_entry *allocate_entry(struct leaderboard *leaderboard, int level) {
+    struct leaderboard_entry *entry = leaderboard->free_entries[level];
+    if (entry != NULL) {
+        leaderboard->free_entries[level] = entry->hash_next;
+    } else {
+        entry = malloc(sizeof(struct leaderboard_entry) + level * sizeof(struct leaderboard_link));
+        if (entry == NULL) {
+            return NULL;
+        }
+    }
+
+    entry->level = level;
+    for (int i = 0; i < level; i++) {
+        entry->links[i].next = NULL;
+        entry->links[i].span = 0;
+    }
+    return entry;
+}
+
+static void release_entry(struct leaderboard *leaderboard, struct leaderboard_entry *entry) {
+    entry->hash_next = leaderboard->free_entries[entry->level];
+    leaderboard->free_entries[entry->level] = entry;
+}
+
+int leaderboard_init(struct leaderboard *leaderboard) {
+    memset(leaderboard, 0, sizeof(*leaderboard));
+
+    leaderboard->head = allocate_entry(leaderboard, LEADERBOARD_MAX_LEVEL);
+    leaderboard->buckets = calloc(LEADERBOARD_INITIAL_BUCKETS, sizeof(struct leaderboard_entry *));
+    if (leaderboard->head == NULL || leaderboard->buckets == NULL) {
+        free(leaderboard->head);
+        free(leaderboard->buckets);
+        return -1;
+    }
+
+    leaderboard->bucket_count = LEADERBOARD_INITIAL_BUCKETS;
+    leaderboard->level = 1;
+    leaderboard->random_state = 0x9e3779b97f4a7c15ull ^ (uint64_t)(uintptr_t)leaderboard;
+    return 0;
+}
+
+// Empty the leaderboard, keeping every entry on the free lists for reuse
+void leaderboard_clear(struct leaderboard *leaderboard) {
+    struct leaderboard_entry *entry = leaderboard->head->links[0].next;
+    while (entry != NULL) {
+        struct leaderboard_entry *next = entry->links[0].next;
+        release_entry(leaderboard, entry);
+        entry = next;
+    }
+
+    for (int i = 0; i < LEADERBOARD_MAX_LEVEL; i++) {
+        leaderboard->head->links[i].next = NULL;
+        leaderboard->head->links[i].span = 0;
+    }
+    memset(leaderboard->buckets, 0, leaderboard->bucket_count * sizeof(struct leaderboard_entry *));
+    leaderboard->level = 1;
+    leaderboard->length = 0;
+}
+
+void leaderboard_destroy(struct leaderboard *leaderboard) {
+    leaderboard_clear(leaderboard);
+
+    for (int level = 0; level <= LEADERBOARD_MAX_LEVEL; level++) {
+        while (leaderboard->free_entries[level] != NULL) {
+            struct leaderboard_entry *entry = leaderboard->free_entries[level];
+            leaderboard->free_entries[level] = entry->hash_next;
+            free(entry);
+        }
+    }
+
+    free(leaderboard->head);
+    free(leaderboard->buckets);
+    memset(leaderboard, 0, sizeof(*leaderboard));
+}
+
+// FNV-1a hash of a name
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Double the hash table once it averages more than one entry per bucket
+static void grow_buckets(struct leaderboard *leaderboard) {
+    int new_count = leaderboard->bucket_count * 2;
+    struct leaderboard_entry **buckets = calloc(new_count, sizeof(struct leaderboard_entry *));
+    if (buckets == NULL) {
+        return; // Lookups still work, the chains are just longer
+    }
+
+    for (int i = 0; i < leaderboard->bucket_count; i++) {
+        struct leaderboard_entry *entry = leaderboard->buckets[i];
+        while (entry != NULL) {
+            struct leaderboard_entry *next = entry->hash_next;
+            int bucket = entry->hash & (new_count - 1);
+            entry->hash_next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+
+    free(leaderboard->buckets);
+    leaderboard->buckets = buckets;
+    leaderboard->bucket_count = new_count;
+}
+
+static void unhash_entry(struct leaderboard *leaderboard, struct leaderboard_entry *entry) {
+    struct leaderboard_entry **link = &leaderboard->buckets[entry->hash & (leaderboard->bucket_count - 1)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+}
+
+// Strict ranking order: higher score first, then name, then whichever was inserted first
+static int ranks_before(const struct leaderboard_entry *a, const struct leaderboard_entry *b) {
+    if (a->score != b->score) {
+        return a->score > b->score;
+    }
+    int names = strcmp(a->name, b->name);
+    if (names != 0) {
+        return names < 0;
+    }
+    return a->sequence < b->sequence;
+}
+
+// Each extra level is taken with probability 1/4
+static int random_level(struct leaderboard *leaderboard) {
+    uint64_t x = leaderboard->random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    leaderboard->random_state = x;
+
+    int level = 1;
+    while (level < LEADERBOARD_MAX_LEVEL && (x & 3) == 0) {
+        level++;
+        x >>= 2;
+    }
+    return level;
+}
+
+// Link an entry whose score and name are set into the skip list
+static void link_entry(struct leaderboard *leaderboard, struct leaderboard_entry *entry) {
+    struct leaderboard_entry *update[LEADERBOARD_MAX_LEVEL];
+    int rank[LEADERBOARD_MAX_LEVEL];
+    struct leaderboard_entry *x = leaderboard->head;
+
+    // Find the last entry before the new one on every level, and its rank
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        rank[i] = i == leaderboard->level - 1 ? 0 : rank[i + 1];
+        while (x->links[i].next != NULL && ranks_before(x->links[i].next, entry)) {
+            rank[i] += x->links[i].span;
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+
+    int level = entry->level;
+    if (level > leaderboard->level) {
+        for (int i = leaderboard->level; i < level; i++) {
+            rank[i] = 0;
+            update[i] = leaderboard->head;
+            update[i]->links[i].span = leaderboard->length;
+        }
+        leaderboard->level = level;
+    }
+
+    for (int i = 0; i < level; i++) {
+        entry->links[i].next = update[i]->links[i].next;
+        update[i]->links[i].next = entry;
+        entry->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+        update[i]->links[i].span = rank[0] - rank[i] + 1;
+    }
+
+    // Links above the new entry now jump over one more entry
+    for (int i = level; i < leaderboard->level; i++) {
+        update[i]->links[i].span++;
+    }
+    leaderboard->length++;
+}
+
+static void unlink_entry(struct leaderboard *leaderboard, struct leaderboard_entry *entry) {
+    struct leaderboard_entry *update[LEADERBOARD_MAX_LEVEL];
+    struct leaderboard_entry *x = leaderboard->head;
+
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        while (x->links[i].next != NULL && ranks_before(x->links[i].next, entry)) {
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+
+    for (int i = 0; i < leaderboard->level; i++) {
+        if (update[i]->links[i].next == entry) {
+            update[i]->links[i].span += entry->links[i].span - 1;
+            update[i]->links[i].next = entry->links[i].next;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+
+    while (leaderboard->level > 1 && leaderboard->head->links[leaderboard->level - 1].next == NULL) {
+        leaderboard->level--;
+    }
+    leaderboard->length--;
+}
+
+// Add a new entry, even if another entry already has the same name.
+// Returns the entry, or NULL if memory ran out
+struct leaderboard_entry *leaderboard_insert(struct leaderboard *leaderboard, const char *name, int score) {
+    struct leaderboard_entry *entry = allocate_entry(leaderboard, random_level(leaderboard));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    strncpy(entry->name, name, LEADERBOARD_NAME_SIZE - 1);
+    entry->name[LEADERBOARD_NAME_SIZE - 1] = '\0';
+    entry->score = score;
+    entry->games = 0;
+    entry->sequence = leaderboard->next_sequence++;
+    entry->hash = hash_name(entry->name);
+
+    if (leaderboard->length >= leaderboard->bucket_count) {
+        grow_buckets(leaderboard);
+    }
+    int bucket = entry->hash & (leaderboard->bucket_count - 1);
+    entry->hash_next = leaderboard->buckets[bucket];
+    leaderboard->buckets[bucket] = entry;
+
+    link_entry(leaderboard, entry);
+    return entry;
+}
+
+void leaderboard_remove(struct leaderboard *leaderboard, struct leaderboard_entry *entry) {
+    unlink_entry(leaderboard, entry);
+    unhash_entry(leaderboard, entry);
+    release_entry(leaderboard, entry);
+}
+
+// Returns the entry named name, or NULL if there is none
+struct leaderboard_entry *leaderboard_find(struct leaderboard *leaderboard, const char *name) {
+    uint32_t hash = hash_name(name);
+    struct leaderboard_entry *entry = leaderboard->buckets[hash & (leaderboard->bucket_count - 1)];
+
+    for (; entry != NULL; entry = entry->hash_next) {
+        if (entry->hash == hash && strncmp(entry->name, name, LEADERBOARD_NAME_SIZE - 1) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Add score (earned over games games) to the running total of the player called name, creating
+// their entry if needed. The entry is moved to its new rank. Returns the entry, or NULL if memory ran out
+struct leaderboard_entry *leaderboard_add_score(struct leaderboard *leaderboard, const char *name, int score, int games) {
+    struct leaderboard_entry *entry = leaderboard_find(leaderboard, name);
+    if (entry == NULL) {
+        entry = leaderboard_insert(leaderboard, name, score);
+        if (entry != NULL) {
+            entry->games = games;
+        }
+        return entry;
+    }
+
+    unlink_entry(leaderboard, entry);
+    entry->score += score;
+    entry->games += games;
+    link_entry(leaderboard, entry);
+    return entry;
+}
+
+// Position of an entry, 1 for the highest score
+int leaderboard_rank(struct leaderboard *leaderboard, struct leaderboard_entry *entry) {
+    struct leaderboard_entry *x = leaderboard->head;
+    int rank = 0;
+
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        while (x->links[i].next != NULL &&
+               (x->links[i].next == entry || ranks_before(x->links[i].next, entry))) {
+            rank += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (x == entry) {
+            return rank;
+        }
+    }
+    return 0;
+}
+
+// Highest ranked entry, walk on with leaderboard_next() for a top-K list
+struct leaderboard_entry *leaderboard_first(struct leaderboard *leaderboard) {
+    return leaderboard->head->links[0].next;
+}
+
+struct leaderboard_entry *leaderboard_next(struct leaderboard_entry *entry) {
+    return entry->links[0].next;
+}
+
+// Write the top limit entries (every entry if limit <= 0) as "name:score," into *text, growing it as needed.
+// Returns the text length, or -1 if memory ran out
+int leaderboard_format(struct leaderboard *leaderboard, int limit, char **text, int *text_capacity) {
+    int length = 0;
+    int count = 0;
+
+    for (struct leaderboard_entry *entry = leaderboard_first(leaderboard);
+         entry != NULL && (limit <= 0 || count < limit); entry = leaderboard_next(entry), count++) {
+        // Name, ':', up to 11 digits, ',' and the terminating NUL
+        int needed = length + LEADERBOARD_NAME_SIZE + 14;
+        if (needed > *text_capacity) {
+            int capacity = *text_capacity > 0 ? *text_capacity : 1024;
+            while (capacity < needed) {
+                capacity *= 2;
+            }
+            char *grown = realloc(*text, capacity);
+            if (grown == NULL) {
+                return -1;
+            }
+            *text = grown;
+            *text_capacity = capacity;
+        }
+
+        length += snprintf(*text + length, *text_capacity - length, "%s:%d,", entry->name, entry->score);
+    }
+
+    if (*text == NULL) {
+        *text = malloc(1);
+        if (*text == NULL) {
+            return -1;
+        }
+        *text_capacity = 1;
+    }
+    (*text)[length] = '\0';
+    return length;
+}
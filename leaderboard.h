@@ -0,0 +1,59 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>     // Fixed width integer types (uint32_t, uint64_t)
+
+#define LEADERBOARD_NAME_SIZE 50  // Longest name kept, including the terminating NUL
+#define LEADERBOARD_MAX_LEVEL 24  // Enough levels for tens of millions of entries
+
+struct leaderboard_entry;
+
+// Forward link of a skip list node. span counts the entries the link jumps over (the target included),
+// which is what lets a rank be summed up on the way down instead of counted along the bottom level
+struct leaderboard_link {
+    struct leaderboard_entry *next;
+    int span;
+};
+
+// A ranked player, ordered by score (highest first), then name, then insertion order
+struct leaderboard_entry {
+    char name[LEADERBOARD_NAME_SIZE];
+    int score;
+    int games;                            // Games added into score by leaderboard_add_score()
+    uint64_t sequence;                    // Insertion order, breaks ties between equal names and scores
+    uint32_t hash;
+    struct leaderboard_entry *hash_next;  // Entries with the same hash bucket
+    int level;
+    struct leaderboard_link links[];      // One per level the entry is linked into
+};
+
+// Indexable skip list: insert, remove, rank-of-entry and the start of a top-K walk are all O(log N).
+// Entries are also hashed by name so a players running total can be found without a scan.
+// Removed entries are kept on free lists (one per level) and reused by later inserts
+struct leaderboard {
+    struct leaderboard_entry *head;       // Sentinel with LEADERBOARD_MAX_LEVEL links
+    int level;                            // Levels currently in use
+    int length;
+    uint64_t next_sequence;
+    uint64_t random_state;                // xorshift state for picking entry levels
+
+    struct leaderboard_entry **buckets;   // Name hash table, a power of two in size
+    int bucket_count;
+
+    struct leaderboard_entry *free_entries[LEADERBOARD_MAX_LEVEL + 1]; // Indexed by level
+};
+
+// Function Declarations
+int leaderboard_init(struct leaderboard *leaderboard);
+void leaderboard_clear(struct leaderboard *leaderboard);
+void leaderboard_destroy(struct leaderboard *leaderboard);
+struct leaderboard_entry *leaderboard_insert(struct leaderboard *leaderboard, const char *name, int score);
+void leaderboard_remove(struct leaderboard *leaderboard, struct leaderboard_entry *entry);
+struct leaderboard_entry *leaderboard_find(struct leaderboard *leaderboard, const char *name);
+struct leaderboard_entry *leaderboard_add_score(struct leaderboard *leaderboard, const char *name, int score, int games);
+int leaderboard_rank(struct leaderboard *leaderboard, struct leaderboard_entry *entry);
+struct leaderboard_entry *leaderboard_first(struct leaderboard *leaderboard);
+struct leaderboard_entry *leaderboard_next(struct leaderboard_entry *entry);
+int leaderboard_format(struct leaderboard *leaderboard, int limit, char **text, int *text_capacity);
+
+#endif
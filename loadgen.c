@@ -0,0 +1,642 @@
+#include <stdio.h>      // Standard input/output functions
+#include <stdlib.h>     // Standard library functions (malloc, free, exit)
+#include <string.h>     // String manipulation functions (memcmp, memmove, memchr, strerror)
+#include <unistd.h>     // POSIX API functions (close, getopt)
+#include <arpa/inet.h>  // Networking functions (inet_pton, htons)
+#include <sys/socket.h> // Socket programming functions
+#include <errno.h>      // Error codes (EAGAIN, EINPROGRESS, EINTR)
+#include <pthread.h>    // One event loop per thread
+#include <time.h>       // Progress reports (nanosleep)
+#include "reactor.h"    // Edge-triggered epoll event loop and timers
+#include "metrics.h"    // Log-linear latency histograms
+#include "log.h"        // Event loop errors
+
+// Synthetic load for hangman_server: thousands of simulated players speaking the legacy protocol
+// (username line, 'r', one byte guesses, short score) over loopback, each playing game after game
+
+// Load Generator Defaults
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT 8080
+#define DEFAULT_PLAYERS 1000    // Simulated players connected at any one time
+#define DEFAULT_THREADS 1
+#define DEFAULT_DURATION 10     // Seconds
+#define MAX_GUESSES 8           // Wrong guesses allowed by the server
+#define RETRY_DELAY_MS 100      // Before a player the server turned away tries again
+#define BOT_INPUT_SIZE 1024     // Enough for the largest fixed size message, a reveal of a 64 letter word
+#define MAX_WORD_LENGTH 64
+
+static const char ready_message[] = "All players have entered their usernames. Ready up by entering 'r'\n";
+static const char game_over_message[] = "All Players have finished! Generating leaderboard...\n";
+static const char guess_order[] = "ETAOINSHRDLCUMWFGYPBVKJXQZ"; // Most common letters first
+
+// What a simulated player is waiting for from the server
+enum bot_state {
+    BOT_IDLE,          // Not connected, waiting to (re)connect
+    BOT_CONNECTING,    // Non-blocking connect() in progress
+    BOT_JOIN_STATUS,   // int: 0 when placed in a room, -1 when the server is full
+    BOT_READY_PROMPT,  // Every username is in
+    BOT_GAME_START,    // int: word length
+    BOT_REVEAL,        // int per letter of the word: 1 where the guess was found
+    BOT_GAME_OVER,     // Every player has finished
+    BOT_LEADERBOARD    // NUL terminated leaderboard text
+};
+
+// Totals for one thread. Written only by that thread, read by the main thread for progress reports
+struct load_stats {
+    uint64_t connections;       // Players placed in a room
+    uint64_t rejected;          // Players turned away because the server was full
+    uint64_t games;             // Games played through to the leaderboard
+    uint64_t guesses;
+    uint64_t abandoned;         // Players who hung up mid game on purpose (see -x)
+    uint64_t errors;            // Failed connects, unexpected hang ups and protocol mismatches
+    struct histogram connect_latency; // connect() to join status, in microseconds
+    struct histogram guess_latency;   // Guess sent to reveal received, in microseconds
+};
+
+struct load_thread;
+
+// A single simulated player, reconnecting as a new player each time a game ends
+struct bot {
+    struct load_thread *thread;
+    int fd;
+    enum bot_state state;
+    int serial;                 // Bumped on every connection, so each one gets a fresh username
+    struct reactor_timer timer; // Think time before the next message, or the reconnect delay
+    uint64_t sent_at;           // When the last guess (or connect) went out
+
+    char input[BOT_INPUT_SIZE];
+    int input_length;
+
+    int word_length;
+    uint64_t revealed;          // Bit j set once position j has been found
+    int guesses_left;
+    int next_letter;            // Index into guess_order
+    int abandon_after;          // Guesses before hanging up on purpose, -1 to play the game out
+};
+
+// Each thread runs its own event loop over its share of the players
+struct load_thread {
+    int index;
+    pthread_t thread;
+    struct reactor reactor;
+    struct bot *bots;
+    int bot_count;
+    int running;
+    uint64_t random_state;      // xorshift state for think times and abandon rolls
+    struct reactor_timer stop_timer;
+    struct load_stats stats;
+};
+
+// Function Declarations
+void *run_load_thread(void *arg);
+void connect_bot(struct bot *bot);
+void disconnect_bot(struct bot *bot, int retry_ms);
+void on_bot_event(int fd, uint32_t events, void *arg);
+void on_bot_timer(void *arg);
+void on_stop_timer(void *arg);
+int handle_bot_input(struct bot *bot);
+int send_bot(struct bot *bot, const void *data, int length);
+void send_guess(struct bot *bot);
+int think_time(struct load_thread *thread);
+uint64_t next_random(struct load_thread *thread);
+void print_report(struct load_thread *threads, int thread_count, double seconds);
+
+// Settings shared by every thread, read only once they have started
+struct sockaddr_in server_address;
+int think_ms = 0;               // Mean delay before each ready and guess
+int abandon_percent = 0;        // Chance of a player hanging up mid game
+int duration_seconds = DEFAULT_DURATION;
+
+int main(int argc, char **argv) {
+    int opt;
+    const char *host = DEFAULT_HOST;
+    int port = DEFAULT_PORT;
+    int player_count = DEFAULT_PLAYERS;
+    int thread_count = DEFAULT_THREADS;
+
+    while ((opt = getopt(argc, argv, "H:P:c:t:d:k:x:")) != -1) {
+        switch (opt) {
+            case 'H':
+                host = optarg;
+                break;
+            case 'P':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                player_count = atoi(optarg);
+                break;
+            case 't':
+                thread_count = atoi(optarg);
+                break;
+            case 'd':
+                duration_seconds = atoi(optarg);
+                break;
+            case 'k':
+                think_ms = atoi(optarg);
+                break;
+            case 'x':
+                abandon_percent = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-H host] [-P port] [-c players] [-t threads] [-d seconds] "
+                                "[-k think ms] [-x abandon percent]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (player_count <= 0 || thread_count <= 0 || duration_seconds <= 0 || think_ms < 0) {
+        fprintf(stderr, "Players, threads and duration must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+    if (thread_count > player_count) {
+        thread_count = player_count;
+    }
+
+    memset(&server_address, 0, sizeof(server_address));
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &server_address.sin_addr) != 1) {
+        fprintf(stderr, "Invalid address: %s\n", host);
+        exit(EXIT_FAILURE);
+    }
+
+    struct load_thread *threads = calloc(thread_count, sizeof(struct load_thread));
+    if (threads == NULL) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%d players on %d thread(s) against %s:%d for %d s, think time %d ms, abandon rate %d%%\n",
+           player_count, thread_count, host, port, duration_seconds, think_ms, abandon_percent);
+
+    // Spread the players evenly, the first threads take one extra when they don't divide
+    int first_bot = 0;
+    for (int i = 0; i < thread_count; i++) {
+        struct load_thread *thread = &threads[i];
+        thread->index = i;
+        thread->bot_count = player_count / thread_count + (i < player_count % thread_count);
+        thread->random_state = 0x9E3779B97F4A7C15ULL * (i + 1) ^ (uint64_t)time(NULL);
+        thread->bots = calloc(thread->bot_count, sizeof(struct bot));
+        if (thread->bots == NULL) {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+
+        if (reactor_init(&thread->reactor, REACTOR_EPOLL) < 0) {
+            perror("Event loop creation failed");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int b = 0; b < thread->bot_count; b++) {
+            struct bot *bot = &thread->bots[b];
+            bot->thread = thread;
+            bot->fd = -1;
+            bot->serial = (first_bot + b) * 1000;
+            reactor_timer_init(&bot->timer, on_bot_timer, bot);
+        }
+        first_bot += thread->bot_count;
+    }
+
+    // The event loops report their errors through the log thread
+    fflush(stdout);
+    if (log_start(LOG_WARN) < 0) {
+        perror("Log thread creation failed");
+        exit(EXIT_FAILURE);
+    }
+    atexit(log_stop);
+
+    uint64_t started = metrics_now_us();
+    for (int i = 0; i < thread_count; i++) {
+        int error = pthread_create(&threads[i].thread, NULL, run_load_thread, &threads[i]);
+        if (error != 0) {
+            log_error("Thread creation failed: %s", strerror(error));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Print the rates of the last second until the run is over
+    uint64_t last_connections = 0;
+    uint64_t last_guesses = 0;
+    for (int second = 1; second <= duration_seconds; second++) {
+        struct timespec interval = {1, 0};
+        while (nanosleep(&interval, &interval) < 0 && errno == EINTR) {
+        }
+
+        uint64_t connections = 0;
+        uint64_t guesses = 0;
+        uint64_t games = 0;
+        for (int i = 0; i < thread_count; i++) {
+            connections += __atomic_load_n(&threads[i].stats.connections, __ATOMIC_RELAXED);
+            guesses += __atomic_load_n(&threads[i].stats.guesses, __ATOMIC_RELAXED);
+            games += __atomic_load_n(&threads[i].stats.games, __ATOMIC_RELAXED);
+        }
+        printf("[%3d s] connections/s %llu  guesses/s %llu  games %llu\n", second,
+               (unsigned long long)(connections - last_connections), (unsigned long long)(guesses - last_guesses),
+               (unsigned long long)games);
+        fflush(stdout);
+        last_connections = connections;
+        last_guesses = guesses;
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    double seconds = (metrics_now_us() - started) / 1e6;
+
+    print_report(threads, thread_count, seconds);
+
+    for (int i = 0; i < thread_count; i++) {
+        reactor_destroy(&threads[i].reactor);
+        free(threads[i].bots);
+    }
+    free(threads);
+    return 0;
+}
+
+// Connect every player of the thread, then run its event loop until the duration is up
+void *run_load_thread(void *arg) {
+    struct load_thread *thread = arg;
+
+    thread->running = 1;
+    reactor_timer_init(&thread->stop_timer, on_stop_timer, thread);
+    reactor_timer_arm(&thread->reactor, &thread->stop_timer, duration_seconds * 1000);
+
+    for (int b = 0; b < thread->bot_count; b++) {
+        connect_bot(&thread->bots[b]);
+    }
+
+    reactor_run(&thread->reactor);
+
+    for (int b = 0; b < thread->bot_count; b++) {
+        struct bot *bot = &thread->bots[b];
+        reactor_timer_cancel(&thread->reactor, &bot->timer);
+        if (bot->fd >= 0) {
+            reactor_remove(&thread->reactor, bot->fd);
+            close(bot->fd);
+        }
+    }
+    return NULL;
+}
+
+void on_stop_timer(void *arg) {
+    struct load_thread *thread = arg;
+    thread->running = 0;
+    reactor_stop(&thread->reactor);
+}
+
+// Start a new player: a non-blocking connect(), finished when the socket becomes writable
+void connect_bot(struct bot *bot) {
+    struct load_thread *thread = bot->thread;
+
+    bot->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (bot->fd < 0) {
+        perror("Socket failed");
+        metrics_add(&thread->stats.errors, 1);
+        disconnect_bot(bot, RETRY_DELAY_MS);
+        return;
+    }
+
+    bot->state = BOT_CONNECTING;
+    bot->input_length = 0;
+    bot->serial++;
+    bot->sent_at = metrics_now_us();
+
+    if (connect(bot->fd, (struct sockaddr *)&server_address, sizeof(server_address)) < 0 && errno != EINPROGRESS) {
+        metrics_add(&thread->stats.errors, 1);
+        disconnect_bot(bot, RETRY_DELAY_MS);
+        return;
+    }
+
+    if (reactor_add(&thread->reactor, bot->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, on_bot_event, bot) < 0) {
+        perror("Event loop registration failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Close a players socket and start over as a new player, straight away or after retry_ms
+void disconnect_bot(struct bot *bot, int retry_ms) {
+    struct load_thread *thread = bot->thread;
+
+    reactor_timer_cancel(&thread->reactor, &bot->timer);
+    if (bot->fd >= 0) {
+        reactor_remove(&thread->reactor, bot->fd);
+        close(bot->fd);
+        bot->fd = -1;
+    }
+    bot->state = BOT_IDLE;
+
+    if (!thread->running) {
+        return;
+    }
+    if (retry_ms > 0) {
+        reactor_timer_arm(&thread->reactor, &bot->timer, retry_ms);
+    } else {
+        connect_bot(bot);
+    }
+}
+
+void on_bot_event(int fd, uint32_t events, void *arg) {
+    struct bot *bot = arg;
+    struct load_thread *thread = bot->thread;
+
+    if (bot->state == BOT_CONNECTING) {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+            return;
+        }
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            metrics_add(&thread->stats.errors, 1);
+            disconnect_bot(bot, RETRY_DELAY_MS);
+            return;
+        }
+        bot->state = BOT_JOIN_STATUS;
+    }
+
+    if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        return;
+    }
+
+    // Edge-triggered: read until the socket is drained, handling every complete message on the way
+    for (;;) {
+        ssize_t valread = recv(fd, bot->input + bot->input_length, sizeof(bot->input) - bot->input_length, 0);
+        if (valread < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            metrics_add(&thread->stats.errors, 1);
+            disconnect_bot(bot, RETRY_DELAY_MS);
+            return;
+        }
+        if (valread == 0) {
+            // The server only hangs up first on players it has dropped
+            metrics_add(&thread->stats.errors, 1);
+            disconnect_bot(bot, RETRY_DELAY_MS);
+            return;
+        }
+
+        bot->input_length += valread;
+        if (handle_bot_input(bot) < 0) {
+            return; // The player has disconnected (and may already be reconnecting on a new socket)
+        }
+    }
+}
+
+// Act on every complete message buffered for a player.
+// Returns -1 if the player disconnected, 0 once it is waiting for more input
+int handle_bot_input(struct bot *bot) {
+    struct load_thread *thread = bot->thread;
+
+    for (;;) {
+        int consumed = 0;
+
+        switch (bot->state) {
+            case BOT_JOIN_STATUS: {
+                int status;
+                if (bot->input_length < (int)sizeof(status)) {
+                    return 0;
+                }
+                memcpy(&status, bot->input, sizeof(status));
+                consumed = sizeof(status);
+
+                if (status != 0) {
+                    metrics_add(&thread->stats.rejected, 1);
+                    disconnect_bot(bot, RETRY_DELAY_MS);
+                    return -1;
+                }
+                metrics_add(&thread->stats.connections, 1);
+                histogram_record(&thread->stats.connect_latency, metrics_now_us() - bot->sent_at, 1);
+
+                char name[32];
+                int length = snprintf(name, sizeof(name), "bot%d\n", bot->serial);
+                if (send_bot(bot, name, length) < 0) {
+                    return -1;
+                }
+                bot->state = BOT_READY_PROMPT;
+                break;
+            }
+            case BOT_READY_PROMPT:
+                if (bot->input_length < (int)strlen(ready_message)) {
+                    return 0;
+                }
+                if (memcmp(bot->input, ready_message, strlen(ready_message)) != 0) {
+                    metrics_add(&thread->stats.errors, 1);
+                    disconnect_bot(bot, RETRY_DELAY_MS);
+                    return -1;
+                }
+                consumed = strlen(ready_message);
+                bot->state = BOT_GAME_START;
+
+                // Ready up after the think time
+                if (think_ms > 0) {
+                    reactor_timer_arm(&thread->reactor, &bot->timer, think_time(thread));
+                } else if (send_bot(bot, "r\n", 2) < 0) {
+                    return -1;
+                }
+                break;
+            case BOT_GAME_START: {
+                int word_length;
+                if (bot->input_length < (int)sizeof(word_length)) {
+                    return 0;
+                }
+                memcpy(&word_length, bot->input, sizeof(word_length));
+                consumed = sizeof(word_length);
+
+                if (word_length <= 0 || word_length > MAX_WORD_LENGTH) {
+                    metrics_add(&thread->stats.errors, 1);
+                    disconnect_bot(bot, RETRY_DELAY_MS);
+                    return -1;
+                }
+                bot->word_length = word_length;
+                bot->revealed = 0;
+                bot->guesses_left = MAX_GUESSES;
+                bot->next_letter = 0;
+                bot->abandon_after = -1;
+                if (abandon_percent > 0 && (int)(next_random(thread) % 100) < abandon_percent) {
+                    bot->abandon_after = (int)(next_random(thread) % MAX_GUESSES);
+                }
+                bot->state = BOT_REVEAL;
+
+                if (think_ms > 0) {
+                    reactor_timer_arm(&thread->reactor, &bot->timer, think_time(thread));
+                } else {
+                    send_guess(bot);
+                    if (bot->state != BOT_REVEAL) {
+                        return -1;
+                    }
+                }
+                break;
+            }
+            case BOT_REVEAL: {
+                int length = bot->word_length * (int)sizeof(int);
+                if (bot->input_length < length) {
+                    return 0;
+                }
+                consumed = length;
+
+                metrics_add(&thread->stats.guesses, 1);
+                histogram_record(&thread->stats.guess_latency, metrics_now_us() - bot->sent_at, 1);
+
+                int found = 0;
+                for (int j = 0; j < bot->word_length; j++) {
+                    int position;
+                    memcpy(&position, bot->input + j * sizeof(int), sizeof(int));
+                    if (position) {
+                        bot->revealed |= (uint64_t)1 << j;
+                        found = 1;
+                    }
+                }
+                if (!found) {
+                    bot->guesses_left--;
+                }
+
+                uint64_t full = bot->word_length == 64 ? ~(uint64_t)0 : ((uint64_t)1 << bot->word_length) - 1;
+                if (bot->revealed == full || bot->guesses_left == 0) {
+                    bot->state = BOT_GAME_OVER;
+                } else if (think_ms > 0) {
+                    reactor_timer_arm(&thread->reactor, &bot->timer, think_time(thread));
+                } else {
+                    send_guess(bot);
+                    if (bot->state != BOT_REVEAL) {
+                        return -1;
+                    }
+                }
+                break;
+            }
+            case BOT_GAME_OVER: {
+                if (bot->input_length < (int)strlen(game_over_message)) {
+                    return 0;
+                }
+                if (memcmp(bot->input, game_over_message, strlen(game_over_message)) != 0) {
+                    metrics_add(&thread->stats.errors, 1);
+                    disconnect_bot(bot, RETRY_DELAY_MS);
+                    return -1;
+                }
+                consumed = strlen(game_over_message);
+
+                // Legacy clients still send their own score, the server reads and discards it
+                uint64_t full = bot->word_length == 64 ? ~(uint64_t)0 : ((uint64_t)1 << bot->word_length) - 1;
+                short score = bot->revealed == full ? (short)bot->guesses_left : 0;
+                if (send_bot(bot, &score, sizeof(score)) < 0) {
+                    return -1;
+                }
+                bot->state = BOT_LEADERBOARD;
+                break;
+            }
+            case BOT_LEADERBOARD: {
+                // The leaderboard can be longer than the buffer, so it is discarded up to its NUL as it comes in
+                char *end = memchr(bot->input, '\0', bot->input_length);
+                if (end == NULL) {
+                    bot->input_length = 0;
+                    return 0;
+                }
+                metrics_add(&thread->stats.games, 1);
+                disconnect_bot(bot, 0);
+                return -1;
+            }
+            default:
+                return 0;
+        }
+
+        memmove(bot->input, bot->input + consumed, bot->input_length - consumed);
+        bot->input_length -= consumed;
+    }
+}
+
+// Think time is up: send the ready up or the next guess
+void on_bot_timer(void *arg) {
+    struct bot *bot = arg;
+
+    switch (bot->state) {
+        case BOT_IDLE:
+            connect_bot(bot);
+            break;
+        case BOT_GAME_START:
+            send_bot(bot, "r\n", 2);
+            break;
+        case BOT_REVEAL:
+            send_guess(bot);
+            break;
+        default:
+            break;
+    }
+}
+
+// Guess the next most common letter, or hang up if this player was picked to abandon the game
+void send_guess(struct bot *bot) {
+    struct load_thread *thread = bot->thread;
+
+    if (bot->abandon_after == 0 || bot->next_letter >= (int)strlen(guess_order)) {
+        metrics_add(&thread->stats.abandoned, 1);
+        disconnect_bot(bot, 0);
+        return;
+    }
+    bot->abandon_after--;
+
+    bot->sent_at = metrics_now_us();
+    send_bot(bot, &guess_order[bot->next_letter++], 1);
+}
+
+// Messages are a few bytes and the socket buffer is never full, so a short write counts as an error.
+// Returns -1 if the player was disconnected
+int send_bot(struct bot *bot, const void *data, int length) {
+    if (send(bot->fd, data, length, MSG_NOSIGNAL | MSG_DONTWAIT) != length) {
+        metrics_add(&bot->thread->stats.errors, 1);
+        disconnect_bot(bot, RETRY_DELAY_MS);
+        return -1;
+    }
+    return 0;
+}
+
+// Uniformly random between 0 and twice think_ms, so the mean is think_ms
+int think_time(struct load_thread *thread) {
+    return (int)(next_random(thread) % (2 * (uint64_t)think_ms + 1));
+}
+
+uint64_t next_random(struct load_thread *thread) {
+    uint64_t x = thread->random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    thread->random_state = x;
+    return x;
+}
+
+// Sum the totals of every thread and print the rates and latency percentiles
+void print_report(struct load_thread *threads, int thread_count, double seconds) {
+    static struct load_stats total;
+
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < thread_count; i++) {
+        struct load_stats *stats = &threads[i].stats;
+        total.connections += stats->connections;
+        total.rejected += stats->rejected;
+        total.games += stats->games;
+        total.guesses += stats->guesses;
+        total.abandoned += stats->abandoned;
+        total.errors += stats->errors;
+        for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+            total.connect_latency.counts[bucket] += stats->connect_latency.counts[bucket];
+            total.guess_latency.counts[bucket] += stats->guess_latency.counts[bucket];
+        }
+    }
+
+    printf("\nDuration:        %.2f s\n", seconds);
+    printf("Connections:     %llu (%.0f/s), %llu rejected\n", (unsigned long long)total.connections,
+           total.connections / seconds, (unsigned long long)total.rejected);
+    printf("Games:           %llu (%.0f/s)\n", (unsigned long long)total.games, total.games / seconds);
+    printf("Guesses:         %llu (%.0f/s)\n", (unsigned long long)total.guesses, total.guesses / seconds);
+    printf("Abandoned:       %llu\n", (unsigned long long)total.abandoned);
+    printf("Errors:          %llu\n", (unsigned long long)total.errors);
+    printf("Join latency:    p50 %.3f ms  p99 %.3f ms  p999 %.3f ms\n",
+           histogram_percentile(&total.connect_latency, 0.5) / 1e3,
+           histogram_percentile(&total.connect_latency, 0.99) / 1e3,
+           histogram_percentile(&total.connect_latency, 0.999) / 1e3);
+    printf("Guess latency:   p50 %.3f ms  p99 %.3f ms  p999 %.3f ms\n",
+           histogram_percentile(&total.guess_latency, 0.5) / 1e3,
+           histogram_percentile(&total.guess_latency, 0.99) / 1e3,
+           histogram_percentile(&total.guess_latency, 0.999) / 1e3);
+}
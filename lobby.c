@@ -0,0 +1,108 @@
+#include <stddef.h>     // NULL
+#include "connection.h"
+#include "lobby.h"
+
+void lobby_init(struct lobby *lobby) {
+    lobby->players = NULL;
+    lobby->player_count = 0;
+    lobby->queue_head = NULL;
+    lobby->queue_tail = NULL;
+    lobby->queued = 0;
+}
+
+// Add a player who isn't in a room, either just connected or back from a finished game
+void lobby_enter(struct lobby *lobby, struct connection *connection) {
+    connection->lobby_prev = NULL;
+    connection->lobby_next = lobby->players;
+    if (lobby->players != NULL) {
+        lobby->players->lobby_prev = connection;
+    }
+    lobby->players = connection;
+    connection->in_lobby = 1;
+    lobby->player_count++;
+}
+
+static void dequeue(struct lobby *lobby, struct connection *connection) {
+    if (connection->queue_prev != NULL) {
+        connection->queue_prev->queue_next = connection->queue_next;
+    } else {
+        lobby->queue_head = connection->queue_next;
+    }
+    if (connection->queue_next != NULL) {
+        connection->queue_next->queue_prev = connection->queue_prev;
+    } else {
+        lobby->queue_tail = connection->queue_prev;
+    }
+    connection->queue_prev = NULL;
+    connection->queue_next = NULL;
+    connection->in_queue = 0;
+    lobby->queued--;
+}
+
+// Take a player out of the lobby, and out of the queue if they were waiting in it
+void lobby_leave(struct lobby *lobby, struct connection *connection) {
+    if (!connection->in_lobby) {
+        return;
+    }
+    if (connection->in_queue) {
+        dequeue(lobby, connection);
+    }
+
+    if (connection->lobby_prev != NULL) {
+        connection->lobby_prev->lobby_next = connection->lobby_next;
+    } else {
+        lobby->players = connection->lobby_next;
+    }
+    if (connection->lobby_next != NULL) {
+        connection->lobby_next->lobby_prev = connection->lobby_prev;
+    }
+    connection->lobby_prev = NULL;
+    connection->lobby_next = NULL;
+    connection->in_lobby = 0;
+    lobby->player_count--;
+}
+
+// Queue a ready player behind everyone already waiting. now is when they started waiting
+void lobby_enqueue(struct lobby *lobby, struct connection *connection, uint64_t now) {
+    connection->queued_at = now;
+    connection->queue_next = NULL;
+    connection->queue_prev = lobby->queue_tail;
+    if (lobby->queue_tail != NULL) {
+        lobby->queue_tail->queue_next = connection;
+    } else {
+        lobby->queue_head = connection;
+    }
+    lobby->queue_tail = connection;
+    connection->in_queue = 1;
+    lobby->queued++;
+}
+
+// Take the longest waiting player out of the lobby for a game. Returns NULL if nobody is queued
+struct connection *lobby_take(struct lobby *lobby) {
+    struct connection *connection = lobby->queue_head;
+    if (connection != NULL) {
+        lobby_leave(lobby, connection);
+    }
+    return connection;
+}
+
+// Number of queued players to start a game with now, or 0 to keep waiting. A full game starts straight
+// away; a smaller one of at least min_players starts once the longest waiting player has waited max_wait
+int lobby_match_size(const struct lobby *lobby, uint64_t now, int min_players, int max_players, uint64_t max_wait) {
+    if (lobby->queued >= max_players) {
+        return max_players;
+    }
+    if (lobby->queued >= min_players && now - lobby->queue_head->queued_at >= max_wait) {
+        return lobby->queued;
+    }
+    return 0;
+}
+
+// When the queue can next start a smaller game without any more players, in the same clock as
+// lobby_enqueue(). Returns 0 if there aren't min_players queued
+uint64_t lobby_next_match(const struct lobby *lobby, int min_players, uint64_t max_wait) {
+    if (lobby->queued == 0 || lobby->queued < min_players) {
+        return 0;
+    }
+    return lobby->queue_head->queued_at + max_wait;
+}
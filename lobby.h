@@ -0,0 +1,27 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include <stdint.h>     // Fixed width integer types (uint64_t)
+
+struct connection;
+
+// Players on a worker who aren't in a game: still sending a username, not yet ready, or queued for the
+// next game. Ready players wait in a queue, longest waiting first, and games are formed from its head
+struct lobby {
+    struct connection *players;     // Everyone in the lobby, queued or not
+    int player_count;
+    struct connection *queue_head;  // Longest waiting
+    struct connection *queue_tail;
+    int queued;
+};
+
+// Function Declarations
+void lobby_init(struct lobby *lobby);
+void lobby_enter(struct lobby *lobby, struct connection *connection);
+void lobby_leave(struct lobby *lobby, struct connection *connection);
+void lobby_enqueue(struct lobby *lobby, struct connection *connection, uint64_t now);
+struct connection *lobby_take(struct lobby *lobby);
+int lobby_match_size(const struct lobby *lobby, uint64_t now, int min_players, int max_players, uint64_t max_wait);
+uint64_t lobby_next_match(const struct lobby *lobby, int min_players, uint64_t max_wait);
+
+#endif
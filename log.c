@@ -0,0 +1,401 @@
+#include <stdio.h>      // Standard input/output functions (snprintf)
+#include <stdlib.h>     // Standard library functions (malloc, free)
+#include <stdarg.h>     // Variable arguments (va_list)
+#include <string.h>     // String manipulation functions (memcpy, strcmp, strlen)
+#include <strings.h>    // Case insensitive compare (strcasecmp)
+#include <unistd.h>     // POSIX API functions (write)
+#include <errno.h>      // Error codes (EINTR)
+#include <time.h>       // Record timestamps (clock_gettime, localtime_r)
+#include <pthread.h>    // Log thread
+#include "log.h"
+#include "ring.h"       // Per thread record rings
+
+#define LOG_PAYLOAD_SIZE (LOG_RECORD_SIZE - 20)
+#define LOG_BATCH_SIZE 65536  // Formatted output written with one write() call
+
+// A log call as it was made: the format pointer and the raw argument values, formatted later.
+// Integers, doubles and pointers take 8 bytes each, strings are copied with their NUL
+struct log_record {
+    uint64_t time_ns;         // CLOCK_REALTIME when the call was made
+    const char *format;
+    uint16_t length;          // Payload bytes used
+    uint8_t level;
+    uint8_t truncated;        // The arguments didn't all fit, the rest are shown as "..."
+    unsigned char payload[LOG_PAYLOAD_SIZE];
+};
+
+_Static_assert(sizeof(struct log_record) == LOG_RECORD_SIZE, "log records must be LOG_RECORD_SIZE bytes");
+
+// Formatted output waiting to be written by the log thread
+struct log_batch {
+    char *data;
+    size_t used;
+};
+
+// How a conversion's argument was passed
+enum log_argument {
+    ARG_NONE,      // No argument (%%) or an unsupported conversion, printed as it stands
+    ARG_INT,
+    ARG_LONG,
+    ARG_LONG_LONG,
+    ARG_SIZE,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER
+};
+
+int log_level = LOG_INFO;
+
+static struct ring_set rings = RING_SET_INITIALIZER(sizeof(struct log_record), LOG_RING_SLOTS);
+static __thread struct ring *thread_ring = NULL;
+static pthread_t log_thread;
+static int log_running = 0;
+
+static const char *level_names[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+
+// Function Declarations
+static void *run_log_thread(void *arg);
+
+// Start the thread that formats and writes every threads records, logging at level and above
+int log_start(int level) {
+    log_level = level;
+    __atomic_store_n(&log_running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&log_thread, NULL, run_log_thread, NULL) != 0) {
+        log_running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Write out everything logged so far and stop the log thread
+void log_stop(void) {
+    if (!__atomic_exchange_n(&log_running, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    pthread_join(log_thread, NULL);
+}
+
+// "debug", "info", "warn" or "error" to its level, or -1
+int log_parse_level(const char *name) {
+    static const char *names[] = {"debug", "info", "warn", "error"};
+    for (int level = LOG_DEBUG; level <= LOG_ERROR; level++) {
+        if (strcasecmp(name, names[level]) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+// Parse the conversion starting just after a '%'. Returns the length of the conversion (flags,
+// width, precision, modifiers and the conversion character) and how its argument is passed
+static int parse_conversion(const char *conversion, enum log_argument *argument) {
+    const char *p = conversion;
+    int longs = 0;
+    int size = 0;
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    for (;; p++) {
+        if (*p == 'l') {
+            longs++;
+        } else if (*p == 'j') {
+            longs = 2;
+        } else if (*p == 'z' || *p == 't') {
+            size = 1;
+        } else if (*p != 'h') {
+            break;
+        }
+    }
+
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            *argument = size ? ARG_SIZE : longs >= 2 ? ARG_LONG_LONG : longs == 1 ? ARG_LONG : ARG_INT;
+            break;
+        case 'c':
+            *argument = ARG_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            *argument = ARG_DOUBLE;
+            break;
+        case 's':
+            *argument = ARG_STRING;
+            break;
+        case 'p':
+            *argument = ARG_POINTER;
+            break;
+        case '\0':
+            *argument = ARG_NONE;
+            return (int)(p - conversion);
+        default:
+            *argument = ARG_NONE;
+            break;
+    }
+    return (int)(p - conversion) + 1;
+}
+
+// Copy the call into the threads ring: a timestamp, the format pointer and the raw arguments.
+// Never blocks, if the log thread has fallen LOG_RING_SLOTS records behind the record is dropped
+void log_write(int level, const char *format, ...) {
+    struct log_record *record = ring_claim(&rings, &thread_ring);
+    if (record == NULL) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    record->time_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    record->format = format;
+    record->level = (uint8_t)level;
+    record->truncated = 0;
+
+    va_list args;
+    va_start(args, format);
+    size_t length = 0;
+    for (const char *p = format; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        enum log_argument argument;
+        p += parse_conversion(p + 1, &argument);
+
+        uint64_t value = 0;
+        const char *string = NULL;
+        switch (argument) {
+            case ARG_NONE:
+                continue;
+            case ARG_INT:
+                value = (uint64_t)(int64_t)va_arg(args, int);
+                break;
+            case ARG_LONG:
+                value = (uint64_t)va_arg(args, long);
+                break;
+            case ARG_LONG_LONG:
+                value = (uint64_t)va_arg(args, long long);
+                break;
+            case ARG_SIZE:
+                value = (uint64_t)va_arg(args, size_t);
+                break;
+            case ARG_DOUBLE: {
+                double number = va_arg(args, double);
+                memcpy(&value, &number, sizeof(value));
+                break;
+            }
+            case ARG_STRING:
+                string = va_arg(args, const char *);
+                if (string == NULL) {
+                    string = "(null)";
+                }
+                break;
+            case ARG_POINTER:
+                value = (uint64_t)(uintptr_t)va_arg(args, void *);
+                break;
+        }
+
+        if (record->truncated) {
+            continue; // Keep walking so va_arg stays in step, but nothing more fits
+        }
+        if (string != NULL) {
+            size_t string_length = strlen(string);
+            if (length + string_length + 1 > LOG_PAYLOAD_SIZE) {
+                // Keep as much of the string as fits and mark the rest missing
+                string_length = LOG_PAYLOAD_SIZE - length - 1;
+                record->truncated = 1;
+            }
+            memcpy(record->payload + length, string, string_length);
+            record->payload[length + string_length] = '\0';
+            length += string_length + 1;
+        } else if (length + sizeof(value) <= LOG_PAYLOAD_SIZE) {
+            memcpy(record->payload + length, &value, sizeof(value));
+            length += sizeof(value);
+        } else {
+            record->truncated = 1;
+        }
+    }
+    va_end(args);
+    record->length = (uint16_t)length;
+
+    ring_commit(thread_ring);
+}
+
+// Append one formatted line for record to out, cut short if it doesn't fit in space. Returns the bytes written
+static size_t format_record(const struct log_record *record, char *out, size_t space) {
+    static time_t cached_second = -1;  // Only the log thread formats records
+    static char cached_time[32];
+
+    time_t second = (time_t)(record->time_ns / 1000000000);
+    if (second != cached_second) {
+        struct tm local;
+        localtime_r(&second, &local);
+        strftime(cached_time, sizeof(cached_time), "%Y-%m-%d %H:%M:%S", &local);
+        cached_second = second;
+    }
+
+    size_t used = (size_t)snprintf(out, space, "%s.%03d %s ", cached_time,
+                                   (int)(record->time_ns / 1000000 % 1000), level_names[record->level]);
+
+    size_t offset = 0;
+    int missing = 0;
+    for (const char *p = record->format; *p != '\0' && used < space - 1; p++) {
+        if (*p != '%') {
+            out[used++] = *p;
+            continue;
+        }
+
+        enum log_argument argument;
+        int conversion_length = parse_conversion(p + 1, &argument);
+        char conversion[32];
+        if (conversion_length + 2 > (int)sizeof(conversion)) {
+            conversion_length = sizeof(conversion) - 2;
+        }
+        conversion[0] = '%';
+        memcpy(conversion + 1, p + 1, conversion_length);
+        conversion[conversion_length + 1] = '\0';
+        p += conversion_length;
+
+        if (argument == ARG_NONE) {
+            if (conversion_length == 1 && p[0] == '%') {
+                out[used++] = '%';
+            }
+            continue;
+        }
+
+        // Arguments that didn't fit in the record
+        uint64_t value = 0;
+        size_t needed = argument == ARG_STRING ? 1 : sizeof(value);
+        if (missing || offset + needed > record->length) {
+            if (!missing) {
+                used += (size_t)snprintf(out + used, space - used, "...");
+            }
+            missing = 1;
+            continue;
+        }
+        if (argument != ARG_STRING) {
+            memcpy(&value, record->payload + offset, sizeof(value));
+            offset += sizeof(value);
+        }
+
+        int written = 0;
+        switch (argument) {
+            case ARG_INT:
+                written = snprintf(out + used, space - used, conversion, (int)value);
+                break;
+            case ARG_LONG:
+                written = snprintf(out + used, space - used, conversion, (long)value);
+                break;
+            case ARG_LONG_LONG:
+                written = snprintf(out + used, space - used, conversion, (long long)value);
+                break;
+            case ARG_SIZE:
+                written = snprintf(out + used, space - used, conversion, (size_t)value);
+                break;
+            case ARG_DOUBLE: {
+                double number;
+                memcpy(&number, &value, sizeof(number));
+                written = snprintf(out + used, space - used, conversion, number);
+                break;
+            }
+            case ARG_STRING: {
+                const char *string = (const char *)record->payload + offset;
+                offset += strlen(string) + 1;
+                written = snprintf(out + used, space - used, conversion, string);
+                missing = record->truncated && offset >= record->length;
+                break;
+            }
+            case ARG_POINTER:
+                written = snprintf(out + used, space - used, conversion, (void *)(uintptr_t)value);
+                break;
+            case ARG_NONE:
+                break;
+        }
+        if (written > 0) {
+            used += (size_t)written < space - used ? (size_t)written : space - used - 1;
+        }
+        if (missing) {
+            written = snprintf(out + used, space - used, "...");
+            used += (size_t)written < space - used ? (size_t)written : space - used - 1;
+        }
+    }
+
+    out[used++] = '\n';
+    return used;
+}
+
+static void write_all(const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+// Format a record into the batch, writing the batch out first if it is nearly full
+static void consume_record(const void *record, void *arg) {
+    struct log_batch *batch = arg;
+    if (LOG_BATCH_SIZE - batch->used < LOG_RECORD_SIZE * 4) {
+        write_all(batch->data, batch->used);
+        batch->used = 0;
+    }
+    batch->used += format_record(record, batch->data + batch->used, LOG_BATCH_SIZE - batch->used);
+}
+
+// Format every record waiting in every ring and write them out in as few write() calls as possible.
+// Returns the number of records written
+static int drain_rings(struct log_batch *batch) {
+    uint64_t dropped = 0;
+    int drained = ring_drain(&rings, consume_record, batch, &dropped);
+
+    if (dropped > 0) {
+        if (LOG_BATCH_SIZE - batch->used < LOG_RECORD_SIZE) {
+            write_all(batch->data, batch->used);
+            batch->used = 0;
+        }
+        batch->used += (size_t)snprintf(batch->data + batch->used, LOG_BATCH_SIZE - batch->used,
+                                        "%s %llu log records dropped, the log thread fell behind\n",
+                                        level_names[LOG_WARN], (unsigned long long)dropped);
+    }
+    if (batch->used > 0) {
+        write_all(batch->data, batch->used);
+        batch->used = 0;
+    }
+    return drained;
+}
+
+// Drain the rings until log_stop(), sleeping between passes while there is nothing to write
+static void *run_log_thread(void *arg) {
+    (void)arg;
+    struct log_batch batch = {.data = malloc(LOG_BATCH_SIZE), .used = 0};
+    if (batch.data == NULL) {
+        return NULL;
+    }
+
+    for (;;) {
+        int running = __atomic_load_n(&log_running, __ATOMIC_ACQUIRE);
+        int drained = drain_rings(&batch);
+        if (!running) {
+            break; // That was the final pass after log_stop()
+        }
+        if (drained == 0) {
+            struct timespec interval = {0, LOG_FLUSH_INTERVAL_MS * 1000000L};
+            nanosleep(&interval, NULL);
+        }
+    }
+
+    free(batch.data);
+    return NULL;
+}
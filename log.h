@@ -0,0 +1,44 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>     // Fixed width integer types (uint64_t)
+
+// Log levels, lowest first
+#define LOG_DEBUG 0
+#define LOG_INFO 1
+#define LOG_WARN 2
+#define LOG_ERROR 3
+
+// Calls below this level are compiled out entirely, e.g. -DLOG_COMPILE_LEVEL=LOG_INFO
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_DEBUG
+#endif
+
+#define LOG_RING_SLOTS 2048   // Records buffered per thread, a power of two
+#define LOG_RECORD_SIZE 256   // Bytes per record, including the header
+#define LOG_FLUSH_INTERVAL_MS 5 // How often the log thread drains the rings when they are quiet
+
+extern int log_level;         // Runtime level, calls below it return straight away
+
+// Log a printf style message. The format must be a string literal: only a pointer to it is stored, and
+// it is formatted later by the log thread. Arguments are copied into the record (strings included),
+// so the supported conversions are d i u x X o c s p f e g with the h, l, ll, z, j and t modifiers
+#define LOG_AT(level, ...) \
+    do { \
+        if ((level) >= LOG_COMPILE_LEVEL && (level) >= log_level) { \
+            log_write((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define log_debug(...) LOG_AT(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...) LOG_AT(LOG_INFO, __VA_ARGS__)
+#define log_warn(...) LOG_AT(LOG_WARN, __VA_ARGS__)
+#define log_error(...) LOG_AT(LOG_ERROR, __VA_ARGS__)
+
+// Function Declarations
+int log_start(int level);
+void log_stop(void);
+int log_parse_level(const char *name);
+void log_write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
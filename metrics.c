@@ -0,0 +1,312 @@
+#include <stdio.h>      // Standard input/output functions (snprintf, perror)
+#include <stdlib.h>     // Standard library functions (malloc, realloc, free)
+#include <stdarg.h>     // Variable arguments (va_list)
+#include <stddef.h>     // offsetof()
+#include <string.h>     // String manipulation functions (memset)
+#include <unistd.h>     // POSIX API functions (close, read, write)
+#include <time.h>       // Monotonic clock (clock_gettime) and accept backoff (nanosleep)
+#include <errno.h>      // Error codes (EINTR, ECONNABORTED)
+#include <pthread.h>    // Admin server thread
+#include <arpa/inet.h>  // Networking functions (htons, htonl)
+#include <sys/socket.h> // Socket programming functions
+#include <sys/time.h>   // Socket timeouts (struct timeval)
+#include "metrics.h"
+
+#define METRICS_ACCEPT_BACKOFF_MS 100 // Pause after accept() fails for lack of resources, such as EMFILE
+
+// Admin server state, read only once the thread has started
+struct metrics_server {
+    int server_fd;
+    struct metrics **sources;
+    int source_count;
+};
+
+// Text buffer for a scrape response, grown as needed
+struct text {
+    char *data;
+    int length;
+    int capacity;
+};
+
+static const char *phase_labels[METRICS_PHASES] = {"name_input", "ready_up", "queued", "playing", "leaderboard", "spectating"};
+
+// Function Declarations
+static void append(struct text *text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void *run_metrics_server(void *arg);
+
+uint64_t metrics_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int bucket_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (int)value;
+    }
+    if (value >= (uint64_t)1 << HISTOGRAM_MAX_BITS) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+
+    int top_bit = 63 - __builtin_clzll(value);
+    int shift = top_bit - HISTOGRAM_SUB_BITS;
+    return (top_bit - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + (int)((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+// Smallest value that falls in the bucket after index, the inclusive upper edge of bucket index
+static uint64_t bucket_limit(int index) {
+    index++;
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+    int group = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t sub = index % HISTOGRAM_SUB_BUCKETS;
+    return (HISTOGRAM_SUB_BUCKETS + sub) << group;
+}
+
+// Record value times times (a batch of guesses handled in one event shares one latency)
+void histogram_record(struct histogram *histogram, uint64_t value, uint64_t times) {
+    metrics_add(&histogram->counts[bucket_index(value)], times);
+    metrics_add(&histogram->sum, value * times);
+}
+
+static uint64_t read_counter(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+// Upper edge of the bucket holding the given fraction (0.99 for p99) of the recorded values, 0 when empty
+uint64_t histogram_percentile(const struct histogram *histogram, double fraction) {
+    uint64_t total = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        total += read_counter(&histogram->counts[bucket]);
+    }
+
+    uint64_t wanted = (uint64_t)(fraction * total);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS && total > 0; bucket++) {
+        seen += read_counter(&histogram->counts[bucket]);
+        if (seen > wanted) {
+            return bucket_limit(bucket);
+        }
+    }
+    return 0;
+}
+
+static void append(struct text *text, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+        va_end(args);
+
+        if (written < text->capacity - text->length) {
+            text->length += written;
+            return;
+        }
+
+        int capacity = text->capacity * 2 + written;
+        char *data = realloc(text->data, capacity);
+        if (data == NULL) {
+            return;
+        }
+        text->data = data;
+        text->capacity = capacity;
+    }
+}
+
+static void append_counter(struct text *text, struct metrics_server *server, const char *name,
+                           const char *help, size_t offset) {
+    uint64_t total = 0;
+    for (int i = 0; i < server->source_count; i++) {
+        total += read_counter((const uint64_t *)((const char *)server->sources[i] + offset));
+    }
+    append(text, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, (unsigned long long)total);
+}
+
+// Histogram summed over every worker, written as Prometheus buckets at each power of two (in seconds),
+// plus p50/p99/p999 gauges taken from the full log-linear resolution
+static void append_histogram(struct text *text, struct metrics_server *server, const char *name,
+                             const char *help, size_t offset) {
+    static struct histogram total;
+
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < server->source_count; i++) {
+        const struct histogram *histogram = (const struct histogram *)((const char *)server->sources[i] + offset);
+        for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+            total.counts[bucket] += read_counter(&histogram->counts[bucket]);
+        }
+        total.sum += read_counter(&histogram->sum);
+    }
+
+    append(text, "# HELP %s_seconds %s\n# TYPE %s_seconds histogram\n", name, help, name);
+    uint64_t cumulative = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        cumulative += total.counts[bucket];
+        uint64_t limit = bucket_limit(bucket);
+        if ((limit & (limit - 1)) == 0) {
+            append(text, "%s_seconds_bucket{le=\"%g\"} %llu\n", name, limit / 1e6, (unsigned long long)cumulative);
+        }
+    }
+    append(text, "%s_seconds_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+    append(text, "%s_seconds_sum %g\n%s_seconds_count %llu\n", name, total.sum / 1e6, name, (unsigned long long)cumulative);
+
+    static const double quantiles[] = {0.5, 0.99, 0.999};
+    static const char *quantile_names[] = {"p50", "p99", "p999"};
+    for (int q = 0; q < 3; q++) {
+        append(text, "# TYPE %s_%s_seconds gauge\n%s_%s_seconds %g\n", name, quantile_names[q], name, quantile_names[q],
+               histogram_percentile(&total, quantiles[q]) / 1e6);
+    }
+}
+
+static void format_metrics(struct text *text, struct metrics_server *server) {
+    append_counter(text, server, "hangman_connections_accepted_total", "Connections let into the lobby",
+                   offsetof(struct metrics, connections_accepted));
+    append_counter(text, server, "hangman_connections_rejected_total", "Connections turned away because the lobby was full",
+                   offsetof(struct metrics, connections_rejected));
+    append_counter(text, server, "hangman_connections_shed_total", "Connections turned away because they arrived faster than the admission rate",
+                   offsetof(struct metrics, connections_shed));
+    append_counter(text, server, "hangman_guesses_total", "Valid guesses handled",
+                   offsetof(struct metrics, guesses));
+    append_counter(text, server, "hangman_bytes_in_total", "Bytes read from clients",
+                   offsetof(struct metrics, bytes_in));
+    append_counter(text, server, "hangman_bytes_out_total", "Bytes written to clients",
+                   offsetof(struct metrics, bytes_out));
+    append_counter(text, server, "hangman_timeouts_total", "Players disconnected for missing a deadline",
+                   offsetof(struct metrics, timeouts));
+    append_counter(text, server, "hangman_slow_consumers_total", "Players disconnected for not reading their messages",
+                   offsetof(struct metrics, slow_consumers));
+    append_counter(text, server, "hangman_rooms_opened_total", "Rooms opened",
+                   offsetof(struct metrics, rooms_opened));
+    append_counter(text, server, "hangman_games_completed_total", "Games that reached the leaderboard",
+                   offsetof(struct metrics, games_completed));
+    append_counter(text, server, "hangman_players_resumed_total", "Players who took their slot back after a restart",
+                   offsetof(struct metrics, players_resumed));
+    append_counter(text, server, "hangman_spectators_total", "Spectators who started watching a game",
+                   offsetof(struct metrics, spectators));
+    append_counter(text, server, "hangman_bots_total", "Bots seated in games that started short of players",
+                   offsetof(struct metrics, bots));
+
+    append(text, "# HELP hangman_disconnects_total Players who left, by the phase they were in\n"
+                 "# TYPE hangman_disconnects_total counter\n");
+    for (int phase = 0; phase < METRICS_PHASES; phase++) {
+        uint64_t total = 0;
+        for (int i = 0; i < server->source_count; i++) {
+            total += read_counter(&server->sources[i]->disconnects[phase]);
+        }
+        append(text, "hangman_disconnects_total{phase=\"%s\"} %llu\n", phase_labels[phase], (unsigned long long)total);
+    }
+
+    append_histogram(text, server, "hangman_guess_latency", "Time from reading a guess to writing its response",
+                     offsetof(struct metrics, guess_latency));
+    append_histogram(text, server, "hangman_name_phase", "Time from a player connecting to sending their username",
+                     offsetof(struct metrics, name_phase));
+    append_histogram(text, server, "hangman_ready_phase", "Time from the ready prompt to the player being ready",
+                     offsetof(struct metrics, ready_phase));
+    append_histogram(text, server, "hangman_queue_wait", "Time from a player being ready to their game starting",
+                     offsetof(struct metrics, queue_wait));
+    append_histogram(text, server, "hangman_game_phase", "Time from the game starting to every player finishing",
+                     offsetof(struct metrics, game_phase));
+}
+
+// Serve the metrics of every source as Prometheus text on 127.0.0.1:port from a background thread.
+// Returns 0 once listening, -1 on failure
+int metrics_start_server(int port, struct metrics **sources, int source_count) {
+    struct metrics_server *server = malloc(sizeof(struct metrics_server));
+    if (server == NULL) {
+        return -1;
+    }
+    server->sources = sources;
+    server->source_count = source_count;
+
+    server->server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->server_fd < 0) {
+        free(server);
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(server->server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // Only reachable from the machine itself
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    if (bind(server->server_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(server->server_fd, 16) < 0) {
+        close(server->server_fd);
+        free(server);
+        return -1;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_metrics_server, server) != 0) {
+        close(server->server_fd);
+        free(server);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+// Answer every connection with the current metrics, whatever it asked for. Scrapes are rare and local,
+// so each one is served in turn with blocking I/O bounded by socket timeouts
+static void *run_metrics_server(void *arg) {
+    struct metrics_server *server = arg;
+    struct text text = {malloc(16384), 0, 16384};
+
+    for (;;) {
+        int client_fd = accept(server->server_fd, NULL, NULL);
+        if (client_fd < 0) {
+            // Out of descriptors or memory the pending connection stays queued, so retrying straight away
+            // would spin. Wait for the workers to close some sockets first
+            if (errno != EINTR && errno != ECONNABORTED) {
+                struct timespec backoff = {0, METRICS_ACCEPT_BACKOFF_MS * 1000000L};
+                nanosleep(&backoff, NULL);
+            }
+            continue;
+        }
+
+        struct timeval timeout = {1, 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // Read the request head, its content doesn't matter
+        char request[4096];
+        int request_length = 0;
+        while (request_length < (int)sizeof(request) - 1) {
+            ssize_t valread = read(client_fd, request + request_length, sizeof(request) - 1 - request_length);
+            if (valread <= 0) {
+                break;
+            }
+            request_length += valread;
+            request[request_length] = '\0';
+            if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+                break;
+            }
+        }
+
+        text.length = 0;
+        if (text.data != NULL) {
+            format_metrics(&text, server);
+        }
+
+        char header[256];
+        int header_length = snprintf(header, sizeof(header),
+                                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                     "Content-Length: %d\r\nConnection: close\r\n\r\n", text.length);
+        if (write(client_fd, header, header_length) == header_length) {
+            int sent = 0;
+            while (sent < text.length) {
+                ssize_t written = write(client_fd, text.data + sent, text.length - sent);
+                if (written <= 0) {
+                    break;
+                }
+                sent += written;
+            }
+        }
+        close(client_fd);
+    }
+    return NULL;
+}
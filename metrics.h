@@ -0,0 +1,57 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>     // Fixed width integer types (uint64_t)
+
+// Log-linear histogram: values below 8 get a bucket each, above that every power of two is split into
+// 8 sub-buckets, so any recorded value is known to within 12.5% over the whole range
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS 40  // Values are clamped below 2^40 (about 12 days in microseconds)
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t sum;
+};
+
+// Phases a player can disconnect in, matching enum game_phase
+#define METRICS_PHASES 6
+
+// Counters and latency histograms (in microseconds) of one worker thread. Only the owning worker
+// writes them, so updates are plain relaxed stores; the admin thread reads them while they change
+struct metrics {
+    uint64_t connections_accepted;
+    uint64_t connections_rejected;
+    uint64_t connections_shed;
+    uint64_t guesses;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t disconnects[METRICS_PHASES];
+    uint64_t timeouts;
+    uint64_t slow_consumers;
+    uint64_t rooms_opened;
+    uint64_t games_completed;
+    uint64_t players_resumed;
+    uint64_t spectators;
+    uint64_t bots;
+
+    struct histogram guess_latency;   // Guess read to response written
+    struct histogram name_phase;      // Connected to username in, per player
+    struct histogram ready_phase;     // Ready prompt to ready, per player
+    struct histogram queue_wait;      // Ready to their game starting, per player
+    struct histogram game_phase;      // Game start to every player finished
+};
+
+// Single writer increment, a relaxed load and store rather than a locked add
+static inline void metrics_add(uint64_t *counter, uint64_t amount) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
+
+// Function Declarations
+uint64_t metrics_now_us(void);
+void histogram_record(struct histogram *histogram, uint64_t value, uint64_t times);
+uint64_t histogram_percentile(const struct histogram *histogram, double fraction);
+int metrics_start_server(int port, struct metrics **sources, int source_count);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdlib.h>     // Standard library functions (malloc, calloc, free)
+#include <string.h>     // String manipulation functions (strlen, strcmp, memcpy)
+#include <stddef.h>     // offsetof
+#include <stdint.h>     // Fixed width integer types (uint32_t)
+#include <pthread.h>    // Names are shared by every worker
+#include "names.h"
+
+// Every username in use on the server, interned: each distinct name is stored once, and players
+// hold a pointer to that copy. A name is claimed by the connection that registered it until the
+// connection closes, which makes finding a duplicate one hash lookup however many players are
+// connected. Once the last claim is given up the entry is unlinked and kept on its shards free
+// list for the next name of the same size, so the table only holds the names in use. Anything
+// that outlives the claim (rankings, results, log lines) keeps its own copy of the name
+struct name_entry {
+    struct name_entry *next;    // Chain of the hash bucket
+    uint32_t hash;
+    int claims;                 // Connections and restored slots using the name right now
+    char text[];
+};
+
+// One part of the table with its own lock, buckets and arena. Shards sit on their own cache lines
+// so workers registering different names don't contend
+struct name_shard {
+    pthread_mutex_t lock;
+    struct name_entry **buckets;
+    unsigned int bucket_count;  // A power of two
+    unsigned int count;
+    char *arena;                // Current block, names are appended until it is full
+    size_t arena_used;
+    struct name_entry *free_entries[NAME_FREE_CLASSES]; // Unclaimed entries by size class, linked through next
+} __attribute__((aligned(64)));
+
+static struct name_shard shards[NAME_SHARDS] = {[0 ... NAME_SHARDS - 1] = {.lock = PTHREAD_MUTEX_INITIALIZER}};
+
+// FNV-1a, like the leaderboard. The low bits pick the bucket and the top bits the shard
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static struct name_shard *shard_of(uint32_t hash) {
+    return &shards[hash >> 26];
+}
+
+_Static_assert(NAME_SHARDS == 1 << 6, "shard_of() takes the top 6 bits of the hash");
+
+// Double the buckets once the shard averages more than one name per bucket. Returns 0, or -1 if memory ran out
+static int grow_buckets(struct name_shard *shard) {
+    unsigned int new_count = shard->bucket_count > 0 ? shard->bucket_count * 2 : 256;
+    struct name_entry **buckets = calloc(new_count, sizeof(struct name_entry *));
+    if (buckets == NULL) {
+        return -1;
+    }
+
+    for (unsigned int b = 0; b < shard->bucket_count; b++) {
+        struct name_entry *entry = shard->buckets[b];
+        while (entry != NULL) {
+            struct name_entry *next = entry->next;
+            unsigned int bucket = entry->hash & (new_count - 1);
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = new_count;
+    return 0;
+}
+
+// Carve size bytes out of the shards arena, starting a new block when it is full. The rest of a full
+// block is left unused rather than tracked. Returns NULL if memory ran out
+static void *arena_alloc(struct name_shard *shard, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (shard->arena == NULL || NAME_ARENA_BLOCK - shard->arena_used < size) {
+        char *block = malloc(size > NAME_ARENA_BLOCK ? size : NAME_ARENA_BLOCK);
+        if (block == NULL) {
+            return NULL;
+        }
+        shard->arena = block;
+        shard->arena_used = 0;
+    }
+    void *memory = shard->arena + shard->arena_used;
+    shard->arena_used += size;
+    return memory;
+}
+
+// Bytes taken by the entry for a name of length characters, a multiple of 8
+static size_t entry_size(size_t length) {
+    return (offsetof(struct name_entry, text) + length + 1 + 7) & ~(size_t)7;
+}
+
+// A free entry for a name of length characters: a freed one of the same size if there is one, otherwise
+// new space from the arena. Entries too big for any size class get their own allocation. Returns NULL if
+// memory ran out
+static struct name_entry *alloc_entry(struct name_shard *shard, size_t length) {
+    size_t size = entry_size(length);
+    size_t size_class = size / 8 - 1;
+    if (size_class >= NAME_FREE_CLASSES) {
+        return malloc(size);
+    }
+    struct name_entry *entry = shard->free_entries[size_class];
+    if (entry != NULL) {
+        shard->free_entries[size_class] = entry->next;
+        return entry;
+    }
+    return arena_alloc(shard, size);
+}
+
+// Unlink an entry nobody claims any more from its bucket and keep it for reuse
+static void free_entry(struct name_shard *shard, struct name_entry *entry) {
+    struct name_entry **link = &shard->buckets[entry->hash & (shard->bucket_count - 1)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    shard->count--;
+
+    size_t size_class = entry_size(strlen(entry->text)) / 8 - 1;
+    if (size_class >= NAME_FREE_CLASSES) {
+        free(entry);
+        return;
+    }
+    entry->next = shard->free_entries[size_class];
+    shard->free_entries[size_class] = entry;
+}
+
+// Claim name for a player, setting interned to the shared copy, which stays valid until the claim is
+// given up with names_release(). Returns NAME_TAKEN if someone already holds the name and allow_duplicate
+// isn't set, or NAME_NO_MEMORY if memory ran out
+enum name_claim names_claim(const char *name, int allow_duplicate, const char **interned) {
+    uint32_t hash = hash_name(name);
+    struct name_shard *shard = shard_of(hash);
+    enum name_claim result = NAME_TAKEN;
+
+    pthread_mutex_lock(&shard->lock);
+    struct name_entry *entry = NULL;
+    if (shard->bucket_count > 0) {
+        for (entry = shard->buckets[hash & (shard->bucket_count - 1)]; entry != NULL; entry = entry->next) {
+            if (entry->hash == hash && strcmp(entry->text, name) == 0) {
+                break;
+            }
+        }
+    }
+
+    if (entry == NULL) {
+        size_t length = strlen(name);
+        if ((shard->count >= shard->bucket_count && grow_buckets(shard) < 0) ||
+            (entry = alloc_entry(shard, length)) == NULL) {
+            pthread_mutex_unlock(&shard->lock);
+            return NAME_NO_MEMORY;
+        }
+        memcpy(entry->text, name, length + 1);
+        entry->hash = hash;
+        entry->claims = 0;
+        unsigned int bucket = hash & (shard->bucket_count - 1);
+        entry->next = shard->buckets[bucket];
+        shard->buckets[bucket] = entry;
+        shard->count++;
+    }
+
+    if (entry->claims == 0 || allow_duplicate) {
+        entry->claims++;
+        *interned = entry->text;
+        result = NAME_CLAIMED;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return result;
+}
+
+// Give up a claim taken with names_claim(). name must be the interned copy it returned, and isn't valid afterwards
+void names_release(const char *name) {
+    struct name_entry *entry = (struct name_entry *)(name - offsetof(struct name_entry, text));
+    struct name_shard *shard = shard_of(entry->hash);
+
+    pthread_mutex_lock(&shard->lock);
+    if (--entry->claims == 0) {
+        free_entry(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
@@ -0,0 +1,19 @@
+#ifndef NAMES_H
+#define NAMES_H
+
+#define NAME_SHARDS 64          // Independently locked parts of the table, picked by the top bits of a names hash
+#define NAME_ARENA_BLOCK (64 * 1024) // Names are carved out of blocks of this size
+#define NAME_FREE_CLASSES 16    // Freed entries are kept for reuse by size, in 8 byte steps up to 128 bytes
+
+// What names_claim() did with a name
+enum name_claim {
+    NAME_CLAIMED,
+    NAME_TAKEN,                 // Someone already holds it and duplicates weren't allowed
+    NAME_NO_MEMORY
+};
+
+// Function Declarations
+enum name_claim names_claim(const char *name, int allow_duplicate, const char **interned);
+void names_release(const char *name);
+
+#endif
@@ -0,0 +1,435 @@
+#include <string.h>     // String manipulation functions (memcpy, strlen)
+#include <arpa/inet.h>  // Byte order conversion (htons, ntohs)
+#include <sys/socket.h> // Socket programming functions (send)
+#include "connection.h"
+#include "protocol.h"
+#include "spectator.h"  // Shared event frames for spectators
+
+// Legacy text messages, kept byte for byte so old clients keep working
+static const char legacy_ready_message[] = "All players have entered their usernames. Ready up by entering 'r'\n";
+static const char legacy_game_over_message[] = "All Players have finished! Generating leaderboard...\n";
+static const char legacy_name_taken_message[] = "That username is taken. Enter another one\n";
+
+// Settle the protocol version from the first bytes of the connection.
+// Returns 1 once the version is known, 0 if more bytes are needed and -1 on a bad hello
+static int negotiate(struct connection *connection) {
+    unsigned char hello[PROTOCOL_HELLO_SIZE];
+
+    if (connection->protocol != PROTOCOL_UNKNOWN) {
+        return 1;
+    }
+
+    if (!input_buffer_peek(&connection->input, hello, 1)) {
+        return 0;
+    }
+
+    if (hello[0] != '\0') {
+        connection->protocol = PROTOCOL_LEGACY;
+        return 1;
+    }
+
+    if (!input_buffer_peek(&connection->input, hello, PROTOCOL_HELLO_SIZE)) {
+        return 0;
+    }
+
+    if (hello[1] != 'H' || hello[2] != 'M' || hello[3] < PROTOCOL_V2) {
+        return -1;
+    }
+
+    input_buffer_skip(&connection->input, PROTOCOL_HELLO_SIZE);
+    connection->protocol = PROTOCOL_V2;
+
+    // Both sides speak v2 from here on
+    unsigned char version = PROTOCOL_V2;
+    unsigned char welcome[PROTOCOL_HEADER_SIZE + 1] = {0, 2, MSG_WELCOME, version};
+    connection_send(connection, welcome, sizeof(welcome));
+    return 1;
+}
+
+// Frame the next v2 message. A requeue request is remembered on the connection whichever phase it
+// arrives in. Returns the payload length, -2 if the whole frame hasn't arrived and -1 if the frame is malformed
+static int next_frame(struct connection *connection, unsigned char *type, unsigned char *payload) {
+    unsigned char header[PROTOCOL_HEADER_SIZE];
+
+    if (!input_buffer_peek(&connection->input, header, PROTOCOL_HEADER_SIZE)) {
+        return -2;
+    }
+
+    int length = (header[0] << 8) | header[1];
+    if (length < 1 || length - 1 > PROTOCOL_MAX_PAYLOAD) {
+        return -1;
+    }
+
+    if (input_buffer_used(&connection->input) < (unsigned int)(2 + length)) {
+        return -2;
+    }
+
+    input_buffer_skip(&connection->input, PROTOCOL_HEADER_SIZE);
+    input_buffer_next_bytes(&connection->input, payload, length - 1);
+    *type = header[2];
+    if (*type == MSG_REQUEUE) {
+        connection->requeue = 1;
+    }
+    return length - 1;
+}
+
+// Skip v2 frames until one of the wanted type arrives.
+// Returns the payload length, -2 if none has arrived and -1 on a malformed frame
+static int next_frame_of_type(struct connection *connection, unsigned char wanted, unsigned char *payload) {
+    unsigned char type;
+    int length;
+
+    while ((length = next_frame(connection, &type, payload)) >= 0) {
+        if (type == wanted) {
+            return length;
+        }
+    }
+    return length;
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+static uint64_t get_u64(const unsigned char *in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// Frame a username, or what a v2 client sent instead of one. Returns 1 when a username arrived, 2 when a
+// resume token arrived in *request, 3 when a request to watch room *request arrived, 0 if more bytes are
+// needed and -1 on a protocol error
+int protocol_next_name(struct connection *connection, char *name, int name_size, uint64_t *request) {
+    int negotiated = negotiate(connection);
+    if (negotiated <= 0) {
+        return negotiated;
+    }
+
+    if (connection->protocol == PROTOCOL_LEGACY) {
+        return input_buffer_next_line(&connection->input, name, name_size) >= 0;
+    }
+
+    unsigned char payload[PROTOCOL_MAX_PAYLOAD];
+    unsigned char type;
+    int length;
+    while ((length = next_frame(connection, &type, payload)) >= 0) {
+        if (type == MSG_NAME) {
+            break;
+        }
+        if (type == MSG_RESUME && length == 8) {
+            *request = get_u64(payload);
+            return 2;
+        }
+        if (type == MSG_SPECTATE && length == 4) {
+            *request = get_u32(payload);
+            return 3;
+        }
+    }
+    if (length < 0) {
+        return length == -2 ? 0 : -1;
+    }
+    if (length > name_size - 1) {
+        length = name_size - 1;
+    }
+    memcpy(name, payload, length);
+    name[length] = '\0';
+    return 1;
+}
+
+// Frame a ready up message, skipping anything else. Returns 1, 0 or -1 like protocol_next_name()
+int protocol_next_ready(struct connection *connection) {
+    if (connection->protocol == PROTOCOL_LEGACY) {
+        char line[10];
+        while (input_buffer_next_line(&connection->input, line, sizeof(line)) >= 0) {
+            if (line[0] == 'r') {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    unsigned char payload[PROTOCOL_MAX_PAYLOAD];
+    int length = next_frame_of_type(connection, MSG_READY, payload);
+    return length >= 0 ? 1 : (length == -2 ? 0 : -1);
+}
+
+// Frame a single guess. Legacy clients send one byte per guess with stray newlines in between.
+// Returns 1, 0 or -1 like protocol_next_name()
+int protocol_next_guess(struct connection *connection, char *guess) {
+    if (connection->protocol == PROTOCOL_LEGACY) {
+        while (input_buffer_next_byte(&connection->input, guess)) {
+            if (*guess != '\n' && *guess != '\r') {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    unsigned char payload[PROTOCOL_MAX_PAYLOAD];
+    int length;
+    while ((length = next_frame_of_type(connection, MSG_GUESS, payload)) >= 0) {
+        if (length >= 1) {
+            *guess = (char)payload[0];
+            return 1;
+        }
+    }
+    return length == -2 ? 0 : -1;
+}
+
+// Drop everything buffered from a player who has nothing left to send for now, such as the score
+// legacy clients send after the game. Requeue requests in it still count. Returns 0, or -1 on a malformed frame
+int protocol_discard_input(struct connection *connection) {
+    if (connection->protocol != PROTOCOL_V2) {
+        input_buffer_skip(&connection->input, input_buffer_used(&connection->input));
+        return 0;
+    }
+
+    unsigned char payload[PROTOCOL_MAX_PAYLOAD];
+    return next_frame_of_type(connection, 0, payload) == -1 ? -1 : 0;
+}
+
+// Queue one v2 frame, the header and payload are packed into the same output chunk
+static void send_frame(struct connection *connection, unsigned char type, const void *payload, int length) {
+    unsigned char header[PROTOCOL_HEADER_SIZE];
+    header[0] = (unsigned char)((length + 1) >> 8);
+    header[1] = (unsigned char)((length + 1) & 0xff);
+    header[2] = type;
+
+    connection_send(connection, header, sizeof(header));
+    connection_send(connection, payload, length);
+}
+
+// Join status is sent before the client has said which version it speaks, so it is always a legacy int:
+// 0 when the player has joined a room, -1 when the server is full.
+// It is the first write on a fresh socket, so it always fits and is sent straight away
+void protocol_send_join_status(int sd, int status) {
+    send(sd, &status, sizeof(status), MSG_DONTWAIT);
+}
+
+void protocol_send_ready_prompt(struct connection *connection) {
+    if (connection->protocol == PROTOCOL_V2) {
+        send_frame(connection, MSG_READY_PROMPT, NULL, 0);
+    } else {
+        connection_send(connection, legacy_ready_message, strlen(legacy_ready_message));
+    }
+}
+
+void protocol_send_game_start(struct connection *connection, int word_length, int max_guesses) {
+    if (connection->protocol == PROTOCOL_V2) {
+        unsigned char payload[2] = {(unsigned char)word_length, (unsigned char)max_guesses};
+        send_frame(connection, MSG_GAME_START, payload, sizeof(payload));
+    } else {
+        connection_send(connection, &word_length, sizeof(word_length));
+    }
+}
+
+// Send the result of a guess. v2 packs the revealed positions eight to a byte, so a ten letter word
+// costs two bytes instead of forty, and carries the guesses left in the same frame
+void protocol_send_reveal(struct connection *connection, uint64_t revealed, int word_length, char guess, int guesses_left) {
+    if (connection->protocol == PROTOCOL_V2) {
+        unsigned char payload[3 + 8];
+        int mask_bytes = (word_length + 7) / 8;
+
+        payload[0] = (unsigned char)guess;
+        payload[1] = revealed != 0;
+        payload[2] = (unsigned char)guesses_left;
+        for (int i = 0; i < mask_bytes; i++) {
+            payload[3 + i] = (unsigned char)(revealed >> (8 * i));
+        }
+        send_frame(connection, MSG_REVEAL, payload, 3 + mask_bytes);
+    } else {
+        int boolean_arr[word_length]; // Temp array to send back to client with guess results
+        for (int j = 0; j < word_length; j++) {
+            boolean_arr[j] = (revealed >> j) & 1;
+        }
+        connection_send(connection, boolean_arr, word_length * sizeof(int));
+    }
+}
+
+void protocol_send_game_over(struct connection *connection) {
+    if (connection->protocol == PROTOCOL_V2) {
+        send_frame(connection, MSG_GAME_OVER, NULL, 0);
+    } else {
+        connection_send(connection, legacy_game_over_message, strlen(legacy_game_over_message));
+    }
+}
+
+// Legacy clients read the leaderboard as a NUL terminated string. v2 clients get it in as many frames
+// as it takes: MSG_LEADERBOARD_PART frames followed by a final MSG_LEADERBOARD
+void protocol_send_leaderboard(struct connection *connection, const char *leaderboard, int length) {
+    if (connection->protocol == PROTOCOL_V2) {
+        while (length > PROTOCOL_MAX_FRAME_PAYLOAD) {
+            send_frame(connection, MSG_LEADERBOARD_PART, leaderboard, PROTOCOL_MAX_FRAME_PAYLOAD);
+            leaderboard += PROTOCOL_MAX_FRAME_PAYLOAD;
+            length -= PROTOCOL_MAX_FRAME_PAYLOAD;
+        }
+        send_frame(connection, MSG_LEADERBOARD, leaderboard, length);
+    } else {
+        connection_send(connection, leaderboard, length + 1);
+    }
+}
+
+static void put_u32(unsigned char *out, uint32_t value) {
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+// Final score of a player who has just finished. Legacy clients work theirs out themselves
+void protocol_send_result(struct connection *connection, int score, int solved) {
+    if (connection->protocol != PROTOCOL_V2) {
+        return;
+    }
+
+    unsigned char payload[3] = {(unsigned char)(score >> 8), (unsigned char)(score & 0xff), (unsigned char)(solved != 0)};
+    send_frame(connection, MSG_RESULT, payload, sizeof(payload));
+}
+
+// Standing across every game played. Legacy clients have no message for it
+void protocol_send_ranking(struct connection *connection, int rank, int total_score, int games, int ranked_players) {
+    if (connection->protocol != PROTOCOL_V2) {
+        return;
+    }
+
+    unsigned char payload[16];
+    put_u32(payload, (uint32_t)rank);
+    put_u32(payload + 4, (uint32_t)total_score);
+    put_u32(payload + 8, (uint32_t)games);
+    put_u32(payload + 12, (uint32_t)ranked_players);
+    send_frame(connection, MSG_RANKING, payload, sizeof(payload));
+}
+
+static void put_u64(unsigned char *out, uint64_t value) {
+    put_u32(out, (uint32_t)(value >> 32));
+    put_u32(out + 4, (uint32_t)value);
+}
+
+// Token a v2 client can take its slot back with if the server restarts mid-game. Legacy clients can't resume
+void protocol_send_resume_token(struct connection *connection, uint64_t token) {
+    if (connection->protocol != PROTOCOL_V2) {
+        return;
+    }
+
+    unsigned char payload[8];
+    put_u64(payload, token);
+    send_frame(connection, MSG_RESUME_TOKEN, payload, sizeof(payload));
+}
+
+// Everything a resumed client needs to redraw its game, with the mask packed like MSG_REVEAL
+void protocol_send_resumed(struct connection *connection, int word_length, int guesses_left, int finished, uint64_t progress) {
+    unsigned char payload[3 + 8];
+    int mask_bytes = (word_length + 7) / 8;
+
+    payload[0] = (unsigned char)word_length;
+    payload[1] = (unsigned char)guesses_left;
+    payload[2] = (unsigned char)(finished != 0);
+    for (int i = 0; i < mask_bytes; i++) {
+        payload[3 + i] = (unsigned char)(progress >> (8 * i));
+    }
+    send_frame(connection, MSG_RESUMED, payload, 3 + mask_bytes);
+}
+
+void protocol_send_resume_failed(struct connection *connection) {
+    send_frame(connection, MSG_RESUME_FAILED, NULL, 0);
+}
+
+void protocol_send_name_taken(struct connection *connection) {
+    if (connection->protocol == PROTOCOL_V2) {
+        send_frame(connection, MSG_NAME_TAKEN, NULL, 0);
+    } else {
+        connection_send(connection, legacy_name_taken_message, strlen(legacy_name_taken_message));
+    }
+}
+
+// The game a new spectator is about to follow, as it stands: the room, then every player in it
+void protocol_send_spectating(struct connection *connection, const struct room *room, int max_guesses) {
+    int word_length = room->game_word.length;
+    int mask_bytes = (word_length + 7) / 8;
+    unsigned char payload[3 + 8 + PLAYER_NAME_SIZE];
+
+    put_u32(payload, (uint32_t)room->id);
+    payload[4] = (unsigned char)word_length;
+    payload[5] = (unsigned char)max_guesses;
+    payload[6] = (unsigned char)room->player_count;
+    send_frame(connection, MSG_SPECTATING, payload, 7);
+
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->connections[i] == NULL && !room->detached[i] && room->bots[i] == NULL) {
+            continue;
+        }
+
+        int name_length = strlen(room->player_names[i]);
+        payload[0] = (unsigned char)i;
+        payload[1] = (unsigned char)room->guesses_left[i];
+        payload[2] = (unsigned char)(room->game_finished[i] != 0);
+        for (int j = 0; j < mask_bytes; j++) {
+            payload[3 + j] = (unsigned char)(room->progress[i] >> (8 * j));
+        }
+        memcpy(payload + 3 + mask_bytes, room->player_names[i], name_length);
+        send_frame(connection, MSG_PLAYER_STATE, payload, 3 + mask_bytes + name_length);
+    }
+}
+
+void protocol_send_spectate_failed(struct connection *connection) {
+    send_frame(connection, MSG_SPECTATE_FAILED, NULL, 0);
+}
+
+// Encode a frame into the events of room, once for every spectator. Nothing is encoded while nobody is watching
+static void publish_frame(struct room *room, unsigned char type, const void *payload, int length) {
+    unsigned char *frame = spectator_event_space(room, PROTOCOL_HEADER_SIZE + length);
+    if (frame == NULL) {
+        return;
+    }
+
+    frame[0] = (unsigned char)((length + 1) >> 8);
+    frame[1] = (unsigned char)((length + 1) & 0xff);
+    frame[2] = type;
+    memcpy(frame + PROTOCOL_HEADER_SIZE, payload, length);
+}
+
+void protocol_publish_guess(struct room *room, int slot, uint64_t revealed, char guess, int guesses_left) {
+    if (room->spectators == NULL) {
+        return;
+    }
+
+    unsigned char payload[4 + 8];
+    int mask_bytes = (room->game_word.length + 7) / 8;
+
+    payload[0] = (unsigned char)slot;
+    payload[1] = (unsigned char)guess;
+    payload[2] = revealed != 0;
+    payload[3] = (unsigned char)guesses_left;
+    for (int i = 0; i < mask_bytes; i++) {
+        payload[4 + i] = (unsigned char)(revealed >> (8 * i));
+    }
+    publish_frame(room, MSG_PLAYER_GUESS, payload, 4 + mask_bytes);
+}
+
+void protocol_publish_finished(struct room *room, int slot, int score, int solved) {
+    unsigned char payload[4] = {(unsigned char)slot, (unsigned char)(score >> 8), (unsigned char)(score & 0xff),
+                                (unsigned char)(solved != 0)};
+    publish_frame(room, MSG_PLAYER_FINISHED, payload, sizeof(payload));
+}
+
+void protocol_publish_left(struct room *room, int slot) {
+    unsigned char payload[1] = {(unsigned char)slot};
+    publish_frame(room, MSG_PLAYER_LEFT, payload, sizeof(payload));
+}
+
+void protocol_publish_game_over(struct room *room) {
+    publish_frame(room, MSG_GAME_OVER, NULL, 0);
+}
+
+// Spectators get the leaderboard in the same frames as v2 players
+void protocol_publish_leaderboard(struct room *room, const char *leaderboard, int length) {
+    while (length > PROTOCOL_MAX_FRAME_PAYLOAD) {
+        publish_frame(room, MSG_LEADERBOARD_PART, leaderboard, PROTOCOL_MAX_FRAME_PAYLOAD);
+        leaderboard += PROTOCOL_MAX_FRAME_PAYLOAD;
+        length -= PROTOCOL_MAX_FRAME_PAYLOAD;
+    }
+    publish_frame(room, MSG_LEADERBOARD, leaderboard, length);
+}
@@ -0,0 +1,93 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>     // Fixed width integer types (uint8_t, uint64_t)
+
+struct connection;
+struct room;
+
+// Wire protocol versions. Every connection starts out as PROTOCOL_UNKNOWN and is settled by the
+// first bytes the client sends: a v2 client opens with the hello below, anything else is legacy
+#define PROTOCOL_UNKNOWN 0
+#define PROTOCOL_LEGACY 1  // Raw host order ints, 0/1 int reveal arrays and newline/byte framed input
+#define PROTOCOL_V2 2      // Length prefixed typed frames in network byte order
+
+// v2 hello: "\0HM" followed by the highest version the client speaks. The leading NUL can't start a
+// legacy username, so legacy clients are never mistaken for v2 ones
+#define PROTOCOL_HELLO_SIZE 4
+
+// v2 frame: [u16 length][u8 type][payload], where length counts the type byte and the payload
+#define PROTOCOL_HEADER_SIZE 3
+#define PROTOCOL_MAX_PAYLOAD 256 // Largest client frame accepted, must fit in the input buffer
+#define PROTOCOL_MAX_FRAME_PAYLOAD 65534 // Largest payload a u16 frame length can carry
+#define PROTOCOL_MAX_PLAYERS 255 // Spectator frames carry player counts and slots in a single byte
+
+// v2 frame types
+enum message_type {
+    // Server to client
+    MSG_WELCOME = 0x01,       // u8 version
+    MSG_READY_PROMPT = 0x02,  // Username received, ready up to join the queue for a game
+    MSG_GAME_START = 0x03,    // u8 word length, u8 guesses allowed
+    MSG_REVEAL = 0x04,        // u8 guess, u8 correct, u8 guesses left, bit-packed reveal mask (bit j = position j)
+    MSG_GAME_OVER = 0x05,     // Every player has finished
+    MSG_LEADERBOARD = 0x06,   // "name:score," entries ranked highest first, the last part of the leaderboard
+    MSG_LEADERBOARD_PART = 0x07, // Leading part of a leaderboard too long for one frame, the parts join up
+    MSG_RANKING = 0x08,       // u32 rank, u32 total score, u32 games, u32 ranked players, across every game played
+    MSG_RESULT = 0x09,        // u16 final score, u8 solved. Sent as soon as the player finishes
+    MSG_RESUME_TOKEN = 0x0A,  // u64 token, sent after MSG_GAME_START. Resumes the game after a server restart
+    MSG_RESUMED = 0x0B,       // u8 word length, u8 guesses left, u8 finished, bit-packed mask of the positions revealed so far
+    MSG_RESUME_FAILED = 0x0C, // The token doesn't match a restored game, send MSG_NAME to start over
+    MSG_SPECTATING = 0x0D,    // u32 room id, u8 word length, u8 guesses allowed, u8 player slots. Followed by a
+                              // MSG_PLAYER_STATE per player, then the rooms events until MSG_LEADERBOARD
+    MSG_PLAYER_STATE = 0x0E,  // u8 slot, u8 guesses left, u8 finished, bit-packed mask of the positions revealed, name bytes
+    MSG_SPECTATE_FAILED = 0x0F, // No such game in progress, send MSG_NAME to play instead
+
+    // Client to server
+    MSG_NAME = 0x10,          // Username bytes
+    MSG_READY = 0x11,
+    MSG_GUESS = 0x12,         // u8 letter
+    MSG_SCORE = 0x13,         // Obsolete: scores are worked out by the server, anything sent is discarded
+    MSG_REQUEUE = 0x14,       // Go back into the queue once finished, instead of waiting for the rest of the room.
+                              // The ranking follows straight away, then the ready prompt is skipped and MSG_GAME_START
+                              // arrives when the next game starts. May be sent at any point during a game
+    MSG_RESUME = 0x15,        // u64 token, sent instead of MSG_NAME to take back a slot in a game restored from a snapshot.
+                              // Nothing else may be sent until MSG_RESUMED or MSG_RESUME_FAILED arrives
+    MSG_SPECTATE = 0x16,      // u32 room id, sent instead of MSG_NAME to watch a game. 0 watches any game in progress
+                              // on the worker that took the connection. Anything sent afterwards is ignored
+
+    // Server to spectators, encoded once per room and shared by all of its spectators.
+    // MSG_GAME_OVER and the leaderboard frames end the stream
+    MSG_PLAYER_GUESS = 0x20,  // u8 slot, then the payload of the MSG_REVEAL the player was sent
+    MSG_PLAYER_FINISHED = 0x21, // u8 slot, then the payload of the MSG_RESULT the player was sent
+    MSG_PLAYER_LEFT = 0x22,   // u8 slot
+
+    // Server to client, continued
+    MSG_NAME_TAKEN = 0x30     // Another player is using the username, or it's kept for bots. Send MSG_NAME again with a different one
+};
+
+// Function Declarations
+int protocol_next_name(struct connection *connection, char *name, int name_size, uint64_t *request);
+int protocol_next_ready(struct connection *connection);
+int protocol_next_guess(struct connection *connection, char *guess);
+int protocol_discard_input(struct connection *connection);
+void protocol_send_join_status(int sd, int status);
+void protocol_send_ready_prompt(struct connection *connection);
+void protocol_send_game_start(struct connection *connection, int word_length, int max_guesses);
+void protocol_send_reveal(struct connection *connection, uint64_t revealed, int word_length, char guess, int guesses_left);
+void protocol_send_game_over(struct connection *connection);
+void protocol_send_leaderboard(struct connection *connection, const char *leaderboard, int length);
+void protocol_send_result(struct connection *connection, int score, int solved);
+void protocol_send_ranking(struct connection *connection, int rank, int total_score, int games, int ranked_players);
+void protocol_send_resume_token(struct connection *connection, uint64_t token);
+void protocol_send_resumed(struct connection *connection, int word_length, int guesses_left, int finished, uint64_t progress);
+void protocol_send_resume_failed(struct connection *connection);
+void protocol_send_name_taken(struct connection *connection);
+void protocol_send_spectating(struct connection *connection, const struct room *room, int max_guesses);
+void protocol_send_spectate_failed(struct connection *connection);
+void protocol_publish_guess(struct room *room, int slot, uint64_t revealed, char guess, int guesses_left);
+void protocol_publish_finished(struct room *room, int slot, int score, int solved);
+void protocol_publish_left(struct room *room, int slot);
+void protocol_publish_game_over(struct room *room);
+void protocol_publish_leaderboard(struct room *room, const char *leaderboard, int length);
+
+#endif
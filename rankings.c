@@ -0,0 +1,242 @@
+#include <stdio.h>      // Standard input/output functions (fopen, fgets, fprintf)
+#include <stdlib.h>     // Standard library functions (strtol, free)
+#include <string.h>     // String manipulation functions (strrchr, strcspn, strnlen, memcpy)
+#include <errno.h>      // Error codes (errno)
+#include <time.h>       // Writer sleeps (nanosleep)
+#include <pthread.h>    // Rankings are shared by every worker, and written out by their own thread
+#include "rankings.h"
+#include "ring.h"       // Per thread record rings
+#include "log.h"        // Load summary and write failures
+
+// A finished game's score, on its way from a worker to the writer thread
+struct rankings_line {
+    char name[LEADERBOARD_NAME_SIZE];
+    int score;
+};
+
+// Running totals of every player across games and rooms, shared by all workers.
+// Totals are kept in a journal of "name<TAB>score<TAB>games" lines: each finished game appends one line
+// per player, and the journal is summed up and rewritten with one line per player on startup and
+// whenever it has grown to twice that size. Workers only update the totals in memory. The lines go
+// through per thread rings to a writer thread, which does all the file I/O
+static struct leaderboard rankings;
+static pthread_mutex_t rankings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Only the writer thread touches these once it is running
+static struct leaderboard written;  // Totals as the journal has them, what a compaction writes out
+static FILE *journal = NULL;
+static char journal_path[4096];
+static int appended_lines = 0;      // Lines appended since the last compaction
+
+static struct ring_set rings = RING_SET_INITIALIZER(sizeof(struct rankings_line), RANKINGS_RING_SLOTS);
+static __thread struct ring *thread_ring = NULL;
+static pthread_t writer_thread;
+static int writer_running = 0;
+
+// Function Declarations
+static void *run_writer_thread(void *arg);
+
+// Names are written on one journal line, so tabs and line breaks are swapped for spaces
+static void write_entry(FILE *file, const char *name, int score, int games) {
+    char clean_name[LEADERBOARD_NAME_SIZE];
+    int i = 0;
+    for (; name[i] != '\0' && i < LEADERBOARD_NAME_SIZE - 1; i++) {
+        clean_name[i] = (name[i] == '\t' || name[i] == '\n' || name[i] == '\r') ? ' ' : name[i];
+    }
+    clean_name[i] = '\0';
+    fprintf(file, "%s\t%d\t%d\n", clean_name, score, games);
+}
+
+// Rewrite the journal with one line per player from totals, then swap it in. Returns 0 on success, -1 on failure
+static int compact_journal(struct leaderboard *totals) {
+    char compact_path[sizeof(journal_path) + 4];
+    snprintf(compact_path, sizeof(compact_path), "%s.tmp", journal_path);
+    FILE *compact = fopen(compact_path, "w");
+    if (compact == NULL) {
+        return -1;
+    }
+    for (struct leaderboard_entry *entry = leaderboard_first(totals); entry != NULL; entry = leaderboard_next(entry)) {
+        write_entry(compact, entry->name, entry->score, entry->games);
+    }
+    if (fclose(compact) != 0 || rename(compact_path, journal_path) < 0) {
+        return -1;
+    }
+    appended_lines = 0;
+    return 0;
+}
+
+// Read the journal at path into the rankings, compact it and keep it open for appending.
+// A missing journal starts empty rankings. Returns 0 on success, -1 on failure
+int rankings_load(const char *path) {
+    if (leaderboard_init(&rankings) < 0) {
+        log_error("Memory allocation failed: %s", strerror(errno));
+        return -1;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file != NULL) {
+        char line[LEADERBOARD_NAME_SIZE + 32];
+        while (fgets(line, sizeof(line), file) != NULL) {
+            line[strcspn(line, "\n")] = '\0';
+
+            // The name is everything before the last two tabs
+            char *games_field = strrchr(line, '\t');
+            if (games_field == NULL) {
+                continue;
+            }
+            *games_field++ = '\0';
+            char *score_field = strrchr(line, '\t');
+            if (score_field == NULL) {
+                continue;
+            }
+            *score_field++ = '\0';
+
+            leaderboard_add_score(&rankings, line, (int)strtol(score_field, NULL, 10), (int)strtol(games_field, NULL, 10));
+        }
+        fclose(file);
+    }
+
+    // The writer keeps its own copy of the totals to compact from, so it never holds up the workers
+    if (leaderboard_init(&written) < 0) {
+        log_error("Memory allocation failed: %s", strerror(errno));
+        return -1;
+    }
+    for (struct leaderboard_entry *entry = leaderboard_first(&rankings); entry != NULL; entry = leaderboard_next(entry)) {
+        if (leaderboard_add_score(&written, entry->name, entry->score, entry->games) == NULL) {
+            log_error("Memory allocation failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    snprintf(journal_path, sizeof(journal_path), "%s", path);
+    if (compact_journal(&written) < 0) {
+        log_error("Rankings write failed: %s", strerror(errno));
+        return -1;
+    }
+
+    journal = fopen(path, "a");
+    if (journal == NULL) {
+        log_error("Rankings open failed: %s", strerror(errno));
+        return -1;
+    }
+
+    __atomic_store_n(&writer_running, 1, __ATOMIC_RELEASE);
+    int error = pthread_create(&writer_thread, NULL, run_writer_thread, NULL);
+    if (error != 0) {
+        log_error("Thread creation failed: %s", strerror(error));
+        writer_running = 0;
+        return -1;
+    }
+
+    log_info("Rankings: loaded %d players from %s", rankings.length, path);
+    return 0;
+}
+
+// Add the score a player earned in a finished game to their total, and report their new standing
+void rankings_record(const char *name, int score, struct ranking *ranking) {
+    pthread_mutex_lock(&rankings_lock);
+
+    struct leaderboard_entry *entry = leaderboard_add_score(&rankings, name, score, 1);
+    if (entry != NULL) {
+        ranking->rank = leaderboard_rank(&rankings, entry);
+        ranking->total_score = entry->score;
+        ranking->games = entry->games;
+    } else {
+        memset(ranking, 0, sizeof(*ranking));
+    }
+    ranking->ranked_players = rankings.length;
+
+    pthread_mutex_unlock(&rankings_lock);
+
+    // Never blocks: if the writer is a full ring behind, the line is dropped and reported by the writer
+    struct rankings_line *line = ring_claim(&rings, &thread_ring);
+    if (line != NULL) {
+        size_t length = strnlen(name, LEADERBOARD_NAME_SIZE - 1);
+        memcpy(line->name, name, length);
+        line->name[length] = '\0';
+        line->score = score;
+        ring_commit(thread_ring);
+    }
+}
+
+// Format the count best totals like leaderboard_format(). Returns the text length, or -1
+int rankings_format_top(int count, char **text, int *text_capacity) {
+    pthread_mutex_lock(&rankings_lock);
+    int length = leaderboard_format(&rankings, count, text, text_capacity);
+    pthread_mutex_unlock(&rankings_lock);
+    return length;
+}
+
+// Write out every line recorded so far, stop the writer thread and free the totals
+void rankings_close(void) {
+    if (__atomic_exchange_n(&writer_running, 0, __ATOMIC_ACQ_REL)) {
+        pthread_join(writer_thread, NULL);
+    }
+    if (journal != NULL) {
+        fclose(journal);
+        journal = NULL;
+    }
+    leaderboard_destroy(&written);
+
+    pthread_mutex_lock(&rankings_lock);
+    leaderboard_destroy(&rankings);
+    pthread_mutex_unlock(&rankings_lock);
+}
+
+static void consume_line(const void *record, void *arg) {
+    const struct rankings_line *line = record;
+    (void)arg;
+    leaderboard_add_score(&written, line->name, line->score, 1);
+    if (journal != NULL) {
+        write_entry(journal, line->name, line->score, 1);
+        appended_lines++;
+    }
+}
+
+// Append every line waiting in the rings, and compact the journal once it holds more appended lines than
+// players (and at least RANKINGS_COMPACT_MIN_LINES). Returns the number of lines appended
+static int drain_rings(void) {
+    uint64_t dropped = 0;
+    int drained = ring_drain(&rings, consume_line, NULL, &dropped);
+    if (dropped > 0) {
+        log_warn("Rankings: %llu scores not written, the writer fell behind", (unsigned long long)dropped);
+    }
+    if (drained == 0 || journal == NULL) {
+        return drained;
+    }
+
+    if (fflush(journal) != 0) {
+        log_error("Rankings: write to %s failed", journal_path);
+    }
+    if (appended_lines >= RANKINGS_COMPACT_MIN_LINES && appended_lines > written.length) {
+        if (compact_journal(&written) < 0) {
+            log_error("Rankings: compacting %s failed, still appending to it", journal_path);
+            appended_lines = 0; // Try again once as many lines have piled up
+        } else {
+            // The old file was renamed over, so carry on appending to the compacted one
+            fclose(journal);
+            journal = fopen(journal_path, "a");
+            if (journal == NULL) {
+                log_error("Rankings: reopening %s failed, scores are no longer written", journal_path);
+            }
+        }
+    }
+    return drained;
+}
+
+// Drain the rings until rankings_close(), sleeping between passes while they are empty
+static void *run_writer_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        int running = __atomic_load_n(&writer_running, __ATOMIC_ACQUIRE);
+        int drained = drain_rings();
+        if (!running) {
+            break; // That was the final pass after rankings_close()
+        }
+        if (drained == 0) {
+            struct timespec interval = {0, RANKINGS_FLUSH_INTERVAL_MS * 1000000L};
+            nanosleep(&interval, NULL);
+        }
+    }
+    return NULL;
+}
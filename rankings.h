@@ -0,0 +1,24 @@
+#ifndef RANKINGS_H
+#define RANKINGS_H
+
+#include "leaderboard.h" // Ranked running totals
+
+#define RANKINGS_RING_SLOTS 1024         // Scores buffered per worker for the writer thread, a power of two
+#define RANKINGS_FLUSH_INTERVAL_MS 50    // How often the writer drains the rings when they are quiet
+#define RANKINGS_COMPACT_MIN_LINES 10000 // Appended lines before the journal is worth compacting
+
+// Where a player stands in the rankings across every game and room
+struct ranking {
+    int rank;           // 1 for the highest total
+    int total_score;
+    int games;
+    int ranked_players;
+};
+
+// Function Declarations
+int rankings_load(const char *path);
+void rankings_record(const char *name, int score, struct ranking *ranking);
+int rankings_format_top(int count, char **text, int *text_capacity);
+void rankings_close(void);
+
+#endif
@@ -0,0 +1,1167 @@
+#define _GNU_SOURCE       // accept4()
+#include <stdlib.h>       // Standard library functions (realloc, free, exit)
+#include <string.h>       // String manipulation functions (memset, memcpy)
+#include <unistd.h>       // POSIX API functions (close)
+#include <errno.h>        // Error codes (EINTR, EAGAIN, ENOBUFS, EMFILE)
+#include <time.h>         // Monotonic clock for timers (clock_gettime)
+#include <sys/resource.h> // File descriptor limits (getrlimit, setrlimit)
+#include "reactor.h"
+#include "uring.h"        // io_uring backend
+#include "log.h"          // Failed accepts and fatal event loop errors
+
+#define WHEEL_MASK (REACTOR_WHEEL_SIZE - 1)
+
+// io_uring backend
+#define URING_ENTRIES 1024          // Submission queue entries, the completion queue is four times larger
+#define URING_BUFFER_GROUP 0
+#define URING_RECV_BUFFERS 1024     // Receive buffers shared by every socket of the reactor, a power of two
+#define URING_RECV_BUFFER_SIZE 1024
+#define URING_SEND_BUFFER_SIZE (16 * 1024)
+#define URING_FREE_SEND_BUFFERS 64  // Emptied send buffers kept for reuse
+#define URING_MAX_HELD_BUFFERS 4    // Unread receive buffers a socket may hold before its receive is paused
+
+// Operations, stored in the low bits of the user data next to the stream pointer
+#define OP_RECV 1
+#define OP_SEND 2
+#define OP_ACCEPT 3
+#define OP_CANCEL 4
+#define OP_SHUTDOWN 5
+#define OP_CLOSE 6
+#define OP_MASK 7
+
+enum recv_state {
+    RECV_IDLE,      // No receive submitted
+    RECV_ARMED,     // Multishot receive posting a completion per read
+    RECV_CANCELLING // Too many buffers held, waiting for the receive to end
+};
+
+enum shutdown_state {
+    SHUTDOWN_NONE,
+    SHUTDOWN_REQUESTED, // Submitted once the last queued send completes
+    SHUTDOWN_SUBMITTED
+};
+
+// Bytes copied in by reactor_writev(), sent by a single IORING_OP_SEND
+struct send_buffer {
+    struct send_buffer *next; // Free list
+    size_t length;
+    char data[URING_SEND_BUFFER_SIZE];
+};
+
+// A socket registered with the io_uring backend. Completions carry a pointer to it rather than the fd, so it
+// outlives the handler table entry until every request submitted for it has completed
+struct reactor_stream {
+    struct reactor_stream *prev;   // Every stream, for reactor_destroy()
+    struct reactor_stream *next;
+    struct reactor_stream *stalled_next;
+    int fd;
+    int listener;
+    int accept_armed;              // Listeners: a multishot accept is running
+    int closing;                   // Closed or removed, completions are no longer dispatched
+    int close_when_idle;           // reactor_close() was called, the fd is closed once nothing is running on it
+    int operations;                // Submitted requests still to post their last completion
+    int stalled;                   // Receive ended with every buffer in use, rearmed once some are recycled
+
+    enum recv_state recv_state;
+    int eof;
+    int error;                     // errno of a failed receive or send, reported by the next read or write
+    int held_head;                 // Oldest received buffer not yet read, -1 if none
+    int held_tail;
+    int held_count;
+    size_t read_offset;            // Bytes of the oldest buffer already read
+
+    struct send_buffer *sending;   // In flight, at most one per socket so sends complete in order
+    size_t send_offset;
+    struct send_buffer *staged;    // Filled while a send is in flight, sent when it completes
+    int want_writable;             // A write was cut short, dispatch EPOLLOUT when the staged buffer is sent
+    enum shutdown_state shutdown_state;
+    int *handed_off;               // See reactor_hand_off(): sends go on after the stream is detached, set when freed
+};
+
+// A listening socket registered with either backend
+struct reactor_listener {
+    struct reactor *reactor;
+    int fd;
+    int paused;                    // Accepting stopped after a resource error, until resume_timer fires
+    struct reactor_timer resume_timer;
+};
+
+struct reactor_uring {
+    struct uring ring;
+    struct uring_buffers buffers;
+    int held_next[URING_RECV_BUFFERS];   // Received buffers queued on a stream, linked by buffer id
+    size_t held_length[URING_RECV_BUFFERS];
+    int recycled;                        // Buffers have been handed back since stalled streams were last rearmed
+    struct reactor_stream *streams;
+    struct reactor_stream *stalled;
+    struct send_buffer *free_sends;
+    int free_send_count;
+};
+
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Raise the soft open file limit to the hard limit so one process can hold as many connections as allowed
+static void raise_fd_limit(void) {
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Grow the handler table so that it can be indexed by fd
+static int reserve_handlers(struct reactor *reactor, int fd) {
+    if (fd < reactor->handler_capacity) {
+        return 0;
+    }
+
+    int new_capacity = reactor->handler_capacity > 0 ? reactor->handler_capacity : 64;
+    while (new_capacity <= fd) {
+        new_capacity *= 2;
+    }
+
+    struct reactor_handler *handlers = realloc(reactor->handlers, new_capacity * sizeof(struct reactor_handler));
+    if (handlers == NULL) {
+        return -1;
+    }
+
+    memset(handlers + reactor->handler_capacity, 0,
+           (new_capacity - reactor->handler_capacity) * sizeof(struct reactor_handler));
+    reactor->handlers = handlers;
+    reactor->handler_capacity = new_capacity;
+    return 0;
+}
+
+// Next free submission entry. If the queue is full, what is in it is submitted first
+static struct io_uring_sqe *get_sqe(struct reactor_uring *state) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&state->ring);
+    if (sqe == NULL) {
+        if (uring_submit(&state->ring, 0, 0) < 0) {
+            log_error("io_uring_enter failed: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        sqe = uring_get_sqe(&state->ring);
+        if (sqe == NULL) {
+            log_error("io_uring submission queue full");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return sqe;
+}
+
+// Submission entry for an operation on stream. The stream is kept until its completion arrives
+static struct io_uring_sqe *queue_operation(struct reactor_uring *state, struct reactor_stream *stream, int operation) {
+    struct io_uring_sqe *sqe = get_sqe(state);
+    sqe->fd = stream->fd;
+    sqe->user_data = (uint64_t)(uintptr_t)stream | operation;
+    stream->operations++;
+    return sqe;
+}
+
+// One multishot receive posts a completion, with a buffer picked by the kernel, each time data arrives
+static void arm_recv(struct reactor_uring *state, struct reactor_stream *stream) {
+    struct io_uring_sqe *sqe = queue_operation(state, stream, OP_RECV);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    stream->recv_state = RECV_ARMED;
+}
+
+static void rearm_recv(struct reactor_uring *state, struct reactor_stream *stream) {
+    if (stream->recv_state == RECV_IDLE && !stream->closing && !stream->listener && !stream->stalled &&
+        !stream->eof && !stream->error && stream->held_count < URING_MAX_HELD_BUFFERS) {
+        arm_recv(state, stream);
+    }
+}
+
+// One multishot accept posts a completion for every connection
+static void arm_accept(struct reactor_uring *state, struct reactor_stream *stream) {
+    struct io_uring_sqe *sqe = queue_operation(state, stream, OP_ACCEPT);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    stream->accept_armed = 1;
+}
+
+static void queue_send(struct reactor_uring *state, struct reactor_stream *stream) {
+    struct io_uring_sqe *sqe = queue_operation(state, stream, OP_SEND);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->addr = (uint64_t)(uintptr_t)(stream->sending->data + stream->send_offset);
+    sqe->len = (unsigned int)(stream->sending->length - stream->send_offset);
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+}
+
+// Send the staged buffer, unless a send is already in flight. Two sends on one socket can run at the same time on
+// kernel worker threads and interleave their bytes. Linking them with IOSQE_IO_LINK would keep the order, but a
+// send cut short ends the chain, so every send after it comes back cancelled and has to be submitted again. With
+// one send in flight, writes made meanwhile are gathered into the staged buffer and go out together. That also
+// submits no more than one send per socket per loop pass
+static void start_send(struct reactor_uring *state, struct reactor_stream *stream) {
+    if (stream->sending != NULL || stream->staged == NULL || stream->staged->length == 0) {
+        return;
+    }
+    stream->sending = stream->staged;
+    stream->staged = NULL;
+    stream->send_offset = 0;
+    queue_send(state, stream);
+}
+
+// Half-close once everything written before reactor_shutdown() has been sent
+static void start_shutdown(struct reactor_uring *state, struct reactor_stream *stream) {
+    if (stream->shutdown_state != SHUTDOWN_REQUESTED || stream->sending != NULL) {
+        return;
+    }
+    struct io_uring_sqe *sqe = queue_operation(state, stream, OP_SHUTDOWN);
+    sqe->opcode = IORING_OP_SHUTDOWN;
+    sqe->len = SHUT_WR;
+    stream->shutdown_state = SHUTDOWN_SUBMITTED;
+}
+
+// End the multishot receive. The completion that ends it sets recv_state back to RECV_IDLE
+static void cancel_recv(struct reactor_uring *state, struct reactor_stream *stream) {
+    struct io_uring_sqe *sqe = queue_operation(state, stream, OP_CANCEL);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t)(uintptr_t)stream | OP_RECV;
+    stream->recv_state = RECV_CANCELLING;
+}
+
+// Cancel every request still running on the streams socket
+static void cancel_operations(struct reactor_uring *state, struct reactor_stream *stream) {
+    struct io_uring_sqe *sqe = queue_operation(state, stream, OP_CANCEL);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+}
+
+static struct send_buffer *take_send_buffer(struct reactor_uring *state) {
+    struct send_buffer *buffer = state->free_sends;
+    if (buffer != NULL) {
+        state->free_sends = buffer->next;
+        state->free_send_count--;
+    } else {
+        buffer = malloc(sizeof(struct send_buffer));
+        if (buffer == NULL) {
+            return NULL;
+        }
+    }
+    buffer->length = 0;
+    return buffer;
+}
+
+static void release_send_buffer(struct reactor_uring *state, struct send_buffer *buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+    if (state->free_send_count < URING_FREE_SEND_BUFFERS) {
+        buffer->next = state->free_sends;
+        state->free_sends = buffer;
+        state->free_send_count++;
+    } else {
+        free(buffer);
+    }
+}
+
+// Give a receive buffer back to the kernel
+static void recycle_buffer(struct reactor_uring *state, int id) {
+    uring_buffers_add(&state->buffers, id);
+    uring_buffers_publish(&state->buffers);
+    state->recycled = 1;
+}
+
+static void pop_held_buffer(struct reactor_uring *state, struct reactor_stream *stream) {
+    int id = stream->held_head;
+    stream->held_head = state->held_next[id];
+    if (stream->held_head < 0) {
+        stream->held_tail = -1;
+    }
+    stream->held_count--;
+    stream->read_offset = 0;
+    recycle_buffer(state, id);
+}
+
+static struct reactor_stream *create_stream(struct reactor_uring *state, int fd) {
+    struct reactor_stream *stream = calloc(1, sizeof(struct reactor_stream));
+    if (stream == NULL) {
+        return NULL;
+    }
+    stream->fd = fd;
+    stream->held_head = -1;
+    stream->held_tail = -1;
+
+    stream->next = state->streams;
+    if (state->streams != NULL) {
+        state->streams->prev = stream;
+    }
+    state->streams = stream;
+    return stream;
+}
+
+static void free_stream(struct reactor_uring *state, struct reactor_stream *stream) {
+    if (stream->prev != NULL) {
+        stream->prev->next = stream->next;
+    } else {
+        state->streams = stream->next;
+    }
+    if (stream->next != NULL) {
+        stream->next->prev = stream->prev;
+    }
+
+    if (stream->stalled) {
+        struct reactor_stream **link = &state->stalled;
+        while (*link != stream) {
+            link = &(*link)->stalled_next;
+        }
+        *link = stream->stalled_next;
+    }
+
+    while (stream->held_head >= 0) {
+        pop_held_buffer(state, stream);
+    }
+    release_send_buffer(state, stream->sending);
+    release_send_buffer(state, stream->staged);
+    if (stream->handed_off != NULL) {
+        __atomic_store_n(stream->handed_off, 1, __ATOMIC_RELEASE);
+    }
+    free(stream);
+}
+
+static void close_if_idle(struct reactor_uring *state, struct reactor_stream *stream) {
+    if (!stream->close_when_idle || stream->operations > 0) {
+        return;
+    }
+    stream->close_when_idle = 0;
+    struct io_uring_sqe *sqe = queue_operation(state, stream, OP_CLOSE);
+    sqe->opcode = IORING_OP_CLOSE;
+}
+
+// Stream registered for fd, or NULL
+static struct reactor_stream *find_stream(struct reactor *reactor, int fd) {
+    if (fd < 0 || fd >= reactor->handler_capacity) {
+        return NULL;
+    }
+    return reactor->handlers[fd].stream;
+}
+
+// Detach a stream from its fd: nothing more is dispatched for it, and it is freed once its requests complete
+static struct reactor_stream *detach_stream(struct reactor *reactor, int fd) {
+    struct reactor_stream *stream = find_stream(reactor, fd);
+    if (fd >= 0 && fd < reactor->handler_capacity) {
+        memset(&reactor->handlers[fd], 0, sizeof(struct reactor_handler));
+    }
+    if (stream != NULL) {
+        stream->closing = 1;
+        while (stream->held_head >= 0) {
+            pop_held_buffer(reactor->uring, stream);
+        }
+    }
+    return stream;
+}
+
+static int accept_resource_error(int error) {
+    return error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM;
+}
+
+// A listener paused by accept_failed() has waited a tick: take connections again. With epoll, restoring EPOLLIN
+// reports the listener ready straight away if connections queued up meanwhile
+static void resume_accepting(void *arg) {
+    struct reactor_listener *listener = arg;
+    struct reactor *reactor = listener->reactor;
+
+    listener->paused = 0;
+    if (reactor->backend == REACTOR_EPOLL) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLET;
+        event.data.fd = listener->fd;
+        epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, listener->fd, &event);
+        return;
+    }
+
+    struct reactor_stream *stream = find_stream(reactor, listener->fd);
+    if (stream != NULL && !stream->accept_armed) {
+        arm_accept(reactor->uring, stream);
+    }
+}
+
+// Create the ring, checking for everything the backend relies on. Multishot receive came in the same
+// release as zero copy send, which the probe can report. Returns 0, or -1 if io_uring can't be used
+static int init_uring(struct reactor *reactor) {
+    struct reactor_uring *state = calloc(1, sizeof(struct reactor_uring));
+    if (state == NULL) {
+        return -1;
+    }
+    if (uring_init(&state->ring, URING_ENTRIES) < 0) {
+        free(state);
+        return -1;
+    }
+
+    unsigned int features = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((state->ring.features & features) != features ||
+        !uring_supports(&state->ring, IORING_OP_SEND_ZC) || !uring_supports(&state->ring, IORING_OP_SHUTDOWN) ||
+        uring_buffers_init(&state->ring, &state->buffers, URING_BUFFER_GROUP, URING_RECV_BUFFERS, URING_RECV_BUFFER_SIZE) < 0) {
+        uring_destroy(&state->ring);
+        free(state);
+        return -1;
+    }
+
+    reactor->uring = state;
+    return 0;
+}
+
+static void destroy_uring(struct reactor_uring *state) {
+    // Closes queued by reactor_close() still go through, if the loop ever ran
+    if (!state->ring.disabled) {
+        uring_submit(&state->ring, 0, 0);
+    }
+    uring_destroy(&state->ring);
+    uring_buffers_destroy(&state->ring, &state->buffers);
+
+    while (state->streams != NULL) {
+        struct reactor_stream *stream = state->streams;
+        state->streams = stream->next;
+        free(stream->sending);
+        free(stream->staged);
+        free(stream);
+    }
+    while (state->free_sends != NULL) {
+        struct send_buffer *buffer = state->free_sends;
+        state->free_sends = buffer->next;
+        free(buffer);
+    }
+    free(state);
+}
+
+// Use the io_uring backend if it is asked for and the kernel has everything it needs, otherwise epoll.
+// reactor->backend says which one it got
+int reactor_init(struct reactor *reactor, int backend) {
+    memset(reactor, 0, sizeof(*reactor));
+    reactor->epoll_fd = -1;
+
+    if (backend == REACTOR_URING && init_uring(reactor) == 0) {
+        reactor->backend = REACTOR_URING;
+    } else {
+        reactor->backend = REACTOR_EPOLL;
+        reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (reactor->epoll_fd < 0) {
+            return -1;
+        }
+    }
+
+    reactor->start_ms = monotonic_ms();
+    raise_fd_limit();
+    return 0;
+}
+
+void reactor_destroy(struct reactor *reactor) {
+    if (reactor->epoll_fd >= 0) {
+        close(reactor->epoll_fd);
+    }
+    if (reactor->uring != NULL) {
+        destroy_uring(reactor->uring);
+        reactor->uring = NULL;
+    }
+    for (int fd = 0; fd < reactor->handler_capacity; fd++) {
+        free(reactor->handlers[fd].listener);
+    }
+    free(reactor->handlers);
+    reactor->handlers = NULL;
+    reactor->handler_capacity = 0;
+}
+
+const char *reactor_backend_name(const struct reactor *reactor) {
+    return reactor->backend == REACTOR_URING ? "io_uring" : "epoll";
+}
+
+// Register fd with the event loop. With epoll all registrations are edge-triggered, so callbacks
+// must drain the socket until EAGAIN before returning. With io_uring, EPOLLIN is dispatched when data
+// arrives for reactor_readv() and EPOLLOUT when a write cut short can be retried, whatever events asks for
+int reactor_add(struct reactor *reactor, int fd, uint32_t events, reactor_callback callback, void *arg) {
+    if (reserve_handlers(reactor, fd) < 0) {
+        return -1;
+    }
+
+    struct reactor_stream *stream = NULL;
+    if (reactor->backend == REACTOR_URING) {
+        stream = create_stream(reactor->uring, fd);
+        if (stream == NULL) {
+            return -1;
+        }
+        arm_recv(reactor->uring, stream);
+    } else {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = events | EPOLLET;
+        event.data.fd = fd;
+
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            return -1;
+        }
+    }
+
+    reactor->handlers[fd].callback = callback;
+    reactor->handlers[fd].accept = NULL;
+    reactor->handlers[fd].arg = arg;
+    reactor->handlers[fd].stream = stream;
+    return 0;
+}
+
+// Register a listening socket. callback is called with every connection accepted on it
+int reactor_add_listener(struct reactor *reactor, int fd, reactor_accept_callback callback, void *arg) {
+    if (reactor->backend == REACTOR_URING) {
+        if (reserve_handlers(reactor, fd) < 0) {
+            return -1;
+        }
+        struct reactor_stream *stream = create_stream(reactor->uring, fd);
+        if (stream == NULL) {
+            return -1;
+        }
+        stream->listener = 1;
+        arm_accept(reactor->uring, stream);
+        reactor->handlers[fd].stream = stream;
+    } else if (reactor_add(reactor, fd, EPOLLIN, NULL, arg) < 0) {
+        return -1;
+    }
+
+    struct reactor_listener *listener = calloc(1, sizeof(struct reactor_listener));
+    if (listener == NULL) {
+        reactor_remove(reactor, fd);
+        return -1;
+    }
+    listener->reactor = reactor;
+    listener->fd = fd;
+    reactor_timer_init(&listener->resume_timer, resume_accepting, listener);
+
+    reactor->handlers[fd].accept = callback;
+    reactor->handlers[fd].arg = arg;
+    reactor->handlers[fd].listener = listener;
+    return 0;
+}
+
+// Unregister fd. Must be called before the fd is closed so that queued events for it are dropped
+void reactor_remove(struct reactor *reactor, int fd) {
+    if (fd < 0 || fd >= reactor->handler_capacity) {
+        return;
+    }
+
+    struct reactor_listener *listener = reactor->handlers[fd].listener;
+    if (listener != NULL) {
+        reactor_timer_cancel(reactor, &listener->resume_timer);
+        free(listener);
+        reactor->handlers[fd].listener = NULL;
+    }
+
+    if (reactor->backend == REACTOR_URING) {
+        struct reactor_stream *stream = detach_stream(reactor, fd);
+        if (stream != NULL) {
+            cancel_operations(reactor->uring, stream);
+        }
+        return;
+    }
+
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    memset(&reactor->handlers[fd], 0, sizeof(struct reactor_handler));
+}
+
+// Unregister and close fd. With io_uring, a write still staged is sent first if the socket takes it
+// straight away, as a last non-blocking write would be, and the fd is closed once requests on it are cancelled
+void reactor_close(struct reactor *reactor, int fd) {
+    if (reactor->backend == REACTOR_EPOLL) {
+        reactor_remove(reactor, fd);
+        close(fd);
+        return;
+    }
+
+    struct reactor_stream *stream = detach_stream(reactor, fd);
+    if (stream == NULL) {
+        close(fd);
+        return;
+    }
+
+    // Submitted in order, so the send is tried before the cancel. A shutdown runs on a kernel worker thread that
+    // looks the fd up when it gets to it, so the fd isn't closed (and can't be reused) until everything has finished
+    start_send(reactor->uring, stream);
+    if (stream->operations > 0) {
+        cancel_operations(reactor->uring, stream);
+    }
+    stream->close_when_idle = 1;
+    close_if_idle(reactor->uring, stream);
+}
+
+// Unregister fd for a socket another thread carries on with through a duplicate of it, and close fd once every
+// write made so far has been sent. Unlike reactor_close() nothing is cancelled but the receive: *done is set, with
+// release ordering, once the last send has completed and fd is closed. Until then the other thread must leave the
+// duplicate alone, or the two could write to the socket at the same time. Input held for fd is dropped, so read it
+// first. With epoll the writes have already been made and *done is set straight away
+void reactor_hand_off(struct reactor *reactor, int fd, int *done) {
+    struct reactor_stream *stream = reactor->backend == REACTOR_URING ? detach_stream(reactor, fd) : NULL;
+    if (stream == NULL) {
+        reactor_remove(reactor, fd);
+        close(fd);
+        __atomic_store_n(done, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    stream->handed_off = done;
+    if (stream->recv_state == RECV_ARMED) {
+        cancel_recv(reactor->uring, stream);
+    }
+    start_send(reactor->uring, stream);
+    stream->close_when_idle = 1;
+    close_if_idle(reactor->uring, stream);
+}
+
+// Read into parts. Returns the bytes read, 0 at end of stream, or -1 with errno set (EAGAIN if nothing is waiting)
+ssize_t reactor_readv(struct reactor *reactor, int fd, const struct iovec *parts, int count) {
+    if (reactor->backend == REACTOR_EPOLL) {
+        return readv(fd, parts, count);
+    }
+
+    struct reactor_uring *state = reactor->uring;
+    struct reactor_stream *stream = find_stream(reactor, fd);
+    if (stream == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    // Copy out of the received buffers, handing each back to the kernel once it is empty
+    size_t copied = 0;
+    int part = 0;
+    size_t part_offset = 0;
+    while (stream->held_head >= 0 && part < count) {
+        int id = stream->held_head;
+        size_t available = state->held_length[id] - stream->read_offset;
+        size_t space = parts[part].iov_len - part_offset;
+        size_t length = available < space ? available : space;
+
+        memcpy((char *)parts[part].iov_base + part_offset, uring_buffer(&state->buffers, id) + stream->read_offset, length);
+        copied += length;
+        stream->read_offset += length;
+        part_offset += length;
+        if (part_offset == parts[part].iov_len) {
+            part++;
+            part_offset = 0;
+        }
+        if (stream->read_offset == state->held_length[id]) {
+            pop_held_buffer(state, stream);
+        }
+    }
+
+    rearm_recv(state, stream);
+    if (copied > 0) {
+        return (ssize_t)copied;
+    }
+    if (stream->error) {
+        errno = stream->error;
+        return -1;
+    }
+    if (stream->eof) {
+        return 0;
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+// Write parts. Returns the bytes written, or -1 with errno set (EAGAIN if nothing could be taken).
+// With io_uring the bytes are copied into a send buffer and sent by the next submission
+ssize_t reactor_writev(struct reactor *reactor, int fd, const struct iovec *parts, int count) {
+    if (reactor->backend == REACTOR_EPOLL) {
+        return writev(fd, parts, count);
+    }
+
+    struct reactor_uring *state = reactor->uring;
+    struct reactor_stream *stream = find_stream(reactor, fd);
+    if (stream == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+    if (stream->error) {
+        errno = stream->error;
+        return -1;
+    }
+
+    size_t copied = 0;
+    int part = 0;
+    size_t part_offset = 0;
+    while (part < count) {
+        if (part_offset == parts[part].iov_len) {
+            part++;
+            part_offset = 0;
+            continue;
+        }
+        if (stream->staged != NULL && stream->staged->length == URING_SEND_BUFFER_SIZE) {
+            start_send(state, stream);
+            if (stream->staged != NULL) {
+                break; // A send is in flight and the next buffer is full
+            }
+        }
+        if (stream->staged == NULL) {
+            stream->staged = take_send_buffer(state);
+            if (stream->staged == NULL) {
+                break;
+            }
+        }
+
+        size_t space = URING_SEND_BUFFER_SIZE - stream->staged->length;
+        size_t length = parts[part].iov_len - part_offset;
+        if (length > space) {
+            length = space;
+        }
+        memcpy(stream->staged->data + stream->staged->length, (const char *)parts[part].iov_base + part_offset, length);
+        stream->staged->length += length;
+        part_offset += length;
+        copied += length;
+    }
+
+    start_send(state, stream);
+    if (part < count) {
+        stream->want_writable = 1;
+    }
+    if (copied == 0 && part < count) {
+        errno = stream->staged == NULL ? ENOMEM : EAGAIN;
+        return -1;
+    }
+    return (ssize_t)copied;
+}
+
+// Send end of stream once everything written so far has gone out, the socket stays open for reading
+int reactor_shutdown(struct reactor *reactor, int fd) {
+    if (reactor->backend == REACTOR_EPOLL) {
+        return shutdown(fd, SHUT_WR);
+    }
+
+    struct reactor_stream *stream = find_stream(reactor, fd);
+    if (stream == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+    if (stream->shutdown_state == SHUTDOWN_NONE) {
+        stream->shutdown_state = SHUTDOWN_REQUESTED;
+    }
+    start_send(reactor->uring, stream);
+    start_shutdown(reactor->uring, stream);
+    return 0;
+}
+
+void reactor_timer_init(struct reactor_timer *timer, reactor_timer_callback callback, void *arg) {
+    timer->prev = NULL;
+    timer->next = NULL;
+    timer->slot = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+int reactor_timer_armed(const struct reactor_timer *timer) {
+    return timer->slot != NULL;
+}
+
+// Link a timer into the slot covering its expiry: level 0 if it is due within 64 ticks, otherwise
+// the lowest level whose slots are wide enough
+static void link_timer(struct reactor *reactor, struct reactor_timer *timer) {
+    uint64_t delta = timer->expires - reactor->current_tick;
+    int level = 0;
+
+    while (level < REACTOR_WHEEL_LEVELS - 1 && delta >= (uint64_t)1 << (REACTOR_WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    if (delta >= (uint64_t)1 << (REACTOR_WHEEL_BITS * REACTOR_WHEEL_LEVELS)) {
+        // Past the top of the wheel, park it in the furthest slot
+        timer->expires = reactor->current_tick + ((uint64_t)1 << (REACTOR_WHEEL_BITS * REACTOR_WHEEL_LEVELS)) - 1;
+    }
+
+    struct reactor_timer **slot = &reactor->wheel[level][(timer->expires >> (REACTOR_WHEEL_BITS * level)) & WHEEL_MASK];
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot != NULL) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+    timer->slot = slot;
+}
+
+static void unlink_timer(struct reactor_timer *timer) {
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->slot = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+    timer->prev = NULL;
+    timer->next = NULL;
+    timer->slot = NULL;
+}
+
+// Arm a timer to fire after timeout_ms, rounded up to the next tick. Re-arming moves an armed timer
+void reactor_timer_arm(struct reactor *reactor, struct reactor_timer *timer, int timeout_ms) {
+    if (timer->slot != NULL) {
+        unlink_timer(timer);
+    } else {
+        reactor->timer_count++;
+    }
+
+    // Ticks are counted from reactor creation, the current tick may be behind the clock
+    uint64_t now_tick = (monotonic_ms() - reactor->start_ms) / REACTOR_TICK_MS;
+    uint64_t ticks = (timeout_ms + REACTOR_TICK_MS - 1) / REACTOR_TICK_MS;
+    timer->expires = now_tick + (ticks > 0 ? ticks : 1);
+    if (timer->expires <= reactor->current_tick) {
+        timer->expires = reactor->current_tick + 1;
+    }
+    link_timer(reactor, timer);
+}
+
+void reactor_timer_cancel(struct reactor *reactor, struct reactor_timer *timer) {
+    if (timer->slot == NULL) {
+        return;
+    }
+    unlink_timer(timer);
+    reactor->timer_count--;
+}
+
+// Move every timer in a slot of a higher level down to the level matching its remaining time
+static void cascade(struct reactor *reactor, int level) {
+    int index = (reactor->current_tick >> (REACTOR_WHEEL_BITS * level)) & WHEEL_MASK;
+    struct reactor_timer *timer = reactor->wheel[level][index];
+    reactor->wheel[level][index] = NULL;
+
+    while (timer != NULL) {
+        struct reactor_timer *next = timer->next;
+        link_timer(reactor, timer);
+        timer = next;
+    }
+}
+
+// Advance the wheel to the current time, firing every timer that has expired.
+// Callbacks may arm and cancel timers, including the one that fired
+static void run_timers(struct reactor *reactor) {
+    uint64_t now_tick = (monotonic_ms() - reactor->start_ms) / REACTOR_TICK_MS;
+
+    while (reactor->current_tick < now_tick && reactor->running) {
+        reactor->current_tick++;
+
+        // Each time a level wraps round, the next slot of the level above comes due
+        for (int level = 1; level < REACTOR_WHEEL_LEVELS; level++) {
+            if ((reactor->current_tick & (((uint64_t)1 << (REACTOR_WHEEL_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(reactor, level);
+        }
+
+        struct reactor_timer **slot = &reactor->wheel[0][reactor->current_tick & WHEEL_MASK];
+        while (*slot != NULL) {
+            struct reactor_timer *timer = *slot;
+            unlink_timer(timer);
+            reactor->timer_count--;
+            timer->callback(timer->arg);
+        }
+    }
+}
+
+// How long the loop may sleep: until the next occupied level 0 slot, or until level 1 next cascades
+static int next_timeout(struct reactor *reactor) {
+    if (reactor->timer_count == 0) {
+        return -1;
+    }
+
+    uint64_t ticks = REACTOR_WHEEL_SIZE - (reactor->current_tick & WHEEL_MASK);
+    for (uint64_t i = 1; i < ticks; i++) {
+        if (reactor->wheel[0][(reactor->current_tick + i) & WHEEL_MASK] != NULL) {
+            ticks = i;
+            break;
+        }
+    }
+
+    // A signed difference, so a start_ms that wrapped below zero still compares correctly
+    int64_t wait_ms = (int64_t)(reactor->start_ms + (reactor->current_tick + ticks) * REACTOR_TICK_MS - monotonic_ms());
+    return wait_ms > 0 ? (int)wait_ms : 0;
+}
+
+// Call the handler registered for a streams fd
+static void dispatch(struct reactor *reactor, struct reactor_stream *stream, uint32_t events) {
+    struct reactor_handler handler = reactor->handlers[stream->fd];
+    if (handler.stream == stream && handler.callback != NULL) {
+        handler.callback(stream->fd, events, handler.arg);
+    }
+}
+
+static void complete_recv(struct reactor *reactor, struct reactor_stream *stream, int result, unsigned int flags) {
+    struct reactor_uring *state = reactor->uring;
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+        stream->recv_state = RECV_IDLE;
+    }
+    if (flags & IORING_CQE_F_BUFFER) {
+        int id = (int)(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (result <= 0 || stream->closing) {
+            recycle_buffer(state, id);
+        } else {
+            state->held_next[id] = -1;
+            state->held_length[id] = (size_t)result;
+            if (stream->held_tail >= 0) {
+                state->held_next[stream->held_tail] = id;
+            } else {
+                stream->held_head = id;
+            }
+            stream->held_tail = id;
+            stream->held_count++;
+        }
+    }
+    if (stream->closing) {
+        return;
+    }
+
+    uint32_t events = 0;
+    if (result > 0) {
+        events = EPOLLIN;
+    } else if (result == 0) {
+        stream->eof = 1;
+        events = EPOLLIN | EPOLLRDHUP;
+    } else if (result == -ENOBUFS) {
+        // Every buffer is waiting to be read, try again once some are handed back
+        stream->stalled = 1;
+        stream->stalled_next = state->stalled;
+        state->stalled = stream;
+    } else if (result != -ECANCELED) {
+        stream->error = -result;
+        events = EPOLLIN | EPOLLERR;
+    }
+
+    // A client that sends faster than it is read holds buffers every other socket needs, so pause its receive
+    if (stream->recv_state == RECV_ARMED && stream->held_count >= URING_MAX_HELD_BUFFERS) {
+        cancel_recv(state, stream);
+    }
+    rearm_recv(state, stream);
+
+    if (events != 0) {
+        dispatch(reactor, stream, events);
+    }
+}
+
+static void complete_send(struct reactor *reactor, struct reactor_stream *stream, int result) {
+    struct reactor_uring *state = reactor->uring;
+
+    if (result > 0 && (!stream->closing || stream->handed_off != NULL)) {
+        stream->send_offset += (size_t)result;
+        if (stream->send_offset < stream->sending->length) {
+            queue_send(state, stream); // Cut short by a signal, send the rest
+            return;
+        }
+    } else if (result < 0 && result != -ECANCELED) {
+        stream->error = -result;
+    }
+    release_send_buffer(state, stream->sending);
+    stream->sending = NULL;
+    if (stream->closing) {
+        if (stream->handed_off != NULL && !stream->error) {
+            start_send(state, stream); // Everything written before the hand off still goes out, in order
+        }
+        return;
+    }
+
+    if (stream->error) {
+        dispatch(reactor, stream, EPOLLOUT | EPOLLERR);
+        return;
+    }
+    start_send(state, stream);
+    start_shutdown(state, stream);
+    if (stream->want_writable) {
+        stream->want_writable = 0;
+        dispatch(reactor, stream, EPOLLOUT);
+    }
+}
+
+// A failed accept on a registered listener: report a resource error to its owner as a shed connection, and stop
+// accepting for a tick either way, so the loop doesn't spin on an error that won't clear straight away
+static void accept_failed(struct reactor *reactor, const struct reactor_handler *handler, int error) {
+    errno = error;
+    if (accept_resource_error(error)) {
+        handler->accept(-1, NULL, handler->arg);
+    } else {
+        log_error("Accept failed: %s", strerror(errno));
+    }
+
+    struct reactor_listener *listener = handler->listener;
+    listener->paused = 1;
+    if (reactor->backend == REACTOR_EPOLL) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLET;
+        event.data.fd = listener->fd;
+        epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, listener->fd, &event);
+    }
+    reactor_timer_arm(reactor, &listener->resume_timer, REACTOR_TICK_MS);
+}
+
+static void complete_accept(struct reactor *reactor, struct reactor_stream *stream, int result, unsigned int flags) {
+    struct reactor_handler handler = reactor->handlers[stream->fd];
+    int registered = !stream->closing && handler.stream == stream;
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+        stream->accept_armed = 0;
+    }
+
+    if (result >= 0) {
+        if (registered) {
+            handler.accept(result, NULL, handler.arg);
+        } else {
+            close(result);
+        }
+    } else if (registered && result != -EINTR && result != -ECONNABORTED && result != -EAGAIN && result != -ECANCELED) {
+        accept_failed(reactor, &handler, -result);
+    }
+
+    // A paused listener is rearmed by resume_accepting()
+    if (!stream->accept_armed && !stream->closing && !(registered && handler.listener->paused)) {
+        arm_accept(reactor->uring, stream);
+    }
+}
+
+static void complete(struct reactor *reactor, uint64_t user_data, int result, unsigned int flags) {
+    struct reactor_stream *stream = (struct reactor_stream *)(uintptr_t)(user_data & ~(uint64_t)OP_MASK);
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+        stream->operations--;
+    }
+
+    switch (user_data & OP_MASK) {
+        case OP_RECV:
+            complete_recv(reactor, stream, result, flags);
+            break;
+        case OP_SEND:
+            complete_send(reactor, stream, result);
+            break;
+        case OP_ACCEPT:
+            complete_accept(reactor, stream, result, flags);
+            break;
+        default:
+            break; // Cancel, shutdown and close need nothing more
+    }
+
+    close_if_idle(reactor->uring, stream);
+    if (stream->closing && stream->operations == 0) {
+        free_stream(reactor->uring, stream);
+    }
+}
+
+// Rearm receives that ran out of buffers, now that some have been handed back
+static void resume_stalled(struct reactor_uring *state) {
+    if (!state->recycled) {
+        return;
+    }
+    state->recycled = 0;
+
+    struct reactor_stream *stream = state->stalled;
+    state->stalled = NULL;
+    while (stream != NULL) {
+        struct reactor_stream *next = stream->stalled_next;
+        stream->stalled = 0;
+        stream->stalled_next = NULL;
+        rearm_recv(state, stream);
+        stream = next;
+    }
+}
+
+// Submit everything queued since the last pass and wait for completions in a single system call,
+// then handle every completion posted
+static void run_uring(struct reactor *reactor) {
+    struct reactor_uring *state = reactor->uring;
+
+    // The ring may have been set up on another thread, requests are only issued from this one
+    if (uring_enable(&state->ring) < 0) {
+        log_error("io_uring enable failed: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    while (reactor->running) {
+        unsigned int wait_for = uring_peek_cqe(&state->ring) == NULL ? 1 : 0;
+        if (uring_submit(&state->ring, wait_for, next_timeout(reactor)) < 0) {
+            log_error("io_uring_enter failed: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        struct io_uring_cqe *cqe;
+        while (reactor->running && (cqe = uring_peek_cqe(&state->ring)) != NULL) {
+            uint64_t user_data = cqe->user_data;
+            int result = cqe->res;
+            unsigned int flags = cqe->flags;
+            uring_cqe_seen(&state->ring);
+            complete(reactor, user_data, result, flags);
+        }
+
+        resume_stalled(state);
+        run_timers(reactor);
+    }
+}
+
+// Accept every pending connection on a listener
+static void accept_ready(struct reactor *reactor, int fd, const struct reactor_handler *handler) {
+    if (handler->listener->paused) {
+        return; // Readiness reported before the pause took effect
+    }
+
+    for (;;) {
+        struct sockaddr_storage address;
+        socklen_t address_length = sizeof(address);
+        int client = accept4(fd, (struct sockaddr *)&address, &address_length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return; // Accept queue drained
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            accept_failed(reactor, handler, errno);
+            return;
+        }
+        handler->accept(client, (struct sockaddr *)&address, handler->arg);
+    }
+}
+
+// Dispatch ready events until reactor_stop() is called
+void reactor_run(struct reactor *reactor) {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    reactor->running = 1;
+    if (reactor->backend == REACTOR_URING) {
+        run_uring(reactor);
+        return;
+    }
+
+    while (reactor->running) {
+        int ready = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS, next_timeout(reactor));
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("epoll_wait failed: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < ready && reactor->running; i++) {
+            int fd = events[i].data.fd;
+            if (fd >= reactor->handler_capacity) {
+                continue;
+            }
+
+            // The handler may have been removed by an earlier callback in this batch
+            struct reactor_handler handler = reactor->handlers[fd];
+            if (handler.accept != NULL) {
+                accept_ready(reactor, fd, &handler);
+            } else if (handler.callback != NULL) {
+                handler.callback(fd, events[i].events, handler.arg);
+            }
+        }
+
+        run_timers(reactor);
+    }
+}
+
+void reactor_stop(struct reactor *reactor) {
+    reactor->running = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdint.h>     // Fixed width integer types (uint32_t)
+#include <sys/types.h>  // Signed sizes (ssize_t)
+#include <sys/epoll.h>  // epoll event flags (EPOLLIN, EPOLLRDHUP, etc.)
+#include <sys/socket.h> // Peer addresses (struct sockaddr)
+#include <sys/uio.h>    // Scatter/gather I/O (struct iovec)
+
+#define REACTOR_MAX_EVENTS 256 // Maximum number of ready events handled per epoll_wait() call
+#define REACTOR_TICK_MS 10     // Timer resolution
+#define REACTOR_WHEEL_BITS 6
+#define REACTOR_WHEEL_SIZE (1 << REACTOR_WHEEL_BITS) // Slots per wheel level
+#define REACTOR_WHEEL_LEVELS 4 // Four levels of 64 slots reach 64^4 ticks, about 46 hours
+
+// Event loop backends
+#define REACTOR_EPOLL 0 // Readiness: epoll_wait(), then a system call per accept, read and write
+#define REACTOR_URING 1 // Completions: multishot accept and recv, queued sends, one io_uring_enter() per loop
+
+// Called when a registered file descriptor becomes ready
+typedef void (*reactor_callback)(int fd, uint32_t events, void *arg);
+
+// Called when an armed timer expires
+typedef void (*reactor_timer_callback)(void *arg);
+
+// Called with each connection accepted on a listener. The socket is already non-blocking.
+// address is NULL when the backend doesn't report the peer. fd is -1, with errno set, when the process ran out
+// of descriptors or memory to accept with (EMFILE, ENFILE, ENOBUFS, ENOMEM). The listener then stops accepting
+// for a tick, and the connections queued on it wait in the kernel
+typedef void (*reactor_accept_callback)(int fd, const struct sockaddr *address, void *arg);
+
+struct reactor_stream;
+struct reactor_uring;
+struct reactor_listener;
+
+// A timer embedded in the object it times out. Armed timers are linked into a slot of the timer wheel
+struct reactor_timer {
+    struct reactor_timer *prev;
+    struct reactor_timer *next;
+    struct reactor_timer **slot;  // Head of the wheel slot the timer is linked into, NULL when not armed
+    uint64_t expires;             // Tick the timer fires on
+    reactor_timer_callback callback;
+    void *arg;
+};
+
+// Callback registered for a single file descriptor
+struct reactor_handler {
+    reactor_callback callback;
+    reactor_accept_callback accept; // Set instead of callback for listeners
+    void *arg;
+    struct reactor_stream *stream;  // io_uring backend: the sockets buffered input and queued output
+    struct reactor_listener *listener; // Listeners only: pauses accepting after a resource error
+};
+
+// Edge-triggered epoll event loop. Handlers are stored in a table indexed by fd,
+// so dispatching an event costs the same no matter how many sockets are registered.
+// Timers live in a hierarchical timer wheel: level 0 has one slot per tick, and each level above has
+// slots 64 times as wide that are cascaded down a level as their time comes up. Arming and cancelling
+// are a linked list insert and unlink, so the cost doesn't depend on how many timers are armed.
+// With the io_uring backend, sockets registered with reactor_add() must be read, written, half-closed
+// and closed through reactor_readv(), reactor_writev(), reactor_shutdown() and reactor_close(), which
+// with epoll are the plain system calls
+struct reactor {
+    int backend;
+    int epoll_fd;
+    struct reactor_uring *uring;      // io_uring backend state, NULL with epoll
+    int running;
+    struct reactor_handler *handlers; // Indexed by file descriptor
+    int handler_capacity;
+
+    struct reactor_timer *wheel[REACTOR_WHEEL_LEVELS][REACTOR_WHEEL_SIZE];
+    uint64_t start_ms;            // Monotonic clock when the reactor was created, tick 0
+    uint64_t current_tick;        // Last tick whose timers have run
+    int timer_count;              // Timers currently armed
+};
+
+// Function Declarations
+int reactor_init(struct reactor *reactor, int backend);
+void reactor_destroy(struct reactor *reactor);
+const char *reactor_backend_name(const struct reactor *reactor);
+int reactor_add(struct reactor *reactor, int fd, uint32_t events, reactor_callback callback, void *arg);
+int reactor_add_listener(struct reactor *reactor, int fd, reactor_accept_callback callback, void *arg);
+void reactor_remove(struct reactor *reactor, int fd);
+void reactor_close(struct reactor *reactor, int fd);
+void reactor_hand_off(struct reactor *reactor, int fd, int *done);
+ssize_t reactor_readv(struct reactor *reactor, int fd, const struct iovec *parts, int count);
+ssize_t reactor_writev(struct reactor *reactor, int fd, const struct iovec *parts, int count);
+int reactor_shutdown(struct reactor *reactor, int fd);
+void reactor_run(struct reactor *reactor);
+void reactor_stop(struct reactor *reactor);
+void reactor_timer_init(struct reactor_timer *timer, reactor_timer_callback callback, void *arg);
+void reactor_timer_arm(struct reactor *reactor, struct reactor_timer *timer, int timeout_ms);
+void reactor_timer_cancel(struct reactor *reactor, struct reactor_timer *timer);
+int reactor_timer_armed(const struct reactor_timer *timer);
+
+#endif
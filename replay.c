@@ -0,0 +1,341 @@
+#include <stdio.h>      // Standard input/output functions
+#include <stdlib.h>     // Standard library functions (calloc, realloc, free, exit)
+#include <string.h>     // String manipulation functions (memcpy, memset)
+#include <unistd.h>     // POSIX API functions (close, getopt)
+#include <fcntl.h>      // File control options (open)
+#include <sys/mman.h>   // Journal mapping (mmap, munmap)
+#include <sys/stat.h>   // Journal size (fstat)
+#include <time.h>       // Replay timing (clock_gettime)
+#include "journal.h"    // Record layout
+#include "game.h"       // Bitmask guess evaluation, the same code the server runs
+
+// Feeds a journal written by hangman_server -j back through the game logic as fast as it can, checking that
+// every guess reveals the same letters and every player finishes with the same score as they did live.
+// A deterministic regression test for game.c, and with -r a benchmark of it that needs no sockets
+
+#define MAX_REPORTED_MISMATCHES 10
+
+// A slot of a game being replayed
+struct replay_player {
+    uint64_t progress;
+    int guesses_left;
+    int seated;         // Joined or restored
+    int finished;
+};
+
+// A game being replayed, from its JOURNAL_GAME_START until every player has finished
+struct replay_game {
+    int id;
+    char goal_word[MAX_WORD_LENGTH + 1];
+    struct game_word game_word;
+    int max_guesses;
+    int players;        // Expected to finish, the game is dropped when they all have
+    int finished;
+    struct replay_player *slots;
+    int slot_capacity;
+    struct replay_game *next; // Chain of the hash bucket
+};
+
+struct replay_stats {
+    uint64_t records;
+    uint64_t games;
+    uint64_t guesses;
+    uint64_t finishes;
+    uint64_t skipped;     // Events for games or players the journal doesn't start, such as games older than the journal
+    uint64_t mismatches;
+};
+
+// Games in progress, chained by room id
+static struct replay_game **buckets = NULL;
+static int bucket_count = 0;
+static int game_count = 0;
+
+// Function Declarations
+void replay(const struct journal_record *records, size_t count, struct replay_stats *stats);
+void report_mismatch(struct replay_stats *stats, size_t index, const struct journal_record *record, const char *what);
+struct replay_game *find_game(int id);
+struct replay_game *start_game(int id);
+void free_game(struct replay_game *game);
+void free_games(void);
+struct replay_player *replay_slot(struct replay_game *game, int slot);
+
+int main(int argc, char **argv) {
+    int opt;
+    int repeats = 1;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+            case 'r':
+                repeats = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-r repeats] journal\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - 1 || repeats <= 0) {
+        fprintf(stderr, "Usage: %s [-r repeats] journal\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror("Journal open failed");
+        exit(EXIT_FAILURE);
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        perror("Journal stat failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // A record torn off the end by a crash is left out
+    size_t count = (size_t)info.st_size / JOURNAL_RECORD_SIZE;
+    const struct journal_record *records = NULL;
+    if (count > 0) {
+        records = mmap(NULL, count * JOURNAL_RECORD_SIZE, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (records == MAP_FAILED) {
+            perror("Journal mmap failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(fd);
+
+    struct replay_stats stats;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int pass = 0; pass < repeats; pass++) {
+        memset(&stats, 0, sizeof(stats));
+        replay(records, count, &stats);
+        free_games();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    uint64_t replayed = stats.guesses * (uint64_t)repeats;
+    printf("Replayed %llu records x %d: %llu games, %llu guesses, %llu finishes, %llu skipped, %llu mismatches\n",
+           (unsigned long long)stats.records, repeats, (unsigned long long)stats.games, (unsigned long long)stats.guesses,
+           (unsigned long long)stats.finishes, (unsigned long long)stats.skipped, (unsigned long long)stats.mismatches);
+    printf("%.3f s, %.0f records/s, %.0f guesses/s\n", seconds,
+           seconds > 0 ? stats.records * (double)repeats / seconds : 0.0, seconds > 0 ? replayed / seconds : 0.0);
+
+    if (records != NULL) {
+        munmap((void *)records, count * JOURNAL_RECORD_SIZE);
+    }
+    free(buckets);
+    return stats.mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Replay every record in order. Events of a room are journaled by the one worker that runs it, so they are
+// in order even though the records of different workers interleave
+void replay(const struct journal_record *records, size_t count, struct replay_stats *stats) {
+    for (size_t n = 0; n < count; n++) {
+        const struct journal_record *record = &records[n];
+        struct replay_game *game;
+        struct replay_player *player;
+        stats->records++;
+
+        switch (record->type) {
+            case JOURNAL_GAME_START:
+                game = start_game(record->room);
+                memcpy(game->goal_word, record->text, record->text_length);
+                game->goal_word[record->text_length] = '\0';
+                game->max_guesses = record->guesses_left;
+                game->players = record->count;
+                if (game_word_init(&game->game_word, game->goal_word) < 0) {
+                    report_mismatch(stats, n, record, "goal word can't be played");
+                    free_game(game);
+                    break;
+                }
+                stats->games++;
+                break;
+
+            case JOURNAL_JOIN:
+                if ((game = find_game(record->room)) == NULL || (player = replay_slot(game, record->slot)) == NULL) {
+                    stats->skipped++;
+                    break;
+                }
+                if (!player->seated) { // A player resuming a restored game keeps their progress
+                    player->seated = 1;
+                    player->progress = 0;
+                    player->guesses_left = game->max_guesses;
+                }
+                break;
+
+            case JOURNAL_RESTORE:
+                if ((game = find_game(record->room)) == NULL || (player = replay_slot(game, record->slot)) == NULL) {
+                    stats->skipped++;
+                    break;
+                }
+                player->seated = 1;
+                player->progress = record->mask;
+                player->guesses_left = record->guesses_left;
+                player->finished = record->correct;
+                game->finished += player->finished;
+                break;
+
+            case JOURNAL_GUESS: {
+                if ((game = find_game(record->room)) == NULL || (player = replay_slot(game, record->slot)) == NULL ||
+                    !player->seated) {
+                    stats->skipped++;
+                    break;
+                }
+                if (record->letter < 'A' || record->letter > 'Z') {
+                    report_mismatch(stats, n, record, "guess isn't a letter");
+                    break;
+                }
+                stats->guesses++;
+                uint64_t revealed = evaluate_guess(&game->game_word, &player->progress, (char)record->letter);
+                if (revealed == 0) {
+                    player->guesses_left--;
+                }
+                if (revealed != record->mask || (revealed != 0) != record->correct) {
+                    report_mismatch(stats, n, record, "guess revealed different letters");
+                } else if (player->guesses_left != record->guesses_left) {
+                    report_mismatch(stats, n, record, "guesses left differ");
+                }
+                break;
+            }
+
+            case JOURNAL_FINISH: {
+                if ((game = find_game(record->room)) == NULL || (player = replay_slot(game, record->slot)) == NULL ||
+                    !player->seated) {
+                    stats->skipped++;
+                    break;
+                }
+                stats->finishes++;
+                int solved = is_word_guessed(&game->game_word, player->progress);
+                int score = solved ? player->guesses_left : 0;
+                if (solved != record->correct || score != record->count) {
+                    report_mismatch(stats, n, record, "final score differs");
+                }
+                if (!player->finished) {
+                    player->finished = 1;
+                    game->finished++;
+                }
+                if (game->finished >= game->players) {
+                    free_game(game);
+                }
+                break;
+            }
+
+            case JOURNAL_ACCEPT:
+            case JOURNAL_NAME:
+            case JOURNAL_READY:
+                break; // Lobby events don't change game state
+
+            default:
+                report_mismatch(stats, n, record, "unknown record type");
+                break;
+        }
+    }
+}
+
+void report_mismatch(struct replay_stats *stats, size_t index, const struct journal_record *record, const char *what) {
+    if (stats->mismatches++ < MAX_REPORTED_MISMATCHES) {
+        fprintf(stderr, "Record %zu: room %d slot %d: %s (type %d, letter %c, mask %#llx, guesses left %d, count %d)\n",
+                index, record->room, record->slot + 1, what, record->type, record->letter ? record->letter : '-',
+                (unsigned long long)record->mask, record->guesses_left, record->count);
+    }
+}
+
+static unsigned int hash_room(int id) {
+    return ((unsigned int)id * 2654435761u) & (unsigned int)(bucket_count - 1);
+}
+
+struct replay_game *find_game(int id) {
+    if (bucket_count == 0) {
+        return NULL;
+    }
+    for (struct replay_game *game = buckets[hash_room(id)]; game != NULL; game = game->next) {
+        if (game->id == id) {
+            return game;
+        }
+    }
+    return NULL;
+}
+
+// Double the buckets once there are more games than buckets, so chains stay short
+static void grow_buckets(void) {
+    int old_count = bucket_count;
+    struct replay_game **old_buckets = buckets;
+
+    bucket_count = old_count > 0 ? old_count * 2 : 1024;
+    buckets = calloc(bucket_count, sizeof(struct replay_game *));
+    if (buckets == NULL) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int b = 0; b < old_count; b++) {
+        struct replay_game *game = old_buckets[b];
+        while (game != NULL) {
+            struct replay_game *next = game->next;
+            unsigned int bucket = hash_room(game->id);
+            game->next = buckets[bucket];
+            buckets[bucket] = game;
+            game = next;
+        }
+    }
+    free(old_buckets);
+}
+
+// A new game for room id. A game the room had before, such as one cut short by a restart, is replaced
+struct replay_game *start_game(int id) {
+    struct replay_game *game = find_game(id);
+    if (game != NULL) {
+        free_game(game);
+    }
+    if (game_count >= bucket_count) {
+        grow_buckets();
+    }
+
+    game = calloc(1, sizeof(struct replay_game));
+    if (game == NULL) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    game->id = id;
+    unsigned int bucket = hash_room(id);
+    game->next = buckets[bucket];
+    buckets[bucket] = game;
+    game_count++;
+    return game;
+}
+
+void free_game(struct replay_game *game) {
+    struct replay_game **link = &buckets[hash_room(game->id)];
+    while (*link != game) {
+        link = &(*link)->next;
+    }
+    *link = game->next;
+    game_count--;
+    free(game->slots);
+    free(game);
+}
+
+// Games abandoned part way through are still held at the end of a pass
+void free_games(void) {
+    for (int b = 0; b < bucket_count; b++) {
+        while (buckets[b] != NULL) {
+            free_game(buckets[b]);
+        }
+    }
+}
+
+// The state of a slot in game, grown to fit. Returns NULL if memory ran out
+struct replay_player *replay_slot(struct replay_game *game, int slot) {
+    if (slot >= game->slot_capacity) {
+        int capacity = game->slot_capacity > 0 ? game->slot_capacity : 4;
+        while (capacity <= slot) {
+            capacity *= 2;
+        }
+        struct replay_player *slots = realloc(game->slots, capacity * sizeof(struct replay_player));
+        if (slots == NULL) {
+            return NULL;
+        }
+        memset(slots + game->slot_capacity, 0, (capacity - game->slot_capacity) * sizeof(struct replay_player));
+        game->slots = slots;
+        game->slot_capacity = capacity;
+    }
+    return &game->slots[slot];
+}
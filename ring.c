@@ -0,0 +1,75 @@
+#include <stdlib.h>     // Standard library functions (aligned_alloc)
+#include <string.h>     // String manipulation functions (memset)
+#include "ring.h"
+
+// Rings are made on a threads first record, and only then is a lock taken
+static struct ring *register_thread(struct ring_set *set, struct ring **thread_ring) {
+    struct ring *ring = aligned_alloc(64, sizeof(struct ring) + set->record_size * set->slots);
+    if (ring == NULL) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(struct ring));
+
+    pthread_mutex_lock(&set->lock);
+    ring->next = set->rings;
+    __atomic_store_n(&set->rings, ring, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&set->lock);
+
+    *thread_ring = ring;
+    return ring;
+}
+
+// The next free slot of the calling threads ring, thread_ring being where the thread keeps its ring, NULL until
+// its first record. Never blocks: returns NULL, and counts the record as dropped, if the consumer is a full ring
+// behind. The record is handed over by ring_commit()
+void *ring_claim(struct ring_set *set, struct ring **thread_ring) {
+    struct ring *ring = *thread_ring != NULL ? *thread_ring : register_thread(set, thread_ring);
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= set->slots) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    return ring->records + (head & (set->slots - 1)) * set->record_size;
+}
+
+// Hand the record filled in since ring_claim() to the consumer
+void ring_commit(struct ring *ring) {
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+// Pass every record waiting in every ring to consume. Only the consumer thread may call this. Records lost to
+// full rings since the last drain are added to dropped. Returns the number of records consumed
+int ring_drain(struct ring_set *set, ring_consumer consume, void *arg, uint64_t *dropped) {
+    int drained = 0;
+
+    for (struct ring *ring = __atomic_load_n(&set->rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+
+        while (tail != head) {
+            consume(ring->records + (tail & (set->slots - 1)) * set->record_size, arg);
+            tail++;
+            drained++;
+
+            // Hand slots back as we go so a busy thread isn't held up by a long batch
+            if (tail % RING_HANDBACK_RECORDS == 0) {
+                __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            }
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        uint64_t ring_dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        *dropped += ring_dropped - ring->dropped_reported;
+        ring->dropped_reported = ring_dropped;
+    }
+    return drained;
+}
+
+// Whether the consumer has taken every record committed to ring
+int ring_empty(struct ring *ring) {
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->head;
+}
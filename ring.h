@@ -0,0 +1,42 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>     // Fixed width integer types (uint32_t, uint64_t)
+#include <stddef.h>     // Size type (size_t)
+#include <pthread.h>    // Ring registration lock
+
+#define RING_HANDBACK_RECORDS 64 // A draining consumer hands slots back at least this often
+
+// Single producer, single consumer ring of one thread's records. The thread only ever writes head and
+// the consumer only ever writes tail, each on its own cache line, so neither side takes a lock
+struct ring {
+    uint64_t head __attribute__((aligned(64))); // Next record to write
+    uint64_t dropped;                           // Records lost because the ring was full
+    uint64_t tail __attribute__((aligned(64))); // Next record to consume
+    uint64_t dropped_reported;
+    struct ring *next;                          // Every ring of the set, newest first
+    unsigned char records[] __attribute__((aligned(64)));
+};
+
+// Every thread's ring for one kind of record, drained by a single consumer thread. Each producing thread
+// keeps a pointer to its own ring, and registers it under the lock on its first record
+struct ring_set {
+    size_t record_size;
+    uint32_t slots;               // Records per ring, a power of two
+    struct ring *rings;
+    pthread_mutex_t lock;
+};
+
+#define RING_SET_INITIALIZER(size, count) \
+    { .record_size = (size), .slots = (count), .rings = NULL, .lock = PTHREAD_MUTEX_INITIALIZER }
+
+// Called by ring_drain() with each record in the order its thread wrote them
+typedef void (*ring_consumer)(const void *record, void *arg);
+
+// Function Declarations
+void *ring_claim(struct ring_set *set, struct ring **thread_ring);
+void ring_commit(struct ring *ring);
+int ring_drain(struct ring_set *set, ring_consumer consume, void *arg, uint64_t *dropped);
+int ring_empty(struct ring *ring);
+
+#endif
@@ -0,0 +1,194 @@
+#include <stdlib.h>     // Standard library functions (malloc, free)
+#include <string.h>     // String manipulation functions (memset, strncpy)
+#include "room.h"
+
+#define CACHE_LINE_SIZE 64
+
+// Reserve size bytes at *offset, starting the section on a new cache line
+static size_t reserve(size_t *offset, size_t size) {
+    size_t start = (*offset + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    *offset = start + size;
+    return start;
+}
+
+// Lay the per player arrays out after the room header: hot arrays first, then cold ones.
+// Points the arrays of room into its block when room isn't NULL, and returns the size of the block
+static size_t layout_room(struct room *room, int player_count) {
+    size_t offset = sizeof(struct room);
+    size_t n = player_count;
+
+    size_t connections = reserve(&offset, n * sizeof(struct connection *));
+    size_t client_sockets = reserve(&offset, n * sizeof(int));
+    size_t progress = reserve(&offset, n * sizeof(uint64_t));
+    size_t guesses_left = reserve(&offset, n * sizeof(int));
+    size_t game_finished = reserve(&offset, n * sizeof(int));
+    size_t generations = reserve(&offset, n * sizeof(uint32_t));
+
+    size_t free_slots = reserve(&offset, n * sizeof(int));
+    size_t player_names = reserve(&offset, n * sizeof(const char *));
+    size_t leaderboard = reserve(&offset, n * sizeof(int));
+    size_t result_entries = reserve(&offset, n * sizeof(struct leaderboard_entry *));
+    size_t tokens = reserve(&offset, n * sizeof(uint64_t));
+    size_t detached = reserve(&offset, n * sizeof(int));
+    size_t bots = reserve(&offset, n * sizeof(struct bot *));
+
+    if (room != NULL) {
+        char *base = (char *)room;
+        room->connections = (struct connection **)(base + connections);
+        room->client_sockets = (int *)(base + client_sockets);
+        room->progress = (uint64_t *)(base + progress);
+        room->guesses_left = (int *)(base + guesses_left);
+        room->game_finished = (int *)(base + game_finished);
+        room->generations = (uint32_t *)(base + generations);
+        room->free_slots = (int *)(base + free_slots);
+        room->player_names = (const char **)(base + player_names);
+        room->leaderboard = (int *)(base + leaderboard);
+        room->result_entries = (struct leaderboard_entry **)(base + result_entries);
+        room->tokens = (uint64_t *)(base + tokens);
+        room->detached = (int *)(base + detached);
+        room->bots = (struct bot **)(base + bots);
+    }
+
+    return reserve(&offset, 0);
+}
+
+void room_pool_init(struct room_pool *pool, int player_count) {
+    pool->player_count = player_count;
+    pool->room_size = layout_room(NULL, player_count);
+    pool->free_rooms = NULL;
+    pool->free_count = 0;
+}
+
+// Free every room block kept for reuse
+void room_pool_destroy(struct room_pool *pool) {
+    while (pool->free_rooms != NULL) {
+        struct room *room = pool->free_rooms;
+        pool->free_rooms = room->next;
+        leaderboard_destroy(&room->results);
+        free(room);
+    }
+    pool->free_count = 0;
+}
+
+// Take a room with space for the pools player count, ready to start playing. goal_word is copied into the room.
+// A block is only allocated when the pool has none left to reuse
+struct room *room_create(struct room_pool *pool, int id, const char *goal_word) {
+    struct leaderboard results;
+    struct room *room = pool->free_rooms;
+    if (room != NULL) {
+        pool->free_rooms = room->next;
+        pool->free_count--;
+        results = room->results;
+        leaderboard_clear(&results);
+    } else {
+        room = aligned_alloc(CACHE_LINE_SIZE, pool->room_size);
+        if (room == NULL) {
+            return NULL;
+        }
+        if (leaderboard_init(&results) < 0) {
+            free(room);
+            return NULL;
+        }
+    }
+
+    memset(room, 0, pool->room_size);
+    layout_room(room, pool->player_count);
+    room->results = results;
+    room->pool = pool;
+    room->id = id;
+    room->phase = PHASE_PLAYING;
+    strncpy(room->goal_word, goal_word, MAX_WORD_LENGTH);
+    room->player_count = pool->player_count;
+    room->snapshot_index = -1;
+
+    if (game_word_init(&room->game_word, room->goal_word) < 0) {
+        room_destroy(room);
+        return NULL;
+    }
+
+    // Push the slots in reverse so players fill the room from slot 0 up
+    for (int slot = room->player_count - 1; slot >= 0; slot--) {
+        room->free_slots[room->free_count++] = slot;
+    }
+
+    return room;
+}
+
+// Return a room to its pool. Client connections must already be closed, and spectators let go with their events published
+void room_destroy(struct room *room) {
+    if (room == NULL) {
+        return;
+    }
+
+    struct room_pool *pool = room->pool;
+    room->prev = NULL;
+    room->next = pool->free_rooms;
+    pool->free_rooms = room;
+    pool->free_count++;
+}
+
+// Take an empty slot for a new player. Returns the slot, or -1 if the room is full
+int room_alloc_slot(struct room *room) {
+    if (room->free_count == 0) {
+        return -1;
+    }
+    return room->free_slots[--room->free_count];
+}
+
+// Reset a slot whose player has left and put it back on the free list.
+// No other player moves, and handles to the old player stop matching the slot
+void room_free_slot(struct room *room, int slot) {
+    if (room->result_entries[slot] != NULL) {
+        leaderboard_remove(&room->results, room->result_entries[slot]);
+        room->result_entries[slot] = NULL;
+    }
+    room->player_names[slot] = NULL;
+    room->bots[slot] = NULL;
+    room->connections[slot] = NULL;
+    room->client_sockets[slot] = 0;
+    room->leaderboard[slot] = 0;
+    room->guesses_left[slot] = 0;
+    room->progress[slot] = 0;
+    room->game_finished[slot] = 0;
+    room->tokens[slot] = 0;
+    room->detached[slot] = 0;
+
+    room->generations[slot]++;
+    room->free_slots[room->free_count++] = slot;
+}
+
+player_id room_player_id(struct room *room, int slot) {
+    return ((player_id)room->generations[slot] << 32) | (uint32_t)slot;
+}
+
+// Resolve a player handle to its slot. Returns -1 if the player has left the room
+int room_find_player(struct room *room, player_id id) {
+    uint32_t slot = (uint32_t)id;
+    if (slot >= (uint32_t)room->player_count || room->connections[slot] == NULL ||
+        room->generations[slot] != (uint32_t)(id >> 32)) {
+        return -1;
+    }
+    return (int)slot;
+}
+
+void room_list_add(struct room **head, struct room *room) {
+    room->prev = NULL;
+    room->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = room;
+    }
+    *head = room;
+}
+
+void room_list_remove(struct room **head, struct room *room) {
+    if (room->prev != NULL) {
+        room->prev->next = room->next;
+    } else {
+        *head = room->next;
+    }
+    if (room->next != NULL) {
+        room->next->prev = room->prev;
+    }
+    room->prev = NULL;
+    room->next = NULL;
+}
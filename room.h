@@ -0,0 +1,114 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <stdint.h>     // Fixed width integer types (uint64_t)
+#include "game.h"       // Bitmask guess evaluation
+#include "leaderboard.h" // Ranked final scores
+
+// Phases a player goes through, each one handled by the same event loop. The first three are spent
+// in the workers lobby (see lobby.h), a room only exists once its game starts
+enum game_phase {
+    PHASE_NAME_INPUT,  // Connected, waiting for a username
+    PHASE_READY_UP,    // Waiting for the player to send 'r'
+    PHASE_QUEUED,      // Ready, waiting for enough players to start a game
+    PHASE_PLAYING,     // Players are guessing letters
+    PHASE_LEADERBOARD, // Leaderboard sent, waiting for the clients to hang up
+    PHASE_SPECTATING   // Not a player: watching a room, see spectator.h
+};
+
+struct room;
+struct room_pool;
+struct worker;
+struct connection;
+struct output_chunk;
+struct bot;
+
+// Handle to a player slot: the slot index in the low 32 bits and the slots generation in the high 32 bits.
+// The generation is bumped every time a slot is freed, so a handle kept after its player left never
+// matches whoever takes the slot next
+typedef uint64_t player_id;
+
+#define PLAYER_NAME_SIZE LEADERBOARD_NAME_SIZE // Longest username kept, including the terminating NUL
+
+// A single independent game: its own goal word, players and phase.
+// The room and all of its per player arrays live in one block taken from a room_pool. The arrays
+// touched on every guess sit together at the front, the ones only used between phases come after
+struct room {
+    int id;
+    struct worker *worker;        // Worker thread that owns the room, its sockets are on that workers event loop
+    struct room_pool *pool;       // Pool the room's block is returned to
+    enum game_phase phase;
+    uint64_t phase_started;       // metrics_now_us() when the current phase began
+    char goal_word[MAX_WORD_LENGTH + 1];
+    struct game_word game_word;   // Goal word precomputed into letter to position masks
+    int player_count;             // Most players the room can hold
+    struct leaderboard results;   // Final scores, ranked as each player finishes. Kept with the block when it is pooled
+
+    // Per player state, indexed by slot. A player keeps the same slot until they leave, empty slots
+    // have no connection and are kept on a free list
+
+    // Hot: read on every event and guess
+    struct connection **connections;
+    int *client_sockets;
+    uint64_t *progress;           // Bit j is set once a player has revealed position j of the goal word
+    int *guesses_left;            // Remaining guesses for each player
+    int *game_finished;           // Tracks whether a player has finished
+    uint32_t *generations;        // Bumped each time a slot is freed
+
+    // Cold: touched when players join, leave or change phase
+    int *free_slots;              // Stack of empty slots, popped on connect and pushed on disconnect
+    int free_count;
+    const char **player_names;    // Interned usernames, see names.h. NULL for an empty slot
+    int *leaderboard;
+    struct leaderboard_entry **result_entries; // Each players entry in results, once they have finished
+    uint64_t *tokens;             // Resume token each player can reattach with after a restart
+    int *detached;                // Slot held for a player restored from a snapshot who hasn't come back yet
+    struct bot **bots;            // Bot playing the slot, NULL for a human player, see bot.h
+
+    // Phase counters
+    int connected_players;        // Tracks players still in the room
+    int finished_players;         // Tracks how many players have finished guessing
+    int bot_count;                // Bots among the connected players
+
+    // Snapshot record the room is copied into while its game is in progress, -1 without one.
+    // Marked dirty whenever a player's state changes, and copied on the workers next snapshot tick
+    int snapshot_index;
+    int snapshot_dirty;
+
+    // Spectators, linked through their lobby links, and the event frames encoded for them that haven't been
+    // queued on their connections yet. Rooms with such events are linked into the workers publish list
+    struct connection *spectators;
+    int spectator_count;
+    struct output_chunk *events;
+    struct room **publish_list;
+    struct room *publish_prev;
+    struct room *publish_next;
+    int publish_queued;
+
+    // Links in the list of active rooms, or in the pool's free list
+    struct room *prev;
+    struct room *next;
+};
+
+// Rooms closed on a worker are kept for reuse, so opening and closing games doesn't go through malloc.
+// Every room on a worker has space for the same number of players, so every block is the same size
+struct room_pool {
+    int player_count;
+    size_t room_size;             // Room header plus its per player arrays
+    struct room *free_rooms;
+    int free_count;
+};
+
+// Function Declarations
+void room_pool_init(struct room_pool *pool, int player_count);
+void room_pool_destroy(struct room_pool *pool);
+struct room *room_create(struct room_pool *pool, int id, const char *goal_word);
+void room_destroy(struct room *room);
+int room_alloc_slot(struct room *room);
+void room_free_slot(struct room *room, int slot);
+player_id room_player_id(struct room *room, int slot);
+int room_find_player(struct room *room, player_id id);
+void room_list_add(struct room **head, struct room *room);
+void room_list_remove(struct room **head, struct room *room);
+
+#endif
@@ -5,175 +5,522 @@
 #include <arpa/inet.h>  // Networking functions (socket, bind, listen, accept, inet_ntoa)
 #include <sys/types.h>  // System data types (for socket operations)
 #include <sys/socket.h> // Socket programming functions
-#include <sys/select.h> // Multiplexing functions (select, FD_SET, etc.)
+#include <fcntl.h>      // File control options (fcntl, O_NONBLOCK)
+#include <errno.h>      // Error codes (EAGAIN, EWOULDBLOCK, EINTR)
+#include <pthread.h>    // Worker threads
+#include <signal.h>     // Dictionary reload on SIGHUP (sigwait)
+#include <sys/random.h> // Resume token seeds (getrandom)
 #include <ctype.h>
 #include <time.h>
+#include "reactor.h"    // Event loop over epoll or io_uring
+#include "room.h"       // Independent game rooms
+#include "connection.h" // Per client state and framed input buffer
+#include "lobby.h"      // Players waiting for a game
+#include "admission.h"  // Connection rate and lobby limits
+#include "game.h"       // Bitmask guess evaluation
+#include "protocol.h"   // Legacy and v2 wire formats
+#include "dictionary.h" // Indexed word list
+#include "rankings.h"   // Persistent totals across games
+#include "snapshot.h"   // Games in progress kept across restarts
+#include "spectator.h"  // Spectators and their shared event stream
+#include "names.h"      // Interned usernames, one player per name
+#include "bot.h"        // Server side players for games short of humans
+#include "journal.h"    // Append-only record of every game event
+#include "metrics.h"    // Per worker counters and latency histograms
+#include "log.h"        // Asynchronous leveled logging
 
 // Server Configuration Constants
 #define PORT 8080         // The port number the server listens on
-// #define player_count 3 // Maximum number of players allowed in the game
 #define MAX_GUESSES 8     // Maximum wrong guesses allowed per player
+#define MAX_ROOMS 1024    // Maximum number of games running at the same time
+#define DEFAULT_DICTIONARY "words.txt" // Word list used when -d isn't given
+#define DEFAULT_RANKINGS "rankings.txt" // Rankings journal used when -r isn't given
+#define SNAPSHOT_INTERVAL_MS 100 // How often each worker copies the rooms that changed into the snapshot
+#define TOP_RANKINGS 5    // Overall leaders printed after each game
+#define DEFAULT_METRICS_PORT 9100 // Local admin port serving Prometheus metrics, 0 with -m turns it off
+#define MAX_LOBBY_PLAYERS 4096 // Players per worker waiting outside a game before new connections are turned away
+#define DEFAULT_QUEUE_WAIT_MS 5000 // Longest a smaller game waits for more players, see -n and -t
+#define DEFAULT_BACKLOG 4096 // Pending connections each listener holds, see -a. The kernel caps it at net.core.somaxconn
+
+// Deadlines for a player the room or lobby is waiting on, after which they are disconnected
+#define NAME_TIMEOUT_MS 60000   // From connecting to sending a username
+#define READY_TIMEOUT_MS 60000  // From the ready prompt to sending 'r'
+#define GUESS_TIMEOUT_MS 60000  // Between guesses, until the player has finished
+#define LINGER_TIMEOUT_MS 10000 // From the leaderboard to the client hanging up
+#define RESUME_TIMEOUT_MS 60000 // From a restart to players of restored games taking their slots back
+
+struct worker;
 
 // Function Declarations
-int create_server(int player_count);
-void add_new_player(int server_fd, int *client_sockets, int *connections_pending_name_input, int *connections_players);
-int reject_incoming_connections(int server_fd, fd_set *readfds);
-void handle_client_name_input(int *client_sockets, char **player_names, int *name_received, int *connected_players, int *connections_pending_name_input);
-void handle_ready_up(int server_fd, int *client_sockets, fd_set *readfds, char **player_names, int *connected_players);
-void play_hangman(int server_fd, int *client_sockets, int *connected_players, char *goal_word, fd_set *readfds, char **player_names);
-int is_word_guessed(int *player_progress, int word_length);
-void format_and_send_leaderboard(int server_fd, int *client_sockets, int *connected_players, int *leaderboard, char * goal_word, fd_set *readfds, char **player_names);
-void random_goal_word();
-
-// Global pointer to dynamically allocated goal word
-char *goal_word = NULL; 
+void *run_worker(void *arg);
+int create_server(int backlog, int reuse_port);
+int set_nonblocking(int fd);
+void on_accept(int new_socket, const struct sockaddr *address, void *arg);
+void on_client_event(int sd, uint32_t events, void *arg);
+void service_player(struct room *room, int i);
+void service_lobby_player(struct connection *connection);
+void service_room(struct room *room);
+enum input_status handle_player_input(struct room *room, int i, enum input_status status);
+enum input_status handle_lobby_input(struct connection *connection, enum input_status status);
+void add_new_player(struct worker *worker, int new_socket, const struct sockaddr *address);
+int reject_incoming_connections(int new_socket);
+void matchmake(struct worker *worker);
+void on_lobby_timer(void *arg);
+int open_game(struct worker *worker, int players);
+void join_room(struct room *room, struct connection *connection);
+void requeue_player(struct room *room, int i);
+enum input_status play_hangman(struct room *room, int i, enum input_status status);
+uint64_t apply_guess(struct room *room, int i, char guess);
+enum input_status handle_leaderboard_input(struct room *room, int i, enum input_status status);
+void record_final_score(struct room *room, int i);
+void advance_game_phase(struct room *room);
+void start_game(struct room *room);
+void start_leaderboard(struct room *room);
+void send_leaderboard(struct room *room);
+void send_ranking(struct room *room, int i);
+void close_room(struct room *room);
+void close_client(struct reactor *reactor, struct connection *connection);
+void remove_player(struct room *room, int i);
+void remove_lobby_player(struct connection *connection);
+void flush_connections(struct worker *worker);
+void on_player_timeout(void *arg);
+void arm_deadline(struct room *room, int i, int timeout_ms);
+void record_phase_duration(struct room *room, struct histogram *histogram);
+void record_lobby_phase(struct connection *connection, struct histogram *histogram);
+uint64_t next_resume_token(struct worker *worker);
+void take_snapshot_record(struct room *room);
+void release_snapshot_record(struct room *room);
+void write_snapshot(struct worker *worker);
+void on_snapshot_timer(void *arg);
+void restore_rooms(void);
+struct room *restore_room(struct worker *worker, const struct snapshot_room *record);
+int compare_resume_entries(const void *a, const void *b);
+const struct resume_entry *find_resume_entry(uint64_t token);
+int slot_waiting(const struct resume_entry *entry, uint64_t token);
+int resume_player(struct connection *connection, uint64_t token);
+int hand_off_player(struct connection *connection, struct worker *owner);
+void take_handed_player(struct worker *worker, struct connection *connection);
+void service_buffered_input(struct connection *connection);
+void attach_player(const struct resume_entry *entry, struct connection *connection);
+void on_inbox_timer(void *arg);
+void drop_detached_players(struct worker *worker);
+struct worker *room_owner(int room_id);
+struct room *find_room(struct worker *worker, int room_id);
+int spectate_room(struct connection *connection, int room_id);
+void watch_room(struct room *room, struct connection *connection);
+void service_spectator(struct connection *connection);
+void remove_spectator(struct connection *connection);
+void release_spectators(struct room *room);
+void add_bots(struct room *room, int count);
+void on_bot_think(void *arg);
+int bot_think_delay(struct worker *worker);
+void remove_bots(struct room *room);
+int random_goal_word(char *goal_word, unsigned int *seed);
+
 int max_player_count = 0;
 int player_count = 0;
+int worker_count = 0;
+int min_player_count = 0;      // Fewest players a game starts with once the queue has waited, see -n
+int max_queue_wait_ms = DEFAULT_QUEUE_WAIT_MS;
+int snapshot_enabled = 0;
+int listen_backlog = DEFAULT_BACKLOG;
+int goal_band = DICTIONARY_ANY; // Difficulty band goal words are picked from, see -D
+int bot_think_ms = -1;          // Mean delay before each bot guess, see -o. Negative while bots are off
+uint64_t admission_rate = 0;    // New connections admitted per second across all workers, see -A. 0 for no limit
+
+// Each worker thread runs its own event loop on its own SO_REUSEPORT listener.
+// Players wait in the workers lobby until the queue can start a game, and rooms are pinned to the
+// worker that opened them, so game state is never shared between threads
+struct worker {
+    int index;
+    pthread_t thread;
+    int server_fd;
+    struct reactor reactor;     // Event loop shared by every room and phase on this worker
+
+    struct lobby lobby;         // Players waiting for a game
+    struct admission admission; // Turns new connections away when the lobby is full or they arrive too fast
+    struct reactor_timer lobby_timer; // Armed while a smaller game waits on the longest queued player
+    struct room *running_rooms; // Rooms whose game has started
+    int room_count;
+    int next_room_id;
+    uint32_t next_connection;   // Numbers accepted connections for the journal, interleaved across workers like room ids
+    unsigned int rand_seed;     // Per worker seed for rand_r(), rand() takes a global lock
+    struct room_pool room_pool; // Blocks of closed rooms, reused for new ones
+    struct connection *flush_list; // Connections with output queued while handling the current event
+    struct room *publish_list;  // Rooms with spectator events encoded while handling the current event
+    char *leaderboard_text;     // Reused for formatting leaderboards, grown as needed
+    int leaderboard_text_capacity;
+    struct metrics metrics;     // Written only by this worker, read by the admin thread
+
+    uint64_t token_state;       // Resume token generator, seeded from the kernel
+    int snapshot_free[MAX_ROOMS]; // Records of this workers snapshot section not used by a room
+    int snapshot_free_count;
+    struct reactor_timer snapshot_timer;
+
+    // Players resuming a game and spectators watching one that runs on this worker are handed over by
+    // the worker that accepted them, through the inbox. It is checked every tick, and closed when the worker stops
+    pthread_mutex_t inbox_lock;
+    struct connection *inbox;
+    int inbox_closed;
+    struct connection *arrived; // Taken from the inbox, each waiting for the worker that sent it to finish with its socket
+    struct reactor_timer inbox_timer;
+
+    // After a restart, players of restored games have until resume_until to come back
+    int detached_players;       // Slots still held for restored players
+    uint64_t resume_until;
+};
+
+// A slot held for a player of a restored game, found by the token they resume with
+struct resume_entry {
+    uint64_t token;
+    struct worker *worker;      // Worker the restored room runs on
+    struct room *room;
+    int slot;
+};
+
+struct worker *workers = NULL;
+struct resume_entry *resume_entries = NULL; // Sorted by token. Filled before the workers start and only read after
+int resume_entry_count = 0;
+
+int main(int argc, char **argv) {
+    int opt;
+    const char *dictionary_path = DEFAULT_DICTIONARY;
+    const char *rankings_path = DEFAULT_RANKINGS;
+    const char *snapshot_path = NULL; // Snapshots are off unless -s names a file
+    const char *journal_path = NULL;
+    int metrics_port = DEFAULT_METRICS_PORT;
+    int level = LOG_INFO;
+    int backend = REACTOR_EPOLL;
+
+    // Default to one worker per online core
+    worker_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "w:d:r:s:j:m:p:l:b:n:t:a:A:o:D:")) != -1) {
+        switch (opt) {
+            case 'w':
+                worker_count = atoi(optarg);
+                break;
+            case 'd':
+                dictionary_path = optarg;
+                break;
+            case 'r':
+                rankings_path = optarg;
+                break;
+            case 's':
+                snapshot_path = optarg;
+                break;
+            case 'j':
+                journal_path = optarg;
+                break;
+            case 'm':
+                metrics_port = atoi(optarg);
+                break;
+            case 'p':
+                max_player_count = atoi(optarg);
+                break;
+            case 'l':
+                level = log_parse_level(optarg);
+                if (level < 0) {
+                    fprintf(stderr, "Unknown log level %s, expected debug, info, warn or error\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'n':
+                min_player_count = atoi(optarg);
+                break;
+            case 't':
+                max_queue_wait_ms = atoi(optarg);
+                break;
+            case 'a':
+                listen_backlog = atoi(optarg);
+                break;
+            case 'A':
+                admission_rate = strtoull(optarg, NULL, 10);
+                break;
+            case 'o':
+                bot_think_ms = atoi(optarg);
+                break;
+            case 'D':
+                goal_band = dictionary_find_band(optarg);
+                if (goal_band == DICTIONARY_ANY) {
+                    fprintf(stderr, "Unknown difficulty %s, expected easy, medium or hard\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'b':
+                if (strcmp(optarg, "epoll") == 0) {
+                    backend = REACTOR_EPOLL;
+                } else if (strcmp(optarg, "uring") == 0) {
+                    backend = REACTOR_URING;
+                } else {
+                    fprintf(stderr, "Unknown backend %s, expected epoll or uring\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-w workers] [-p players] [-n min players] [-t queue wait ms] [-a backlog] [-A connections/s] [-o bot think ms] [-d dictionary] [-D easy|medium|hard] [-r rankings] [-s snapshot] [-j journal] [-m metrics port] [-l log level] [-b epoll|uring]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (worker_count <= 0) {
+        worker_count = 1;
+    }
 
-int main(void) {
-    srand(time(NULL)); // Ensure randomness
-    printf("Enter the maximum number of players allowed in the game: ");
-    scanf("%d", &max_player_count);
-    printf("Max players: %d\n", max_player_count);
+    // Ask for the room size unless -p gave it, so the server can also be started unattended
+    if (max_player_count == 0) {
+        printf("Enter the maximum number of players allowed in each game: ");
+        if (scanf("%d", &max_player_count) != 1) {
+            max_player_count = 0;
+        }
+    }
     player_count = max_player_count;
 
-    int *client_sockets = malloc(player_count * sizeof(int));
-    char **player_names = malloc(player_count * sizeof(char *));
-    int *name_received = malloc(player_count * sizeof(int));
-    int *leaderboard = malloc(player_count * sizeof(int));
+    // Everything from here on is logged through the log thread, written out after anything already on stdout
+    fflush(stdout);
+    if (log_start(level) < 0) {
+        perror("Log thread creation failed");
+        exit(EXIT_FAILURE);
+    }
+    atexit(log_stop);
+    log_info("Max players: %d", max_player_count);
 
-    if (!client_sockets || !player_names || !name_received || !leaderboard) {
-        perror("Memory allocation failed");
+    if (player_count <= 0 || player_count > PROTOCOL_MAX_PLAYERS) {
+        log_error("Player count must be between 1 and %d", PROTOCOL_MAX_PLAYERS);
         exit(EXIT_FAILURE);
     }
 
-    memset(client_sockets, 0, player_count * sizeof(int));
-    memset(name_received, 0, player_count * sizeof(int));
-    memset(leaderboard, 0, player_count * sizeof(int));
-    for (int i = 0; i < player_count; i++) {
-        player_names[i] = NULL; // Initialize to NULL
+    // Without -n every game waits for a full room, unless bots can fill it
+    if (min_player_count == 0) {
+        min_player_count = bot_think_ms >= 0 ? 1 : player_count;
+    }
+    if (min_player_count < 0 || min_player_count > player_count || max_queue_wait_ms < 0) {
+        log_error("Minimum players must be between 1 and %d, and the queue wait can't be negative", player_count);
+        exit(EXIT_FAILURE);
+    }
+    log_info("Min players: %d, queue wait: %d ms", min_player_count, max_queue_wait_ms);
+    if (bot_think_ms >= 0) {
+        log_info("Bots fill games short of players, thinking for %d ms on average", bot_think_ms);
     }
 
-    int server_fd;
-    struct sockaddr_in address;
-    socklen_t addr_len = sizeof(address);
+    if (listen_backlog <= 0) {
+        log_error("Listen backlog must be positive");
+        exit(EXIT_FAILURE);
+    }
+    if (admission_rate > 0) {
+        log_info("Admission: %llu connections/s, backlog %d", (unsigned long long)admission_rate, listen_backlog);
+    }
 
-    // Assign goal_word randomly from pool of words
-    random_goal_word();
-    printf("Goal Word: %s\n", goal_word);
+    if (dictionary_load(dictionary_path) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (rankings_load(rankings_path) < 0) {
+        exit(EXIT_FAILURE);
+    }
 
-    // Create the server socket and start listening
-    server_fd = create_server(player_count);
+    // The journal is opened first so the games restored from the snapshot are recorded too
+    if (journal_path != NULL) {
+        // Records hold worker indexes and slots in 16 bits, wider ones would be put down to the wrong player
+        if (worker_count - 1 > JOURNAL_MAX_INDEX || player_count - 1 > JOURNAL_MAX_INDEX) {
+            log_error("The journal takes at most %d workers and %d players per game",
+                      JOURNAL_MAX_INDEX + 1, JOURNAL_MAX_INDEX + 1);
+            exit(EXIT_FAILURE);
+        }
+        if (journal_open(journal_path) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        atexit(journal_close);
+    }
 
-    int connected_players = 0;  // Tracks players who have entered names and fully connected to the game
-    int connections_pending_name_input = 0; // Tracks active sockets that haven't sent their name
+    if (snapshot_path != NULL && snapshot_path[0] != '\0') {
+        if (snapshot_open(snapshot_path, worker_count, player_count, MAX_ROOMS) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        snapshot_enabled = 1;
+    }
 
-    fd_set readfds;
+    // Writes to a client that has gone away fail with EPIPE and drop that client, instead of killing the server
+    signal(SIGPIPE, SIG_IGN);
 
-    // Accept new players and handle their name input until all players have entered their names
-    while (connected_players < player_count) {
-        FD_ZERO(&readfds); // Clear the file descriptor set
-        FD_SET(server_fd, &readfds); // Add server socket to the set
-        int max_sd = server_fd;
+    // SIGHUP is only taken by the main thread, so block it before the workers inherit the signal mask
+    sigset_t reload_signals;
+    sigemptyset(&reload_signals);
+    sigaddset(&reload_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &reload_signals, NULL);
 
-        // Add client sockets to the read set
-        for (int i = 0; i < player_count; i++) {
-            int sd = client_sockets[i];
-            if (sd > 0) FD_SET(sd, &readfds);
-            if (sd > max_sd) max_sd = sd;
+    workers = calloc(worker_count, sizeof(struct worker));
+    if (workers == NULL) {
+        log_error("Memory allocation failed: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int base_seed = (unsigned int)time(NULL); // Ensure randomness
+    for (int i = 0; i < worker_count; i++) {
+        struct worker *worker = &workers[i];
+        worker->index = i;
+        worker->rand_seed = base_seed + i * 7919;
+        room_pool_init(&worker->room_pool, player_count);
+        lobby_init(&worker->lobby);
+        admission_init(&worker->admission, (admission_rate + worker_count - 1) / worker_count, MAX_LOBBY_PLAYERS, metrics_now_us());
+        reactor_timer_init(&worker->lobby_timer, on_lobby_timer, worker);
+        reactor_timer_init(&worker->snapshot_timer, on_snapshot_timer, worker);
+        reactor_timer_init(&worker->inbox_timer, on_inbox_timer, worker);
+        pthread_mutex_init(&worker->inbox_lock, NULL);
+        for (int record = MAX_ROOMS - 1; record >= 0; record--) {
+            worker->snapshot_free[worker->snapshot_free_count++] = record;
+        }
+        if (getrandom(&worker->token_state, sizeof(worker->token_state), 0) != sizeof(worker->token_state)) {
+            worker->token_state = ((uint64_t)base_seed << 32) ^ (uint64_t)i * 0x9e3779b97f4a7c15ULL;
         }
 
-        printf("Waiting for players...\n");
-        printf("Connected players: %d\n\n", connected_players);
+        // Create the server socket and start listening, the kernel spreads connections across listeners
+        worker->server_fd = create_server(listen_backlog, 1);
 
-        // Wait for activity on any socket
-        if (select(max_sd + 1, &readfds, NULL, NULL, NULL) < 0) {
-            perror("Select failed");
+        if (reactor_init(&worker->reactor, backend) < 0) {
+            log_error("Event loop creation failed: %s", strerror(errno));
             exit(EXIT_FAILURE);
         }
 
-        // Accept new players if space is available
-        if (FD_ISSET(server_fd, &readfds)) {
-            if (connections_pending_name_input < player_count) {
-                add_new_player(server_fd, client_sockets, &connections_pending_name_input, &connected_players);
-                printf("Spaces available: %d\n", player_count - connections_pending_name_input);
-            } else {
-                // Reject extra connections
-                int new_socket = accept(server_fd, (struct sockaddr*)&address, &addr_len);
-                if (new_socket < 0) {
-                    perror("Accept failed");
-                    exit(EXIT_FAILURE);
-                }
-        
-                int reject_value = -1;
-                send(new_socket, &reject_value, sizeof(reject_value), 0);
-                close(new_socket);
-                printf("Rejected connection from unknown client as server is full\n");
-            }
+        if (reactor_add_listener(&worker->reactor, worker->server_fd, on_accept, worker) < 0) {
+            log_error("Event loop registration failed: %s", strerror(errno));
+            exit(EXIT_FAILURE);
         }
+    }
 
-        // Handle player name input asynchronously
-        handle_client_name_input(client_sockets, player_names, name_received, &connected_players, &connections_pending_name_input);
+    // Rebuild the games the previous run left in progress, then keep the snapshot up to date
+    if (snapshot_enabled) {
+        journal_write_through(1);
+        restore_rooms();
+        journal_write_through(0);
+        for (int i = 0; i < worker_count; i++) {
+            reactor_timer_arm(&workers[i].reactor, &workers[i].snapshot_timer, SNAPSHOT_INTERVAL_MS);
+        }
+    }
+    for (int i = 0; i < worker_count; i++) {
+        reactor_timer_arm(&workers[i].reactor, &workers[i].inbox_timer, REACTOR_TICK_MS);
     }
 
-    printf("Connected players DEBUG: %d\n", connected_players);
-    // Send ready-up message to all players
-    char ready_message[] = "All players have entered their usernames. Ready up by entering 'r'\n";
-    for (int i = 0; i < player_count; i++) {
-        send(client_sockets[i], ready_message, strlen(ready_message), 0);
+    // Serve every workers metrics on the local admin port
+    if (metrics_port > 0) {
+        struct metrics **metrics_sources = malloc(worker_count * sizeof(struct metrics *));
+        if (metrics_sources == NULL) {
+            log_error("Memory allocation failed: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < worker_count; i++) {
+            metrics_sources[i] = &workers[i].metrics;
+        }
+        if (metrics_start_server(metrics_port, metrics_sources, worker_count) < 0) {
+            log_error("Metrics server failed: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        log_info("Metrics on http://127.0.0.1:%d/metrics", metrics_port);
     }
 
-    // Wait for all players to send 'r'
-    handle_ready_up(server_fd, client_sockets, &readfds, player_names, &connected_players);
+    if (backend != workers[0].reactor.backend) {
+        log_warn("io_uring is not available, falling back to epoll");
+    }
+    log_info("Waiting for players on %d worker thread(s) using %s...", worker_count, reactor_backend_name(&workers[0].reactor));
 
-    // Main Game loop
-    play_hangman(server_fd, client_sockets, &connected_players, goal_word, &readfds, player_names);
+    for (int i = 0; i < worker_count; i++) {
+        int error = pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+        if (error != 0) {
+            log_error("Thread creation failed: %s", strerror(error));
+            exit(EXIT_FAILURE);
+        }
+    }
 
+    // Reload the word list on SIGHUP without a restart, rooms already open keep their word
+    for (;;) {
+        int signal_number;
+        if (sigwait(&reload_signals, &signal_number) != 0) {
+            break;
+        }
+        if (signal_number == SIGHUP) {
+            log_info("Reloading dictionary %s", dictionary_path);
+            dictionary_load(dictionary_path);
+        }
+    }
 
-    char leaderboard_message[] = "All Players have finished! Generating leaderboard...\n";
-    for (int i = 0; i < player_count; i++) {
-        send(client_sockets[i], leaderboard_message, strlen(ready_message), 0);
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i].thread, NULL);
     }
 
-    // Receive final scores in formatted string: "Username:Score"
-    format_and_send_leaderboard(server_fd, client_sockets, &connected_players, leaderboard, goal_word, &readfds, player_names);
+    rankings_close();
+    snapshot_close();
+    dictionary_unload();
+    free(workers);
+    return 0;
+}
+
+// Worker thread: the lobby and every room and phase (name input, ready up, guessing and leaderboard) are driven by socket readiness
+void *run_worker(void *arg) {
+    struct worker *worker = arg;
 
-    // Close all client sockets and free allocated memory
-    for (int i = 0; i < player_count; i++) {
-        if (client_sockets[i] > 0) {
-            close(client_sockets[i]);
-            free(player_names[i]);
-            player_names[i] = NULL;
-        }
+    reactor_run(&worker->reactor);
+
+    // Games cut short by stopping stay in the snapshot, so they can be resumed after a restart
+    write_snapshot(worker);
+    for (struct room *room = worker->running_rooms; room != NULL; room = room->next) {
+        room->snapshot_index = -1;
     }
 
-    // Free allocated memory before exiting
-    free(client_sockets);
-    free(player_names);
-    free(name_received);
-    free(leaderboard);
-    free(goal_word);
-    goal_word = NULL;
+    // Close the inbox, the lobby and all rooms and free allocated memory
+    pthread_mutex_lock(&worker->inbox_lock);
+    worker->inbox_closed = 1;
+    struct connection *handed = worker->inbox;
+    worker->inbox = NULL;
+    pthread_mutex_unlock(&worker->inbox_lock);
+    while (worker->arrived != NULL || handed != NULL) {
+        struct connection *connection = worker->arrived != NULL ? worker->arrived : handed;
+        if (connection == worker->arrived) {
+            worker->arrived = connection->lobby_next;
+        } else {
+            handed = connection->lobby_next;
+        }
+        close(connection->fd);
+        // The worker that sent it still refers to it until handoff_done is set. That is rare, and the
+        // process is exiting, so it is left rather than waited for
+        if (__atomic_load_n(&connection->handoff_done, __ATOMIC_ACQUIRE)) {
+            connection_destroy(connection);
+        }
+    }
+    while (worker->lobby.players != NULL) {
+        struct connection *connection = worker->lobby.players;
+        lobby_leave(&worker->lobby, connection);
+        close_client(&worker->reactor, connection);
+    }
+    while (worker->running_rooms != NULL) {
+        close_room(worker->running_rooms);
+    }
 
-    close(server_fd); // Close the server socket
-    return 0;
+    room_pool_destroy(&worker->room_pool);
+    free(worker->leaderboard_text);
+    reactor_destroy(&worker->reactor);
+    close(worker->server_fd); // Close the server socket
+    return NULL;
 }
 
-// Function to create and configure the server socket
-int create_server(int player_count) {
+// Function to create and configure the server socket, optionally shared between workers with SO_REUSEPORT
+int create_server(int backlog, int reuse_port) {
     int server_fd;
     struct sockaddr_in address;
     int opt = 1; // Enable option
 
     // Create socket
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        perror("Socket failed");
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        log_error("Socket failed: %s", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
     // Set socket option to allow address reuse
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        perror("setsockopt failed");
+        log_error("setsockopt failed: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Let every worker bind its own listener to the same port
+    if (reuse_port && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        log_error("setsockopt failed: %s", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
@@ -184,602 +531,1325 @@ int create_server(int player_count) {
 
     // Bind socket to address and port
     if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("Bind failed");
+        log_error("Bind failed: %s", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
-    // Set up listening queue
-    if (listen(server_fd, player_count) < 0) {
-        perror("Listen failed");
+    // Set up listening queue, deep enough that a burst of connects waits here instead of having its SYNs dropped
+    if (listen(server_fd, backlog) < 0) {
+        log_error("Listen failed: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // The event loop is edge-triggered, so the listener must never block
+    if (set_nonblocking(server_fd) < 0) {
+        log_error("fcntl failed: %s", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
     return server_fd;
 }
 
+// Switch a socket to non-blocking mode
+int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Let each accepted connection into the lobby, unless it is already full
+void on_accept(int new_socket, const struct sockaddr *address, void *arg) {
+    struct worker *worker = arg;
+
+    uint64_t now = metrics_now_us();
 
-// Accept a new player and store their socket
-void add_new_player(int server_fd, int *client_sockets, int *connections_pending_name_input, int *connected_players) {
-    struct sockaddr_in address;
-    socklen_t addr_len = sizeof(address);
-    int join_confirmed_status = 0;
-    int new_socket = accept(server_fd, (struct sockaddr *)&address, &addr_len);
     if (new_socket < 0) {
-        perror("Accept failed");
-        exit(EXIT_FAILURE);
+        // Out of descriptors or memory. The reactor stops accepting for a tick, and the connections still
+        // queued on the listener wait for it instead of taking the worker down
+        admission_count_shed(&worker->admission);
+        metrics_add(&worker->metrics.connections_shed, 1);
+    } else {
+        switch (admission_check(&worker->admission, worker->lobby.player_count, now)) {
+            case ADMIT:
+                metrics_add(&worker->metrics.connections_accepted, 1);
+                add_new_player(worker, new_socket, address);
+                log_debug("Lobby: %d players, %d queued", worker->lobby.player_count, worker->lobby.queued);
+                return;
+            case SHED_LOBBY_FULL:
+                metrics_add(&worker->metrics.connections_rejected, 1);
+                break;
+            case SHED_RATE:
+                metrics_add(&worker->metrics.connections_shed, 1);
+                break;
+        }
+
+        // Reject extra connections with just the status and a close. Under a flood that is thousands a second,
+        // so they are logged as a count once a second
+        reject_incoming_connections(new_socket);
+    }
+    uint64_t shed = admission_take_report(&worker->admission, now);
+    if (shed > 0) {
+        log_warn("Rejected %llu connections as the server is full or busy", (unsigned long long)shed);
     }
+}
 
-    printf("New connection, socket fd: %d, ip: %s, port: %d\n",
-           new_socket, inet_ntoa(address.sin_addr), ntohs(address.sin_port));
+// Route readiness on a client socket to the lobby, or to the handler of its rooms current phase.
+// Anything that changes the queue may let a game start, so the worker matchmakes after every event
+void on_client_event(int sd, uint32_t events, void *arg) {
+    (void)sd;
+    struct connection *connection = arg;
+    struct room *room = connection->room;
+    struct worker *worker = connection->worker;
+
+    int i = -1;
+    if (connection->phase != PHASE_SPECTATING && room != NULL && (i = room_find_player(room, connection->player)) < 0) {
+        return; // Stale event for a player that has already left
+    }
 
-    send(new_socket, &join_confirmed_status, sizeof(join_confirmed_status), 0);
+    // The socket has room again, write whatever was left queued
+    if (events & EPOLLOUT) {
+        connection_schedule_flush(connection);
+    }
 
-    // Store the client socket
-    for (int i = 0; i < player_count; i++) {
-        if (client_sockets[i] == 0) { // Find empty slot
-            client_sockets[i] = new_socket;
-            (*connections_pending_name_input)++; // Increment immediately when a socket is accepted
-            break;
+    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        connection->peer_closed = 1;
+    }
+
+    // Every guess handled in this event is timed from here until its response has been written
+    uint64_t started = metrics_now_us();
+    uint64_t guesses = worker->metrics.guesses;
+
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        if (connection->phase == PHASE_SPECTATING) {
+            service_spectator(connection);
+        } else if (room != NULL) {
+            service_player(room, i);
+            advance_game_phase(room);
+        } else {
+            service_lobby_player(connection);
         }
+        matchmake(worker);
+    }
+
+    flush_connections(worker);
+
+    if (worker->metrics.guesses != guesses) {
+        histogram_record(&worker->metrics.guess_latency, metrics_now_us() - started, worker->metrics.guesses - guesses);
     }
 }
 
-// Reject incoming connections whilst game is in progress
-int reject_incoming_connections(int server_fd, fd_set *readfds) {
-    if (FD_ISSET(server_fd, readfds)) {
-        struct sockaddr_in address;
-        socklen_t addr_len = sizeof(address);
-        int new_socket = accept(server_fd, (struct sockaddr*)&address, &addr_len);
-        if (new_socket < 0) {
-            perror("Accept failed");
-            exit(EXIT_FAILURE);
+// Read everything available on a players socket and hand each complete frame to the current phase.
+// A burst of coalesced messages is framed in one pass instead of one recv() per message
+void service_player(struct room *room, int i) {
+    struct connection *connection = room->connections[i];
+
+    for (;;) {
+        unsigned int filled = connection->input.tail;
+        enum input_status status = input_buffer_fill(&connection->input, connection->reactor, connection->fd, connection->peer_closed);
+        metrics_add(&room->worker->metrics.bytes_in, connection->input.tail - filled);
+
+        status = handle_player_input(room, i, status);
+        if (status != INPUT_FULL) {
+            return; // Drained, or the player has left the room
         }
 
-        int reject_value = -1;
-        send(new_socket, &reject_value, sizeof(reject_value), 0);
-        close(new_socket);
+        // Frames meant for a later phase are still buffered, the rest stays in the socket until that phase starts
+        if (input_buffer_used(&connection->input) == INPUT_BUFFER_SIZE) {
+            return;
+        }
     }
-    return 0;
 }
 
-// Handle client input asynchronously (players can enter names independently)
-void handle_client_name_input(int *client_sockets, char **player_names, int *name_received, int *connected_players, int *connections_pending_name_input) {
-    char name_buffer[50];
+// Same as service_player(), for a player waiting in the lobby
+void service_lobby_player(struct connection *connection) {
+    for (;;) {
+        unsigned int filled = connection->input.tail;
+        enum input_status status = input_buffer_fill(&connection->input, connection->reactor, connection->fd, connection->peer_closed);
+        metrics_add(&connection->worker->metrics.bytes_in, connection->input.tail - filled);
 
-    for (int i = 0; i < max_player_count; i++) {
-        int sd = client_sockets[i];
+        status = handle_lobby_input(connection, status);
+        if (status != INPUT_FULL) {
+            return;
+        }
 
-        if (sd > 0) {
-            memset(name_buffer, 0, sizeof(name_buffer));
-            
-            // Use recv() with MSG_DONTWAIT to avoid blocking
-            int valread = recv(sd, name_buffer, sizeof(name_buffer), MSG_DONTWAIT);
-            
-            if (valread == 0) {  // Client has disconnected
-                printf("Player %d (Socket %d) disconnected.\n", i + 1, sd);
-                close(sd);
+        // Input pipelined for the game stays buffered until the player is placed in one
+        if (input_buffer_used(&connection->input) == INPUT_BUFFER_SIZE) {
+            return;
+        }
+    }
+}
 
-                // Free memory and reset slot
-                free(player_names[i]);
-                player_names[i] = NULL;
-                client_sockets[i] = 0;
+// Pass framed input to the handler of the rooms current phase.
+// Returns INPUT_CLOSED if the player was disconnected or has left the room, otherwise status unchanged
+enum input_status handle_player_input(struct room *room, int i, enum input_status status) {
+    switch (room->phase) {
+        case PHASE_PLAYING:
+            return play_hangman(room, i, status);
+        case PHASE_LEADERBOARD:
+            return handle_leaderboard_input(room, i, status);
+        default:
+            break; // Lobby phases are handled by handle_lobby_input()
+    }
+    return status;
+}
 
-                // Adjust tracking variables based on whether they had entered a name
-                if (name_received[i] == 1) {
-                    (*connected_players)--; 
-                };
+// Take a lobby player through name entry and ready up, into the queue.
+// Returns INPUT_CLOSED if the player was disconnected, otherwise status unchanged
+enum input_status handle_lobby_input(struct connection *connection, enum input_status status) {
+    struct worker *worker = connection->worker;
+    char name_buffer[PLAYER_NAME_SIZE];
+    uint64_t request;
+    int framed = 0;
+    enum name_claim claim;
+
+    if (connection->phase == PHASE_NAME_INPUT) {
+        framed = protocol_next_name(connection, name_buffer, sizeof(name_buffer), &request);
+        if (framed == 2 || framed == 3) {
+            int moved = framed == 2 ? resume_player(connection, request) : spectate_room(connection, (int)request);
+            if (moved == 0) {
+                return INPUT_CLOSED; // In a room, or on the way to the worker that has it
+            }
+            framed = 0; // The client can send a username instead
+        } else if (framed > 0 && bot_name_reserved(name_buffer)) {
+            log_debug("Lobby: Socket %d asked for %s, which is kept for bots", connection->fd, name_buffer);
+            protocol_send_name_taken(connection);
+            framed = 0; // The client can send another username
+        } else if (framed > 0 && (claim = names_claim(name_buffer, 0, &connection->name)) == NAME_TAKEN) {
+            log_debug("Lobby: Socket %d asked for %s, which is taken", connection->fd, name_buffer);
+            protocol_send_name_taken(connection);
+            framed = 0; // The client can send another username
+        } else if (framed > 0 && claim == NAME_NO_MEMORY) {
+            log_error("Lobby: out of memory registering a name for Socket %d, disconnecting", connection->fd);
+            framed = -1;
+        } else if (framed > 0) {
+            log_debug("Lobby: Socket %d registered as: %s", connection->fd, connection->name);
+            connection->phase = PHASE_READY_UP;
+            record_lobby_phase(connection, &worker->metrics.name_phase);
+            journal_name(worker->index, connection->serial, connection->name);
+            protocol_send_ready_prompt(connection);
+            reactor_timer_arm(&worker->reactor, &connection->deadline, READY_TIMEOUT_MS);
+        }
+    }
 
-                (*connections_pending_name_input)--;
-                name_received[i] = 0;
+    // Anything after the ready up, such as pipelined guesses, is left buffered for the game
+    if (framed >= 0 && connection->phase == PHASE_READY_UP) {
+        framed = protocol_next_ready(connection);
+        if (framed > 0) {
+            log_debug("Lobby: %s is ready!", connection->name);
+            connection->phase = PHASE_QUEUED;
+            record_lobby_phase(connection, &worker->metrics.ready_phase);
+            journal_ready(worker->index, connection->serial);
+            reactor_timer_cancel(&worker->reactor, &connection->deadline);
+            lobby_enqueue(&worker->lobby, connection, connection->phase_started);
+        }
+    }
 
-                // player_count--;
+    if (status == INPUT_CLOSED || framed < 0) {  // Client has disconnected or broke the protocol
+        log_info("Lobby: Socket %d disconnected.", connection->fd);
+        remove_lobby_player(connection);
+        return INPUT_CLOSED;
+    }
+    return status;
+}
 
-                // **Shift remaining players down**
-                for (int j = i; j < max_player_count - 1; j++) {
-                    client_sockets[j] = client_sockets[j + 1];
-                    player_names[j] = player_names[j + 1];
-                    name_received[j] = name_received[j + 1];
-                }
+// Hand input that arrived early (pipelined behind the previous phase) to a newly started phase
+void service_room(struct room *room) {
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->connections[i] != NULL) {
+            service_player(room, i);
+        }
+    }
+}
 
-                // Clear the last slot
-                client_sockets[max_player_count - 1] = 0;
-                player_names[max_player_count - 1] = NULL;
-                name_received[max_player_count - 1] = 0;
-
-                i--;  // Adjust loop index after shifting
-            } 
-            else if (valread > 0 && !name_received[i]) {  // **New name received**
-                name_buffer[strcspn(name_buffer, "\n")] = 0;  // Remove newline
-                player_names[i] = strdup(name_buffer);
-                printf("Player %d registered as: %s\n", i + 1, player_names[i]);
-                name_received[i] = 1;
-                (*connected_players)++;
-            }
+// Start a game for every group the queue can make, then keep the lobby timer on the moment the
+// longest queued player will have waited long enough for a smaller game
+void matchmake(struct worker *worker) {
+    uint64_t now = metrics_now_us();
+    uint64_t max_wait = (uint64_t)max_queue_wait_ms * 1000;
+    int players;
+
+    while (worker->room_count < MAX_ROOMS &&
+           (players = lobby_match_size(&worker->lobby, now, min_player_count, player_count, max_wait)) > 0) {
+        if (open_game(worker, players) < 0) {
+            // Try again once the queue wait has passed rather than on every event
+            reactor_timer_arm(&worker->reactor, &worker->lobby_timer, max_queue_wait_ms);
+            return;
         }
     }
+
+    // With every room in use the queue waits for one to close, the next event after that matchmakes again
+    uint64_t next = lobby_next_match(&worker->lobby, min_player_count, max_wait);
+    if (next == 0 || worker->room_count >= MAX_ROOMS) {
+        reactor_timer_cancel(&worker->reactor, &worker->lobby_timer);
+    } else {
+        reactor_timer_arm(&worker->reactor, &worker->lobby_timer, next > now ? (int)((next - now + 999) / 1000) : 0);
+    }
 }
 
+// The longest queued player may have waited long enough to start a smaller game
+void on_lobby_timer(void *arg) {
+    struct worker *worker = arg;
 
-// Handle clients readying up, and adjusts if they disconnect during this process
-void handle_ready_up(int server_fd, int *client_sockets, fd_set *readfds, char **player_names, int *connected_players) {
-    int ready_players = 0; // Tracks how many players have sent 'r'
-    int *player_ready_check = malloc(player_count * sizeof(int));
-    memset(player_ready_check, 0, player_count * sizeof(int)); // Initialize to 0
-    // int player_ready_check[player_count] = {0}; // Track which players are readyed up 
-    char buffer[10];
+    matchmake(worker);
+    flush_connections(worker);
+}
 
-    printf("Waiting for all players to ready up...\n");
+// Open a room for the first players in the queue and start their game straight away.
+// Returns 0, or -1 if no room could be opened
+int open_game(struct worker *worker, int players) {
+    // Assign goal_word randomly from the dictionary
+    char goal_word[MAX_WORD_LENGTH + 1];
+    if (random_goal_word(goal_word, &worker->rand_seed) < 0) {
+        log_error("No goal word available");
+        return -1;
+    }
 
-    while (ready_players < *connected_players) {  // Dynamically wait for current players
-        FD_ZERO(readfds);
-        FD_SET(server_fd, readfds);
-        int max_sd = server_fd;
+    // Room ids are interleaved across workers so they stay unique without sharing a counter
+    int room_id = worker->next_room_id * worker_count + worker->index + 1;
+    struct room *room = room_create(&worker->room_pool, room_id, goal_word);
+    if (room == NULL) {
+        log_error("Memory allocation failed: %s", strerror(errno));
+        return -1;
+    }
 
-        for (int i = 0; i < *connected_players; i++) {  // Loop only through active players
-            if (client_sockets[i] > 0) {
-                FD_SET(client_sockets[i], readfds);
-                if (client_sockets[i] > max_sd) {
-                    max_sd = client_sockets[i];
-                }
+    room->worker = worker;
+    room->publish_list = &worker->publish_list;
+    metrics_add(&worker->metrics.rooms_opened, 1);
+    worker->next_room_id++;
+    worker->room_count++;
+    room_list_add(&worker->running_rooms, room);
+    log_info("Room %d opened for %d players. Goal Word: %s", room->id, players, room->goal_word);
+    // Bots take the seats no human was queued for, and count towards the players the journal expects to finish
+    int seats = bot_think_ms >= 0 ? player_count : players;
+    journal_game_start(worker->index, room->id, room->goal_word, seats, MAX_GUESSES);
+
+    uint64_t now = metrics_now_us();
+    for (int n = 0; n < players; n++) {
+        struct connection *connection = lobby_take(&worker->lobby);
+        histogram_record(&worker->metrics.queue_wait, now - connection->queued_at, 1);
+        join_room(room, connection);
+    }
+    if (bot_think_ms >= 0) {
+        add_bots(room, seats - players);
+    }
+
+    start_game(room);
+    service_room(room);
+    advance_game_phase(room);
+    return 0;
+}
+
+// Seat a player taken from the queue in a free slot of room
+void join_room(struct room *room, struct connection *connection) {
+    int i = room_alloc_slot(room);
+
+    connection->room = room;
+    connection->player = room_player_id(room, i);
+    connection->phase = PHASE_PLAYING;
+    room->connections[i] = connection;
+    room->client_sockets[i] = connection->fd;
+    room->player_names[i] = connection->name;
+    room->tokens[i] = next_resume_token(room->worker);
+    room->connected_players++;
+    journal_join(room->worker->index, room->id, i, connection->serial, connection->name);
+    log_debug("Room %d: Player %d is %s (Socket %d)", room->id, i + 1, room->player_names[i], connection->fd);
+}
+
+// Send a player who has finished and asked to requeue straight back into the queue, instead of waiting for
+// the rest of the room. Their score stays on the rooms leaderboard, and they get their overall ranking now
+void requeue_player(struct room *room, int i) {
+    struct connection *connection = room->connections[i];
+    struct worker *worker = room->worker;
+
+    send_ranking(room, i);
+    log_debug("Room %d: Player %d - %s requeued.", room->id, i + 1, room->player_names[i]);
+
+    room->result_entries[i] = NULL; // Keeps the score in the results when the slot is freed
+    room->connected_players--;
+    room->finished_players--;
+    room_free_slot(room, i);
+    protocol_publish_left(room, i);
+    room->snapshot_dirty = 1;
+
+    // As in remove_player(), bots don't play on by themselves once the last human has gone
+    if (room->bot_count > 0 && room->connected_players == room->bot_count) {
+        remove_bots(room);
+    }
+
+    connection->room = NULL;
+    connection->player = 0;
+    connection->requeue = 0;
+    connection->phase = PHASE_QUEUED;
+    connection->phase_started = metrics_now_us();
+    lobby_enter(&worker->lobby, connection);
+    lobby_enqueue(&worker->lobby, connection, connection->phase_started);
+}
+
+// Write everything queued while handling an event. Each connection gets one writev() for all of its
+// messages, and whatever the socket won't take stays queued until EPOLLOUT. Clients whose socket
+// failed, or that have fallen OUTPUT_HIGH_WATER bytes behind, are disconnected so they can't hold up the room
+void flush_connections(struct worker *worker) {
+    spectators_publish_all(&worker->publish_list);
+
+    while (worker->flush_list != NULL) {
+        struct connection *connection = worker->flush_list;
+        size_t pending = connection->output.pending;
+        enum output_status status = connection_flush(connection);
+        metrics_add(&worker->metrics.bytes_out, pending - connection->output.pending);
+
+        if (status == OUTPUT_ERROR || connection->output.pending > OUTPUT_HIGH_WATER) {
+            struct room *room = connection->room;
+            int i = -1;
+            if (connection->phase != PHASE_SPECTATING && room != NULL && (i = room_find_player(room, connection->player)) < 0) {
+                continue;
+            }
+
+            if (status != OUTPUT_ERROR) {
+                metrics_add(&worker->metrics.slow_consumers, 1);
+            }
+
+            const char *reason = status == OUTPUT_ERROR ? "could not be written to" : "is not reading its messages";
+            if (connection->phase == PHASE_SPECTATING) {
+                log_warn("Spectator: Socket %d %s, disconnecting.", connection->fd, reason);
+                remove_spectator(connection);
+            } else if (room == NULL) {
+                log_warn("Lobby: Socket %d %s, disconnecting.", connection->fd, reason);
+                remove_lobby_player(connection);
+            } else {
+                log_warn("Room %d: Player %d (Socket %d) %s, disconnecting.", room->id, i + 1, connection->fd, reason);
+                remove_player(room, i);
+                advance_game_phase(room);
             }
         }
+    }
+}
 
-        if (select(max_sd + 1, readfds, NULL, NULL, NULL) < 0) {
-            perror("Select failed");
-            exit(EXIT_FAILURE);
+// (Re)start the deadline of a player, see the *_TIMEOUT_MS constants
+void arm_deadline(struct room *room, int i, int timeout_ms) {
+    reactor_timer_arm(&room->worker->reactor, &room->connections[i]->deadline, timeout_ms);
+}
+
+// Add how long the phase that just ended took to histogram, and start timing the next one
+void record_phase_duration(struct room *room, struct histogram *histogram) {
+    uint64_t now = metrics_now_us();
+    histogram_record(histogram, now - room->phase_started, 1);
+    room->phase_started = now;
+}
+
+// Add how long a lobby player took over the phase they just finished to histogram, and start timing the next one
+void record_lobby_phase(struct connection *connection, struct histogram *histogram) {
+    uint64_t now = metrics_now_us();
+    histogram_record(histogram, now - connection->phase_started, 1);
+    connection->phase_started = now;
+}
+
+// A player missed their deadline for the current phase: drop them so the rest of the room can carry on
+void on_player_timeout(void *arg) {
+    struct connection *connection = arg;
+    struct room *room = connection->room;
+    struct worker *worker = connection->worker;
+
+    if (connection->phase == PHASE_SPECTATING) {
+        log_debug("Spectator: Socket %d did not hang up, disconnecting.", connection->fd);
+        remove_spectator(connection);
+    } else if (room == NULL) {
+        log_warn("Lobby: Socket %d timed out, disconnecting.", connection->fd);
+        metrics_add(&worker->metrics.timeouts, 1);
+        remove_lobby_player(connection);
+    } else {
+        int i = room_find_player(room, connection->player);
+        if (i < 0) {
+            return;
         }
 
-        // Reject new connection requests
-        if (reject_incoming_connections(server_fd, readfds) < 0) {
-            perror("New Rejection Request Error");
-            exit(EXIT_FAILURE);
-        } 
-
-        for (int i = 0; i < *connected_players; i++) {  // Iterate through active players
-            int sd = client_sockets[i];
-
-            if (FD_ISSET(sd, readfds)) {
-                memset(buffer, 0, sizeof(buffer));
-                int valread = recv(sd, buffer, sizeof(buffer), 0);
-
-                if (valread > 0) {  // Player sent input
-                    if (buffer[0] == 'r') {
-                        player_ready_check[i] = 1;  // Mark this player as ready
-                        printf("Player %d - %s is ready!\n", i + 1, player_names[i]);
-                        ready_players++;
-                    }
-                } else if (valread == 0) {  // Player disconnected before readying up
-                    printf("Player %d (Socket %d) disconnected.\n", 
-                        i + 1, sd);
-                    printf("Player numbers above Player %d will move down (Player %d is now Player %d etc)\n",
-                        i + 1, i + 2, i + 1);
-                    
-                    client_sockets[i] = 0;  // Free the slot
-
-                    // Shift all players down to fill the gap
-                    for (int j = i; j < *connected_players - 1; j++) {
-                        client_sockets[j] = client_sockets[j + 1];
-                        player_names[j] = player_names[j + 1];
-                    }
-
-                    // Clear the last slot
-                    client_sockets[*connected_players - 1] = 0;
-                    player_names[*connected_players - 1] = NULL;
-
-                    // Reduce total connected players count
-                    (*connected_players)--;
-
-                    // Adjust ready_players count **ONLY IF** the disconnected player was already ready
-                    if (ready_players > 0 && player_ready_check[i] == 1) {
-                        player_ready_check[i] = 0;
-                        ready_players--;
-                    }
-
-                    // Since a player left, we must update the loop bounds correctly
-                    i--;
-
-                    close(sd);
-                }
-            }
+        log_warn("Room %d: Player %d (Socket %d) timed out, disconnecting.", room->id, i + 1, connection->fd);
+        metrics_add(&worker->metrics.timeouts, 1);
+        remove_player(room, i);
+        advance_game_phase(room);
+    }
+    matchmake(worker);
+    flush_connections(worker);
+}
+
+// Unregister a client socket from the event loop, close it and free its connection state.
+// Output still queued (such as the leaderboard) gets one last non-blocking write first
+void close_client(struct reactor *reactor, struct connection *connection) {
+    size_t pending = connection->output.pending;
+
+    reactor_timer_cancel(reactor, &connection->deadline);
+    output_queue_flush(&connection->output, reactor, connection->fd);
+    metrics_add(&connection->worker->metrics.bytes_out, pending - connection->output.pending);
+    reactor_close(reactor, connection->fd);
+    connection_destroy(connection);
+}
+
+// Close every socket still in a room and free it
+void close_room(struct room *room) {
+    release_spectators(room);
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->connections[i] != NULL) {
+            close_client(&room->worker->reactor, room->connections[i]);
+            room->connections[i] = NULL;
+            room->client_sockets[i] = 0;
         }
     }
 
-    printf("All players are ready! Starting the game...\n");
+    remove_bots(room);
+
+    room_list_remove(&room->worker->running_rooms, room);
+    release_snapshot_record(room);
+
+    log_info("Room %d closed", room->id);
+    room->worker->room_count--;
+    room_destroy(room);
 }
 
+// Accept a new player into the lobby and wait for their username
+void add_new_player(struct worker *worker, int new_socket, const struct sockaddr *address) {
+    // The io_uring backend doesn't report the peer, look it up only when it is going to be logged
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    if (address != NULL) {
+        memcpy(&peer, address, sizeof(peer));
+    } else if (log_level <= LOG_DEBUG) {
+        socklen_t peer_length = sizeof(peer);
+        getpeername(new_socket, (struct sockaddr *)&peer, &peer_length);
+    }
+    log_debug("Lobby: new connection, socket fd: %d, ip: %s, port: %d",
+           new_socket, inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+
+    protocol_send_join_status(new_socket, 0);
 
-// Core Hangman Loop
-void play_hangman(int server_fd, int *client_sockets, int *connected_players, char *goal_word, fd_set *readfds, char **player_names) {
-    int word_length = strlen(goal_word);
-    int guesses_left[*connected_players]; // Stores remaining guesses for each player (associated by index position)
-    int server_arr[*connected_players][word_length]; // Nested tracking arrays for each clients progress when guessing the word
-    int game_finished[*connected_players]; // Tracks whether a player has finished
-    int finished_players  = 0;
+    struct connection *connection = connection_create(new_socket, &worker->reactor, worker, &worker->flush_list);
+    if (connection == NULL) {
+        log_error("Memory allocation failed: %s", strerror(errno));
+        close(new_socket);
+        return;
+    }
 
-    // Send the length of the goal word to all clients
-    for (int i = 0; i < *connected_players; i++){
-        send(client_sockets[i], &word_length, sizeof(word_length), 0);
-        printf("Word length: %d sent to Player: %d\n", word_length, i + 1);
+    if (reactor_add(&worker->reactor, new_socket, EPOLLIN | EPOLLOUT | EPOLLRDHUP, on_client_event, connection) < 0) {
+        log_error("Event loop registration failed: %s", strerror(errno));
+        close(new_socket);
+        connection_destroy(connection);
+        return;
+    }
+    connection->phase_started = metrics_now_us();
+    connection->serial = worker->next_connection++ * (uint32_t)worker_count + worker->index + 1;
+    journal_accept(worker->index, connection->serial);
+    lobby_enter(&worker->lobby, connection);
+
+    reactor_timer_init(&connection->deadline, on_player_timeout, connection);
+    reactor_timer_arm(&worker->reactor, &connection->deadline, NAME_TIMEOUT_MS);
+}
+
+// Reject incoming connections whilst the lobby is full
+int reject_incoming_connections(int new_socket) {
+    protocol_send_join_status(new_socket, -1);
+    close(new_socket);
+    return 0;
+}
+
+// Drop a disconnected player from every phase counter they were part of, close their socket and
+// free their slot. Every other player keeps their slot, so this costs the same however full the room is
+void remove_player(struct room *room, int i) {
+    metrics_add(&room->worker->metrics.disconnects[room->phase], 1);
+    room->connected_players--;
+    if (room->game_finished[i]) {
+        room->finished_players--;
+    }
+
+    close_client(&room->worker->reactor, room->connections[i]);
+    room_free_slot(room, i);
+    room->snapshot_dirty = 1;
+    protocol_publish_left(room, i);
+
+    // Bots don't play on by themselves once every human has left
+    if (room->bot_count > 0 && room->connected_players == room->bot_count) {
+        remove_bots(room);
+    }
+}
+
+// Drop a disconnected player from the lobby, and from the queue if they were waiting in it, and close their socket
+void remove_lobby_player(struct connection *connection) {
+    struct worker *worker = connection->worker;
+
+    metrics_add(&worker->metrics.disconnects[connection->phase], 1);
+    lobby_leave(&worker->lobby, connection);
+    close_client(&worker->reactor, connection);
+}
+
+// Send the length of the goal word to all clients and start guessing
+void start_game(struct room *room) {
+    int word_length = room->game_word.length;
+
+    log_debug("Room %d: starting the game...", room->id);
+
+    for (int i = 0; i < room->player_count; i++){
+        if (room->connections[i] != NULL) {
+            protocol_send_game_start(room->connections[i], word_length, MAX_GUESSES);
+            protocol_send_resume_token(room->connections[i], room->tokens[i]);
+            arm_deadline(room, i, GUESS_TIMEOUT_MS);
+            log_debug("Room %d: word length: %d sent to Player: %d", room->id, word_length, i + 1);
+        } else if (room->bots[i] != NULL) {
+            reactor_timer_arm(&room->worker->reactor, &room->bots[i]->think_timer, bot_think_delay(room->worker));
+        }
     }
 
     // Initialize guess tracking arrays and remaining guesses for each player
-    for (int i = 0; i < *connected_players; i++) {
-        guesses_left[i] = MAX_GUESSES; // Start each player with max guesses
-        memset(server_arr[i], 0, word_length * sizeof(int)); // Initalize server guess tracking arrays
-        game_finished[i] = 0; // 0 means player has NOT finished
+    for (int i = 0; i < room->player_count; i++) {
+        room->guesses_left[i] = MAX_GUESSES; // Start each player with max guesses
+        room->progress[i] = 0; // No letters revealed yet
+        room->game_finished[i] = 0; // 0 means player has NOT finished
     }
 
-    printf("Game started!\n");
+    room->phase = PHASE_PLAYING;
+    room->phase_started = metrics_now_us();
+    take_snapshot_record(room);
+    log_info("Room %d: game started!", room->id);
+}
 
+// Core Hangman Loop, processes every buffered guess of a single player
+enum input_status play_hangman(struct room *room, int i, enum input_status status) {
+    struct connection *connection = room->connections[i];
     char guess;
+    int framed = 0;
 
-    while (finished_players < *connected_players) { // Keep looping until all players have finished
-        FD_ZERO(readfds);
-        FD_SET(server_fd, readfds);
-        int max_sd = server_fd;
-        int active_players = 0;
-
-        for (int i = 0; i < *connected_players; i++) {  // Loop only through active players
-            if (client_sockets[i] > 0) {
-                FD_SET(client_sockets[i], readfds);
-                if (client_sockets[i] > max_sd) {
-                    max_sd = client_sockets[i];
-                }
-                active_players++;
-            }
+    // Every buffered guess is handled in one pass
+    while (!room->game_finished[i] && (framed = protocol_next_guess(connection, &guess)) > 0) {
+        // Handle player guess
+        guess = toupper(guess); // Convert input to upper case
+
+        // Ensure it's a valid alphabetical letter (A-Z only)
+        if (guess < 'A' || guess > 'Z') {
+            log_warn("Room %d: invalid input received from Player %d: %c (ASCII: %d)", room->id, i + 1, guess, guess);
+            continue; // Ignore anything that isn't a valid letter
         }
 
-        // if (active_players == 0) {
-        //     printf("All players have finished the game. Exiting...\n");
-        //     break;
-        // }
+        metrics_add(&room->worker->metrics.guesses, 1);
+        arm_deadline(room, i, GUESS_TIMEOUT_MS);
+        apply_guess(room, i, guess);
+    }
 
-        if (select(max_sd + 1, readfds, NULL, NULL, NULL) < 0) {
-            perror("Select failed");
-            exit(EXIT_FAILURE);
+    // Anything sent after finishing is ignored, apart from a request to requeue
+    if (room->game_finished[i] && framed >= 0) {
+        framed = protocol_discard_input(connection);
+    }
+
+    // Handle player disconnections
+    if (status == INPUT_CLOSED || framed < 0) {
+        log_info("Room %d: Player %d (Socket %d) disconnected during the game.",
+            room->id, i + 1, connection->fd);
+        remove_player(room, i);
+        return INPUT_CLOSED;
+    }
+
+    if (room->game_finished[i] && connection->requeue) {
+        requeue_player(room, i);
+        return INPUT_CLOSED;
+    }
+    return status;
+}
+
+// Play a valid guess for slot i, human or bot: reveal it, send and publish it, and score the player if it
+// finishes them. Returns the positions the guess revealed
+uint64_t apply_guess(struct room *room, int i, char guess) {
+    room->snapshot_dirty = 1;
+
+    // Look up every position of the guessed letter and reveal them in the players progress
+    uint64_t revealed = evaluate_guess(&room->game_word, &room->progress[i], guess);
+    int correct_guess = revealed != 0;
+
+    // If guess if incorrect, lose a life
+    if (!correct_guess) {
+        room->guesses_left[i]--; // Decrement remaining guesses
+    }
+    log_debug("Room %d: Player %d: guessed %c, %s, revealed mask %#llx, remaining guesses: %d", room->id, i + 1,
+              guess, correct_guess ? "correct" : "incorrect", (unsigned long long)revealed, room->guesses_left[i]);
+
+    // Send the positions revealed by the guess to the client
+    if (room->connections[i] != NULL) {
+        protocol_send_reveal(room->connections[i], revealed, room->game_word.length, guess, room->guesses_left[i]);
+    }
+    protocol_publish_guess(room, i, revealed, guess, room->guesses_left[i]);
+    journal_guess(room->worker->index, room->id, i, guess, correct_guess, room->guesses_left[i], revealed);
+
+    // Check if the player has finished (either guessed the word in full, or out of guesses)
+    if (is_word_guessed(&room->game_word, room->progress[i])) {
+        log_debug("Room %d: Player %d: has guessed the word!", room->id, i + 1);
+        room->game_finished[i] = 1;
+        room->finished_players++;
+        record_final_score(room, i);
+    }
+
+    if (room->guesses_left[i] == 0 && !room->game_finished[i]) {
+        log_debug("Room %d: Player %d is out of guesses", room->id, i + 1);
+        room->game_finished[i] = 1;
+        room->finished_players++;
+        record_final_score(room, i);
+    }
+    return revealed;
+}
+
+// Score a player who has just finished: the guesses they had left if they found the word, otherwise 0.
+// The score goes straight into the rooms results, so the leaderboard is ready as soon as the last player finishes
+void record_final_score(struct room *room, int i) {
+    int solved = is_word_guessed(&room->game_word, room->progress[i]);
+    int score = solved ? room->guesses_left[i] : 0;
+
+    room->leaderboard[i] = score;
+    room->result_entries[i] = leaderboard_insert(&room->results, room->player_names[i], score);
+    if (room->connections[i] != NULL) {
+        reactor_timer_cancel(&room->worker->reactor, &room->connections[i]->deadline);
+        protocol_send_result(room->connections[i], score, solved);
+    }
+    protocol_publish_finished(room, i, score, solved);
+    journal_finish(room->worker->index, room->id, i, solved, score);
+    log_debug("Room %d: Player %d: final score: %d", room->id, i + 1, score);
+}
+
+// Tell all players the game is over and send them the leaderboard straight away. Each socket is
+// half-closed once its output is written, and the room closes when every client has hung up
+void start_leaderboard(struct room *room) {
+    log_debug("Room %d: all players have finished the game.", room->id);
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->connections[i] != NULL) {
+            protocol_send_game_over(room->connections[i]);
+        }
+    }
+    protocol_publish_game_over(room);
+
+    room->phase = PHASE_LEADERBOARD;
+    release_snapshot_record(room);
+    record_phase_duration(room, &room->worker->metrics.game_phase);
+    metrics_add(&room->worker->metrics.games_completed, 1);
+    send_leaderboard(room);
+    release_spectators(room);
+    remove_bots(room); // Their scores have been sent, and they have no socket to wait on
+
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->connections[i] != NULL) {
+            connection_shutdown_after_flush(room->connections[i]);
+            arm_deadline(room, i, LINGER_TIMEOUT_MS);
+        }
+    }
+    log_debug("Room %d: waiting for players to disconnect...", room->id);
+}
+
+// Discard anything sent after the game, such as the score legacy clients still send, until the client hangs up.
+// Closing while that score is in flight would reset the connection and could lose the leaderboard
+enum input_status handle_leaderboard_input(struct room *room, int i, enum input_status status) {
+    struct connection *connection = room->connections[i];
+
+    input_buffer_skip(&connection->input, input_buffer_used(&connection->input));
+
+    if (status == INPUT_CLOSED) {
+        log_info("Room %d: Player %d (Socket %d) disconnected.", room->id, i + 1, connection->fd);
+        remove_player(room, i);
+        return INPUT_CLOSED;
+    }
+    return status;
+}
+
+// Send the ranked leaderboard to every player in the room, then add the game to everyone's overall totals
+void send_leaderboard(struct room *room) {
+    struct worker *worker = room->worker;
+
+    // Players who left have already been taken out of the results, so only connected players are listed
+    int length = leaderboard_format(&room->results, 0, &worker->leaderboard_text, &worker->leaderboard_text_capacity);
+    if (length < 0) {
+        log_error("Memory allocation failed: %s", strerror(errno));
+        return;
+    }
+
+    // Send the entire leaderboard to all active clients
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->connections[i] != NULL) { // Ensure the client is still connected
+            protocol_send_leaderboard(room->connections[i], worker->leaderboard_text, length);
+        }
+    }
+    protocol_publish_leaderboard(room, worker->leaderboard_text, length);
+
+    // Debug: Print the leaderboard for server reference
+    log_info("Room %d: final leaderboard: %s", room->id, worker->leaderboard_text);
+
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->connections[i] != NULL && room->result_entries[i] != NULL) {
+            send_ranking(room, i);
+        }
+    }
+
+    if (rankings_format_top(TOP_RANKINGS, &worker->leaderboard_text, &worker->leaderboard_text_capacity) >= 0) {
+        log_info("Room %d: overall leaders: %s", room->id, worker->leaderboard_text);
+    }
+}
+
+// Add a finished players score to their totals across every game, and send them where that puts them
+void send_ranking(struct room *room, int i) {
+    struct ranking ranking;
+    rankings_record(room->player_names[i], room->leaderboard[i], &ranking);
+    protocol_send_ranking(room->connections[i], ranking.rank, ranking.total_score, ranking.games, ranking.ranked_players);
+}
+
+// Move a room on to its next phase once every player has completed the current one.
+// Input pipelined behind the previous phase is handed to the new phase straight away
+void advance_game_phase(struct room *room) {
+    for (;;) {
+        if (room->phase == PHASE_PLAYING && room->finished_players >= room->connected_players) {
+            start_leaderboard(room);
+            service_room(room);
+        } else if (room->phase == PHASE_LEADERBOARD && room->connected_players == 0) {
+            log_debug("Room %d: all players have disconnected.", room->id);
+            close_room(room);
+            return;
+        } else {
+            return;
+        }
+    }
+}
+
+// Resume tokens are splitmix64 over a per worker seed from the kernel, and never 0
+uint64_t next_resume_token(struct worker *worker) {
+    uint64_t token;
+    do {
+        uint64_t z = (worker->token_state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        token = z ^ (z >> 31);
+    } while (token == 0);
+    return token;
+}
+
+// Give a room whose game is starting a record in its workers snapshot section, filled in on the next tick
+void take_snapshot_record(struct room *room) {
+    struct worker *worker = room->worker;
+    if (!snapshot_enabled || worker->snapshot_free_count == 0) {
+        return;
+    }
+    room->snapshot_index = worker->snapshot_free[--worker->snapshot_free_count];
+    room->snapshot_dirty = 1;
+}
+
+// Free a rooms snapshot record once its game is over, so the game isn't restored
+void release_snapshot_record(struct room *room) {
+    struct worker *worker = room->worker;
+    if (room->snapshot_index < 0) {
+        return;
+    }
+    snapshot_clear_room(snapshot_record(worker->index, room->snapshot_index));
+    worker->snapshot_free[worker->snapshot_free_count++] = room->snapshot_index;
+    room->snapshot_index = -1;
+}
+
+// Copy every room that changed since the last tick into the snapshot
+void write_snapshot(struct worker *worker) {
+    for (struct room *room = worker->running_rooms; room != NULL; room = room->next) {
+        if (room->snapshot_dirty && room->snapshot_index >= 0) {
+            snapshot_write_room(snapshot_record(worker->index, room->snapshot_index), room);
+            room->snapshot_dirty = 0;
         }
+    }
+}
+
+// The guess path only marks its room dirty, copying happens here. A crash loses at most the last
+// SNAPSHOT_INTERVAL_MS of guesses, and resumed clients are sent the state that was kept
+void on_snapshot_timer(void *arg) {
+    struct worker *worker = arg;
+
+    write_snapshot(worker);
+    reactor_timer_arm(&worker->reactor, &worker->snapshot_timer, SNAPSHOT_INTERVAL_MS);
+}
+
+// Rebuild the games in progress read from the snapshot, each on the worker its room id belongs to, with
+// every slot held for its player. Runs before the workers start
+void restore_rooms(void) {
+    int count = snapshot_restored_count();
+    int max_room_id = 0;
 
-        // Reject new connection requests
-        if (reject_incoming_connections(server_fd, readfds) < 0) {
-            perror("New Rejection Request Error");
+    if (count > 0) {
+        resume_entries = malloc((size_t)count * player_count * sizeof(struct resume_entry));
+        if (resume_entries == NULL) {
+            log_error("Memory allocation failed: %s", strerror(errno));
             exit(EXIT_FAILURE);
-        } 
-
-        // Process guesses for each player
-        for (int i = 0; i < *connected_players; i++) {
-            int sd = client_sockets[i];
-            
-            // *** May cause issues if finished
-            // user disconnects ***
-
-            if (FD_ISSET(sd, readfds)) {
-                memset(&guess, 0, sizeof(guess));
-                int valread = recv(sd, &guess, sizeof(guess), 0);
-
-                // Handle player disconnections
-                if (valread == 0) {
-                    printf("Player %d (Socket %d) disconnected during the game.\n", 
-                        i + 1, sd);
-                    printf("Player numbers above Player %d will move down (Player %d is now Player %d etc)\n",
-                        i + 1, i + 2, i + 1);
-                    close(sd); // *** May need to move this close down ***
-                    client_sockets[i] = 0;
-
-                    if (game_finished[i]) {
-                        finished_players--;
-                    }
-
-                    // Shift all remaining players down
-                    for (int j = i; j < *connected_players - 1; j++) {
-                        client_sockets[j] = client_sockets[j + 1];
-                        player_names[j] = player_names[j + 1];
-                        guesses_left[j] = guesses_left[j + 1];
-                        game_finished[j] = game_finished[j + 1];
-
-                        // Copy nested server_arr state
-                        memcpy(server_arr[j], server_arr[j + 1], word_length * sizeof(int));
-                    }
-
-                    // Clear the last slot
-                    client_sockets[*connected_players - 1] = 0;
-                    player_names[*connected_players - 1] = NULL;
-                    guesses_left[*connected_players - 1] = 0;
-                    game_finished[*connected_players - 1] = 1; // Mark as finished
-
-                    memset(server_arr[*connected_players - 1], 0, word_length * sizeof(int));
-
-                    // Reduce the player count
-                    (*connected_players)--;
-
-                    // Reduce active players count for the loop condition
-                    active_players--;
-
-                    // Adjust loop counter since we shifted elements
-                    i--;
-                    continue;
-                } 
-
-                if (game_finished[i] == 1) {
-                    printf("Player %d has finished, ignoring input.\n", i + 1);
-                    continue;
-                }
+        }
+    }
 
-                // Handle player guess
-                if (valread > 0) { 
-                    guess = toupper(guess); // Convert input to upper case
-
-                    // Ignore newline and carriage return characters
-                    if (guess == '\n' || guess == '\r') {
-                        continue; // Skip this iteration and wait for a real input
-                    }
-                
-                    // Ensure it's a valid alphabetical letter (A-Z only)
-                    if (guess < 'A' || guess > 'Z') {
-                        printf("Invalid input received from Player %d: %c (ASCII: %d)\n", i + 1, guess, guess);
-                        continue; // Ignore anything that isn't a valid letter
-                    }
-
-                    printf("Player %d: guessed %c\n", i + 1, guess);
-
-                    int boolean_arr[word_length]; // Temp array to send back to client with guess results
-                    memset(boolean_arr, 0, word_length * sizeof(int));
-
-                    int correct_guess = 0;
-
-                    // Check if the guessed letter is in the goal word
-                    for (int j = 0; j < word_length; j++) {
-                        if (goal_word[j] == guess) {
-                            boolean_arr[j] = 1;
-                            server_arr[i][j] = 1;
-                            correct_guess = 1;
-                        }
-                    }
-
-                    // If guess if incorrect, lose a life
-                    if (!correct_guess) {
-                        guesses_left[i]--; // Decrement remaining guesses
-                        printf("Player %d: incorrect guess. Remaining guesses: %d\n", i + 1, guesses_left[i]);
-                    } else {
-                        printf("Player %d: correct guess.\n", i + 1);
-                    }
-
-                    for (int j = 0; j < word_length; j++) {
-                        printf("%d ", boolean_arr[j]);
-                    }
-                    printf("]\n");
-
-                    // Send the updated boolean array with guessed letters to all clients
-                    send(client_sockets[i], boolean_arr, word_length * sizeof(int), 0);
-
-                    // Check if the player has finished (either guessed the word in full, or out of guesses)
-                    if (is_word_guessed(server_arr[i], word_length)) {
-                        printf("Player %d: has guessed the word!\n", i + 1);
-                        fflush(stdin);
-                        game_finished[i] = 1;
-                        finished_players++;
-                    }
-
-                    if (guesses_left[i] == 0) {
-                        printf("Player %d is out of guesses\n", i + 1);
-                        fflush(stdin);
-                        game_finished[i] = 1;
-                        finished_players++;
-                    }
-                }
-            }
+    for (int n = 0; n < count; n++) {
+        const struct snapshot_room *record = snapshot_restored(n);
+        struct worker *worker = room_owner(record->id);
+
+        if (worker->room_count >= MAX_ROOMS) {
+            log_warn("Room %d: not restored, worker %d already has %d rooms", record->id, worker->index, MAX_ROOMS);
+            continue;
+        }
+        if (restore_room(worker, record) != NULL && record->id > max_room_id) {
+            max_room_id = record->id;
         }
     }
+    snapshot_free_restored();
+
+    if (resume_entry_count > 0) {
+        qsort(resume_entries, resume_entry_count, sizeof(struct resume_entry), compare_resume_entries);
+    }
+
+    uint64_t resume_until = metrics_now_us() + (uint64_t)RESUME_TIMEOUT_MS * 1000;
+    for (int i = 0; i < worker_count; i++) {
+        struct worker *worker = &workers[i];
 
-    printf("All players have finished the game. Exiting...\n");
+        // New room ids carry on past the restored ones, so they stay unique
+        worker->next_room_id = max_room_id / worker_count + 1;
+        worker->resume_until = resume_until;
+    }
 }
 
-// Function to check if the player has guessed the word in full
-int is_word_guessed(int *player_progress, int word_length) {
-    for (int i = 0; i < word_length; i++) {
-        if (player_progress[i] == 0) {  // If any letter is still missing, return false
-            return 0;
+// Open a room for a game read back from the snapshot and hold its slots until the players resume
+struct room *restore_room(struct worker *worker, const struct snapshot_room *record) {
+    struct room *room = room_create(&worker->room_pool, record->id, record->goal_word);
+    if (room == NULL) {
+        log_warn("Room %d: could not be restored", record->id);
+        return NULL;
+    }
+
+    room->worker = worker;
+    room->publish_list = &worker->publish_list;
+    room->phase_started = metrics_now_us();
+    worker->room_count++;
+    room_list_add(&worker->running_rooms, room);
+
+    for (int n = 0; n < player_count; n++) {
+        const struct snapshot_player *player = &record->players[n];
+        if (player->token == 0) {
+            continue;
+        }
+
+        // The name is held for the player until they come back
+        const char *name;
+        if (names_claim(player->name, 1, &name) != NAME_CLAIMED) {
+            log_warn("Room %d: %s could not be restored", record->id, player->name);
+            continue;
+        }
+
+        int i = room_alloc_slot(room);
+        room->player_names[i] = name;
+        room->tokens[i] = player->token;
+        room->progress[i] = player->progress;
+        room->guesses_left[i] = player->guesses_left;
+        room->detached[i] = 1;
+        room->connected_players++;
+        if (player->finished) {
+            room->game_finished[i] = 1;
+            room->finished_players++;
+            room->leaderboard[i] = player->score;
+            room->result_entries[i] = leaderboard_insert(&room->results, room->player_names[i], player->score);
+        }
+        worker->detached_players++;
+
+        struct resume_entry *entry = &resume_entries[resume_entry_count++];
+        entry->token = player->token;
+        entry->worker = worker;
+        entry->room = room;
+        entry->slot = i;
+    }
+
+    // Replaying the journal picks the game up from where the snapshot left it
+    journal_game_start(worker->index, room->id, room->goal_word, room->connected_players, MAX_GUESSES);
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->detached[i]) {
+            journal_restore(worker->index, room->id, i, room->player_names[i], room->progress[i],
+                            room->guesses_left[i], room->game_finished[i], room->leaderboard[i]);
         }
     }
-    return 1;  // All letters have been guessed
+
+    take_snapshot_record(room);
+    write_snapshot(worker);
+    log_info("Room %d restored with %d players. Goal Word: %s", room->id, room->connected_players, room->goal_word);
+    return room;
 }
 
-// Receives the final score from all clients and sends back a leaderboard of all the usernames/scores
-void format_and_send_leaderboard(int server_fd, int *client_sockets, int *connected_players, int *leaderboard, char * goal_word, fd_set *readfds, char **player_names) {
-    int final_scores_received = 0;
-    short int score = 0; 
+int compare_resume_entries(const void *a, const void *b) {
+    uint64_t left = ((const struct resume_entry *)a)->token;
+    uint64_t right = ((const struct resume_entry *)b)->token;
+    return (left > right) - (left < right);
+}
 
-    printf("Waiting for players to send final scores...\n");
+// Look a resume token up in the games restored at startup. Returns NULL if it isn't one of them
+const struct resume_entry *find_resume_entry(uint64_t token) {
+    if (resume_entry_count == 0) {
+        return NULL;
+    }
 
-    while (final_scores_received < *connected_players) {
-        FD_ZERO(readfds);
-        FD_SET(server_fd, readfds);
-        int max_sd = server_fd;
-        int active_players = 0;
+    struct resume_entry key;
+    key.token = token;
+    return bsearch(&key, resume_entries, resume_entry_count, sizeof(struct resume_entry), compare_resume_entries);
+}
 
-        // Add active sockets to read set
-        for (int i = 0; i < *connected_players; i++) {
-            if (client_sockets[i] > 0) {
-                FD_SET(client_sockets[i], readfds);
-                if (client_sockets[i] > max_sd) {
-                    max_sd = client_sockets[i];
-                }
-                active_players++;
-            }
+// Whether the slot of entry is still held for the player with token. Only the owning worker may ask
+int slot_waiting(const struct resume_entry *entry, uint64_t token) {
+    struct room *room = entry->room;
+    return room->phase == PHASE_PLAYING && room->detached[entry->slot] && room->tokens[entry->slot] == token;
+}
+
+// A v2 client sent a resume token instead of a username. Returns 0 once the player is back in their
+// room or on the way to the worker that has it, and -1 after telling the client the token didn't match
+int resume_player(struct connection *connection, uint64_t token) {
+    struct worker *worker = connection->worker;
+    const struct resume_entry *entry = find_resume_entry(token);
+
+    if (entry != NULL && entry->worker == worker && slot_waiting(entry, token)) {
+        lobby_leave(&worker->lobby, connection);
+        attach_player(entry, connection);
+        service_buffered_input(connection);
+        return 0;
+    }
+    if (entry != NULL && entry->worker != worker) {
+        connection->resume_token = token;
+        if (hand_off_player(connection, entry->worker) == 0) {
+            return 0;
         }
+        connection->resume_token = 0;
+    }
 
-        // If all players are disconnected, exit
-        if (active_players == 0) {
-            printf("All players have disconnected. Exiting leaderboard...\n");
-            break;
+    log_debug("Lobby: Socket %d sent a resume token that doesn't match a restored game", connection->fd);
+    protocol_send_resume_failed(connection);
+    return -1;
+}
+
+// Pass a connection to the worker that owns the room it is resuming or going to watch. Closing the fd here
+// also takes the socket off this workers event loop, so the owner is given a duplicate of it. The owner takes
+// the connection once handoff_done is set, when this worker has sent everything queued and closed its fd.
+// Returns -1 if the owner has stopped
+int hand_off_player(struct connection *connection, struct worker *owner) {
+    struct worker *worker = connection->worker;
+    int fd = fcntl(connection->fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&owner->inbox_lock);
+    if (owner->inbox_closed) {
+        pthread_mutex_unlock(&owner->inbox_lock);
+        close(fd);
+        return -1;
+    }
+
+    // Anything already queued, such as the v2 welcome, is written before the socket changes hands. Input the
+    // event loop has already received (io_uring holds it in buffers of its own) goes along in the input ring
+    size_t pending = connection->output.pending;
+    connection_flush(connection);
+    metrics_add(&worker->metrics.bytes_out, pending - connection->output.pending);
+    unsigned int filled = connection->input.tail;
+    input_buffer_fill(&connection->input, &worker->reactor, connection->fd, 0);
+    metrics_add(&worker->metrics.bytes_in, connection->input.tail - filled);
+    lobby_leave(&worker->lobby, connection);
+    reactor_timer_cancel(&worker->reactor, &connection->deadline);
+    connection->handoff_done = 0;
+    reactor_hand_off(&worker->reactor, connection->fd, &connection->handoff_done);
+
+    log_debug("Lobby: Socket %d handed to worker %d as socket %d", connection->fd, owner->index, fd);
+    connection->fd = fd;
+    connection->lobby_next = owner->inbox;
+    owner->inbox = connection;
+    pthread_mutex_unlock(&owner->inbox_lock);
+    return 0;
+}
+
+// Register a connection handed over by another worker and seat it in the slot it is resuming, or let
+// it watch the room it asked for. If that has gone it is kept in this workers lobby to start over
+void take_handed_player(struct worker *worker, struct connection *connection) {
+    connection->worker = worker;
+    connection->reactor = &worker->reactor;
+    connection->flush_list = &worker->flush_list;
+    connection->lobby_next = NULL;
+    reactor_timer_init(&connection->deadline, on_player_timeout, connection);
+
+    if (reactor_add(&worker->reactor, connection->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, on_client_event, connection) < 0) {
+        log_error("Event loop registration failed: %s", strerror(errno));
+        close(connection->fd);
+        connection_destroy(connection);
+        return;
+    }
+
+    uint64_t token = connection->resume_token;
+    const struct resume_entry *entry = token != 0 ? find_resume_entry(token) : NULL;
+    struct room *room = token == 0 ? find_room(worker, connection->spectate_room) : NULL;
+    connection->resume_token = 0;
+    connection->spectate_room = 0;
+
+    if (entry != NULL && entry->worker == worker && slot_waiting(entry, token)) {
+        attach_player(entry, connection);
+    } else if (room != NULL) {
+        watch_room(room, connection);
+    } else {
+        lobby_enter(&worker->lobby, connection);
+        if (token != 0) {
+            protocol_send_resume_failed(connection);
+        } else {
+            protocol_send_spectate_failed(connection);
         }
+        reactor_timer_arm(&worker->reactor, &connection->deadline, NAME_TIMEOUT_MS);
+    }
+    service_buffered_input(connection);
+}
 
-        // Wait for data from any player
-        int activity = select(max_sd + 1, readfds, NULL, NULL, NULL);
-        if (activity < 0) {
-            perror("Select failed");
-            exit(EXIT_FAILURE);
+// Handle input already in the ring of a connection that has just moved into a room or over from another worker,
+// such as a guess pipelined behind MSG_RESUME. The event loop won't report it, as it has already been read
+void service_buffered_input(struct connection *connection) {
+    if (input_buffer_used(&connection->input) > 0) {
+        on_client_event(connection->fd, EPOLLIN, connection);
+    }
+}
+
+// Seat a player who resumed in the slot held for them, and send them their game so far
+void attach_player(const struct resume_entry *entry, struct connection *connection) {
+    struct room *room = entry->room;
+    int i = entry->slot;
+
+    room->detached[i] = 0;
+    room->worker->detached_players--;
+    room->connections[i] = connection;
+    room->client_sockets[i] = connection->fd;
+    room->snapshot_dirty = 1;
+    connection->room = room;
+    connection->player = room_player_id(room, i);
+    connection->phase = PHASE_PLAYING;
+    connection->name = room->player_names[i]; // The connection takes over the claim the slot held
+    metrics_add(&room->worker->metrics.players_resumed, 1);
+    journal_join(room->worker->index, room->id, i, connection->serial, connection->name);
+
+    protocol_send_resumed(connection, room->game_word.length, room->guesses_left[i], room->game_finished[i], room->progress[i]);
+    if (room->game_finished[i]) {
+        reactor_timer_cancel(&room->worker->reactor, &connection->deadline);
+    } else {
+        arm_deadline(room, i, GUESS_TIMEOUT_MS);
+    }
+    log_info("Room %d: Player %d - %s resumed (Socket %d)", room->id, i + 1, room->player_names[i], connection->fd);
+}
+
+// Runs every tick: seats players and spectators handed over by other workers, and once RESUME_TIMEOUT_MS
+// has passed since a restart, frees the slots of restored players who didn't come back
+void on_inbox_timer(void *arg) {
+    struct worker *worker = arg;
+
+    pthread_mutex_lock(&worker->inbox_lock);
+    while (worker->inbox != NULL) {
+        struct connection *connection = worker->inbox;
+        worker->inbox = connection->lobby_next;
+        connection->lobby_next = worker->arrived;
+        worker->arrived = connection;
+    }
+    pthread_mutex_unlock(&worker->inbox_lock);
+
+    // A connection is taken once the worker that sent it has finished with the socket. Its last sends (with
+    // io_uring) can still be running, and they would race with anything written here
+    struct connection **link = &worker->arrived;
+    while (*link != NULL) {
+        struct connection *connection = *link;
+        if (!__atomic_load_n(&connection->handoff_done, __ATOMIC_ACQUIRE)) {
+            link = &connection->lobby_next;
+            continue;
         }
+        *link = connection->lobby_next;
+        take_handed_player(worker, connection);
+    }
 
-        // Reject new connection requests
-        if (reject_incoming_connections(server_fd, readfds) < 0) {
-            perror("New Rejection Request Error");
-            exit(EXIT_FAILURE);
-        } 
-
-        // Process received scores
-        for (int i = 0; i < *connected_players; i++) {
-            int sd = client_sockets[i];
-
-            if (FD_ISSET(sd, readfds)) {
-                int valread = recv(sd, &score, sizeof(short int), MSG_DONTWAIT);
-                printf("Value read: %d\n", valread);
-                printf("Score read: %d\n", score);
-                if (valread > 0) {
-                    // short int final_score = ntohs(score); // Convert from network byte order to host byte order
-                    leaderboard[i] = score;
-                    final_scores_received++;
-                    printf("Player %d: received final score: %d\n", i + 1, score);
-                    break;
-                } else if (valread == 0) {
-                    printf("Player %d (Socket %d) disconnected during the leaderboard.\n", 
-                        i + 1, sd);
-                    printf("Player numbers above Player %d will move down (Player %d is now Player %d etc)\n",
-                        i + 1, i + 2, i + 1);
-                    close(sd); // *** May need to move this close down ***
-                    client_sockets[i] = 0;
-
-                    // Shift all remaining players down
-                    for (int j = i; j < *connected_players - 1; j++) {
-                        client_sockets[j] = client_sockets[j + 1];
-                        player_names[j] = player_names[j + 1];
-                        leaderboard[j] = leaderboard[j + 1];
-
-                        // Copy nested server_arr state
-                        // memcpy(server_arr[j], server_arr[j + 1], word_length * sizeof(int));
-                    }
-
-                    // Clear the last slot
-                    client_sockets[*connected_players - 1] = 0;
-                    player_names[*connected_players - 1] = NULL;
-                    leaderboard[*connected_players - 1] = 0;
-
-                    // Reduce the player count
-                    (*connected_players)--;
-
-                    // Reduce active players count for the loop condition
-                    active_players--;
-
-                    // Adjust loop counter since we shifted elements
-                    i--;
-                    continue;
+    if (worker->detached_players > 0 && metrics_now_us() >= worker->resume_until) {
+        drop_detached_players(worker);
+    }
+
+    reactor_timer_arm(&worker->reactor, &worker->inbox_timer, REACTOR_TICK_MS);
+    flush_connections(worker);
+}
+
+// Free the slots still held for restored players who didn't come back in time, so their rooms can finish
+void drop_detached_players(struct worker *worker) {
+    struct room *room = worker->running_rooms;
+    while (room != NULL) {
+        struct room *next = room->next;
+        for (int i = 0; i < room->player_count; i++) {
+            if (room->detached[i]) {
+                log_info("Room %d: Player %d - %s did not come back.", room->id, i + 1, room->player_names[i]);
+                metrics_add(&worker->metrics.timeouts, 1);
+                names_release(room->player_names[i]);
+                room->connected_players--;
+                if (room->game_finished[i]) {
+                    room->finished_players--;
                 }
+                room_free_slot(room, i);
+                room->snapshot_dirty = 1;
+                protocol_publish_left(room, i);
             }
         }
+        advance_game_phase(room);
+        room = next;
     }
+    worker->detached_players = 0;
+}
 
-    char leaderboard_buffer[1024]; // Large enough buffer to hold all leaderboard entries
-    memset(leaderboard_buffer, 0, sizeof(leaderboard_buffer));
+// Worker that runs the room with room_id, see open_game()
+struct worker *room_owner(int room_id) {
+    return &workers[(room_id - 1) % worker_count];
+}
 
-    // Format the leaderboard as a single buffer
-    for (int i = 0; i < *connected_players; i++) {
-        if (player_names[i] != NULL && client_sockets[i] > 0) {  // Ensure valid player
-            snprintf(leaderboard_buffer + strlen(leaderboard_buffer), 
-                     sizeof(leaderboard_buffer) - strlen(leaderboard_buffer), 
-                     "%s:%d,", player_names[i], leaderboard[i]);
-        } else {
-            snprintf(leaderboard_buffer + strlen(leaderboard_buffer), 
-                     sizeof(leaderboard_buffer) - strlen(leaderboard_buffer), 
-                     "Disconnected:0\n"); // Handle DC players
+// A room on worker whose game is in progress: the one with room_id, or any of them for 0. NULL if there is none
+struct room *find_room(struct worker *worker, int room_id) {
+    for (struct room *room = worker->running_rooms; room != NULL; room = room->next) {
+        if (room->phase == PHASE_PLAYING && (room_id == 0 || room->id == room_id)) {
+            return room;
         }
     }
+    return NULL;
+}
 
-    // Send the entire leaderboard buffer to all active clients
-    for (int i = 0; i < *connected_players; i++) {
-        if (client_sockets[i] > 0) { // Ensure the client is still connected
-            send(client_sockets[i], leaderboard_buffer, strlen(leaderboard_buffer) + 1, 0);
+// A v2 client asked to watch a game instead of playing. Returns 0 once it is watching or on the way to the
+// worker that runs the game, and -1 after telling the client there is no such game in progress
+int spectate_room(struct connection *connection, int room_id) {
+    struct worker *worker = connection->worker;
+
+    if (room_id > 0 && room_owner(room_id) != worker) {
+        connection->spectate_room = room_id;
+        if (hand_off_player(connection, room_owner(room_id)) == 0) {
+            return 0;
+        }
+        connection->spectate_room = 0;
+    } else {
+        struct room *room = find_room(worker, room_id);
+        if (room != NULL) {
+            lobby_leave(&worker->lobby, connection);
+            reactor_timer_cancel(&worker->reactor, &connection->deadline);
+            watch_room(room, connection);
+            return 0;
         }
     }
 
-    // Debug: Print the leaderboard for server reference
-    printf("Final leaderboard sent to all players:\n%s", leaderboard_buffer);
-    //clear();
-}
-
-void random_goal_word() {
-    char *words[] = {
-    "THEOREM", "CALCULUS", "GEOMETRY", "ALGEBRA", "STATISTICS", "INTEGRAL", "MATRIX",
-    "ROBOTICS", "CYBERNETICS", "NANOTECH", "QUANTUM", "GRAVITY", "RELATIVITY", "TELESCOPE", "MICROSCOPE", "SATELLITE", 
-    "GALAXY", "PLANET", "COMET", "ASTEROID", "METEOR", "NEBULA", "QUASAR", "PULSAR", "BLACKHOLE",
-    "STADIUM", "BALLPARK", "COURT", "ARENA", "GYM", "TRACK", "FIELD", "RINK", "POOL", "RACEWAY",
-    "SOCCER", "BASKETBALL", "BASEBALL", "FOOTBALL", "HOCKEY", "VOLLEYBALL", "TENNIS", "CRICKET", "RUGBY", "GOLF",
-    "BALLET", "OPERA", "CONCERT", "FESTIVAL", "PARADE", "EXHIBIT", "CIRCUS", "PERFORMANCE", "COMPETITION", "AUDITION",
-    "GUITAR", "PIANO", "VIOLIN", "DRUMS", "TRUMPET", "SAXOPHONE", "FLUTE", "CELLO", "TROMBONE", "CLARINET",
-    "IMAGINE", "CREATE", "INVENT", "DESIGN", "SOLVE", "ANALYZE", "EXPLORE", "DISCOVER", "DEVELOP", "BUILD",
-    "DIALOGUE", "CHARACTER", "SETTING", "THEME", "PLOT", "CONFLICT", "CLIMAX", "RESOLUTION", "NARRATIVE", "SCENE",
-    "PROBLEM", "SOLUTION", "METHOD", "PROCESS", "HYPOTHESIS", "EXPERIMENT", "RESULT", "CONCLUSION", "EVIDENCE", "DATA",
-    "DINOSAUR", "MAMMAL", "REPTILE", "INSECT", "AMPHIBIAN", "SPECIES", "ORGANISM", "ECOSYSTEM", "HABITAT", "PREDATOR",
-    "ECONOMY", "MARKET", "CURRENCY", "FINANCE", "INVESTMENT", "TRADE", "INDUSTRY", "BUSINESS", "CAPITAL", "TAXES",
-    "REPUBLIC", "MONARCHY", "DEMOCRACY", "DICTATOR", "SENATOR", "PRESIDENT", "GOVERNOR", "MAYOR", "MINISTER", "JUDGE",
-    "CULTURE", "SOCIETY", "COMMUNITY", "TRADITION", "RITUAL", "CUSTOM", "LANGUAGE", "RELIGION", "BELIEF", "VALUES",
-    "HISTORY", "TIMELINE", "DYNASTY", "EMPIRE", "KINGDOM", "REVOLUTION", "WARFARE", "BATTLE", "TREATY", "INDEPENDENCE",
-    "PROGRAM", "PROJECT", "ASSIGNMENT", "TASK", "DEADLINE", "GOAL", "STRATEGY", "MEETING", "DISCUSSION", "PLAN",
-    "ROBOT", "DRONE", "MACHINE", "AUTOMATION", "SENSOR", "MICROCHIP", "CIRCUIT", "GADGET", "INTERFACE", "CONTROLLER",
-    "COMPANY", "STARTUP", "CORPORATION", "AGENCY", "BUREAU", "OFFICE", "BRANCH", "FIRM", "SUBSIDIARY", "ENTERPRISE",
-    "RESOURCE", "SUPPLY", "DISTRIBUTION", "DEMAND", "MANAGEMENT", "INVENTORY", "PRODUCTION", "OPERATION", "MAINTENANCE", 
-    "LEADER", "TEAM", "GROUP", "COLLABORATE", "NEGOTIATE", "COORDINATE", "SUPPORT", "ASSIST", "CONSULT", "EVALUATE",
-    "WEBSITE", "BLOG", "FORUM", "SOCIAL", "PLATFORM", "MEDIA", "APPLICATION", "CONTENT", "SERVICE", "SUPPORT",
-    "EARTH", "PLANET", "MARS", "VENUS", "JUPITER", "SATURN", "MERCURY", "URANUS", "MOUNTAIN", "RIVER", "OCEAN",
-    "ISLAND", "BEACH", "HARBOR", "CANYON", "PLATEAU", "SUMMIT", "GLACIER", "CLIFF", "WATERFALL", "HORIZON",
-    "SUNRISE", "SUNSET", "THUNDER", "LIGHTNING", "RAINBOW", "WHIRLPOOL", "SANDSTORM", "TORNADO", "AVALANCHE", 
-    "MEADOW", "GARDEN", "ORCHARD", "VINEYARD", "PASTURE", "FARMLAND", "WILDERNESS", "GROVE", "SWAMP", "MARSH",
-    "SCHOOL", "COLLEGE", "LIBRARY", "MUSEUM", "GALLERY", "STADIUM", "THEATER", "HOSPITAL", "STATION", "UNIVERSITY",
-    "AIRPLANE", "HELICOPTER", "SUBMARINE", "SCOOTER", "BICYCLE", "MOTORCYCLE", "BUS", "TRAM", "SUBWAY", "TRAIN",
-    "POLICE", "FIREMAN", "DOCTOR", "NURSE", "TEACHER", "LAWYER", "JUDGE", "PILOT", "ENGINEER", "SCIENTIST",
-    "ARTIST", "MUSICIAN", "PAINTER", "SCULPTOR", "WRITER", "AUTHOR", "DIRECTOR", "ACTOR", "DANCER", "SINGER",
-    "STUDENT", "PROFESSOR", "LIBRARIAN", "MANAGER", "WORKER", "CLERK", "CASHIER", "WAITER", "BARISTA", "CHEF",
-    "COMPUTER", "KEYBOARD", "MONITOR", "PRINTER", "SCANNER", "ROUTER", "MODEM", "SPEAKER", "TABLET", "CAMERA",
-    "SOFTWARE", "HARDWARE", "NETWORK", "DATABASE", "BROWSER", "PROGRAM", "SYSTEM", "SERVER", "BACKUP", "VIRTUAL",
-    "PYTHON", "JAVA", "CSHARP", "GOLANG", "KOTLIN", "SWIFT", "BINARY", "ARRAY", "VECTOR", "POINTER",
-    "FICTION", "NOVEL", "POETRY", "DRAMA", "COMEDY", "TRAGEDY", "BIOGRAPHY", "MYSTERY", "FANTASY", "ROMANCE",
-    "JUSTICE", "FREEDOM", "HONESTY", "INTEGRITY", "LOYALTY", "COMPASSION", "PATIENCE", "COURAGE", "RESPECT", "WISDOM",
-    "BIOLOGY", "CHEMISTRY", "PHYSICS", "GEOLOGY", "ASTRONOMY", "BOTANY", "ZOOLOGY", "ECOLOGY", "GENETICS", "MICROBES",
-    "ALGORITHM", "EQUATION", "FORMULA", "NEPTUNE", "PLUTO", "FOREST", "DESERT", "VALLEY", "PRAIRIE", "JUNGLE",
-    "APPLE", "BANANA", "GRAPES", "ORANGE", "MELON", "MANGO", "PEACH", "CHERRY", "PEAR", "PLUM", "VOLCANO",
-    "DREAM", "IMAGINE", "CREATE", "WONDER", "DISCOVER", "EXPLORE", "BUILD", "INVENT", "LEARN", "GROW",
-    "SMILE", "LAUGH", "CRY", "SIGH", "YAWN", "SHOUT", "WHISPER", "SCREAM", "TALK", "SING", "LOGISTICS",
-    "RUN", "JUMP", "WALK", "DANCE", "SWIM", "CLIMB", "CRAWL", "SLIDE", "STRETCH", "SPIN", "PROBE", "EARTHQUAKE",
-    "SHIRT", "PANTS", "JACKET", "SCARF", "GLOVES", "HAT", "SHOES", "SOCKS", "BELT", "BOOTS", "TUNDRA", 
-    "PHONE", "TABLET", "LAPTOP", "CAMERA", "REMOTE", "SPEAKER", "HEADPHONES", "BATTERY", "CHARGER", "MONITOR",
-    "PENCIL", "ERASER", "MARKER", "NOTEBOOK", "RULER", "SCISSORS", "GLUE", "TAPE", "PAPER", "FOLDER"
-    };
-    const int WORDS_COUNT = sizeof(words) / sizeof(words[0]);
-
-    // Free any previously allocated memory
-    if (goal_word != NULL) {
-        free(goal_word);
-    }
-
-    // Select a random word
-    char *selected_word = words[rand() % WORDS_COUNT];
-
-    // Allocate exact memory needed
-    goal_word = malloc(strlen(selected_word) + 1); // +1 for null terminator
-    if (goal_word == NULL) {
-        perror("Memory allocation failed");
-        exit(EXIT_FAILURE);
+    log_debug("Lobby: Socket %d asked to watch room %d, which has no game in progress", connection->fd, room_id);
+    protocol_send_spectate_failed(connection);
+    return -1;
+}
+
+// Send a new spectator the game so far, then every event of the room until its leaderboard.
+// Spectators have no deadline while they watch, the game itself can't run forever
+void watch_room(struct room *room, struct connection *connection) {
+    spectator_add(room, connection);
+    protocol_send_spectating(connection, room, MAX_GUESSES);
+    metrics_add(&room->worker->metrics.spectators, 1);
+    log_debug("Room %d: Socket %d is watching, %d spectators", room->id, connection->fd, room->spectator_count);
+}
+
+// Spectators have nothing to say: drop whatever they send until they hang up
+void service_spectator(struct connection *connection) {
+    enum input_status status;
+
+    do {
+        unsigned int filled = connection->input.tail;
+        status = input_buffer_fill(&connection->input, connection->reactor, connection->fd, connection->peer_closed);
+        metrics_add(&connection->worker->metrics.bytes_in, connection->input.tail - filled);
+        input_buffer_skip(&connection->input, input_buffer_used(&connection->input));
+    } while (status == INPUT_FULL);
+
+    if (status == INPUT_CLOSED) {
+        log_debug("Spectator: Socket %d disconnected.", connection->fd);
+        remove_spectator(connection);
+    }
+}
+
+// Stop sending a spectator events, if their game is still going, and close their socket
+void remove_spectator(struct connection *connection) {
+    struct worker *worker = connection->worker;
+
+    metrics_add(&worker->metrics.disconnects[PHASE_SPECTATING], 1);
+    if (connection->room != NULL) {
+        spectator_remove(connection->room, connection);
+    }
+    close_client(&worker->reactor, connection);
+}
+
+// The game is over: spectators get the events still to be published, ending with the leaderboard, and are
+// then half-closed like the players
+void release_spectators(struct room *room) {
+    spectators_publish(room);
+    while (room->spectators != NULL) {
+        struct connection *connection = room->spectators;
+        spectator_remove(room, connection);
+        connection_shutdown_after_flush(connection);
+        reactor_timer_arm(&room->worker->reactor, &connection->deadline, LINGER_TIMEOUT_MS);
     }
+}
+
+// Seat up to count bots in the free slots of a game about to start. Bots have no socket and no resume token,
+// so they are left out of snapshots and rankings, but they are on the leaderboard and seen by spectators
+void add_bots(struct room *room, int count) {
+    for (int n = 0; n < count; n++) {
+        int i = room_alloc_slot(room);
+        if (i < 0) {
+            return;
+        }
+        struct bot *bot = bot_create(room, i, room->game_word.length, on_bot_think);
+        if (bot == NULL) {
+            log_error("Memory allocation failed: %s", strerror(errno));
+            room_free_slot(room, i);
+            return;
+        }
 
-    // Copy the word into dynamically allocated memory
-    strcpy(goal_word, selected_word);
+        room->bots[i] = bot;
+        room->player_names[i] = bot->name;
+        room->connected_players++;
+        room->bot_count++;
+        metrics_add(&room->worker->metrics.bots, 1);
+        journal_join(room->worker->index, room->id, i, 0, room->player_names[i]);
+        log_debug("Room %d: Player %d is %s", room->id, i + 1, room->player_names[i]);
+    }
 }
 
-// void flush_socket(int sd) {
-//     char flush_buffer[128];  // Temporary buffer for clearing input
-//     int bytes_read;
-    
-//     // Use MSG_DONTWAIT to read and discard any leftover data
-//     while ((bytes_read = recv(sd, flush_buffer, sizeof(flush_buffer), MSG_DONTWAIT)) > 0) {
-//         // Debugging (Optional)
-//         printf("Flushed %d bytes from Player socket %d\n", bytes_read, sd);
-//     }
-// }
\ No newline at end of file
+// A bots think timer has fired: play its next guess, and think again unless that finished it
+void on_bot_think(void *arg) {
+    struct bot *bot = arg;
+    struct room *room = bot->room;
+    struct worker *worker = room->worker;
+    int i = bot->slot;
+
+    char guess = bot_next_guess(bot);
+    if (guess != 0 && !room->game_finished[i]) {
+        bot_observe(bot, guess, apply_guess(room, i, guess));
+    }
+    if (!room->game_finished[i]) {
+        reactor_timer_arm(&worker->reactor, &bot->think_timer, bot_think_delay(worker));
+    }
+
+    // The last player finishing frees the bots, and closes the room if no human is left to hang up
+    advance_game_phase(room);
+    flush_connections(worker);
+}
+
+// Time until a bots next guess, drawn uniformly from 0 to twice the -o mean
+int bot_think_delay(struct worker *worker) {
+    if (bot_think_ms <= 0) {
+        return 0;
+    }
+    return rand_r(&worker->rand_seed) % (2 * bot_think_ms + 1);
+}
+
+// Take every bot out of the room, once the game is over or no human is left to play against
+void remove_bots(struct room *room) {
+    for (int i = 0; i < room->player_count && room->bot_count > 0; i++) {
+        struct bot *bot = room->bots[i];
+        if (bot == NULL) {
+            continue;
+        }
+
+        reactor_timer_cancel(&room->worker->reactor, &bot->think_timer);
+        bot_destroy(bot);
+        room->connected_players--;
+        if (room->game_finished[i]) {
+            room->finished_players--;
+        }
+        room->bot_count--;
+        room_free_slot(room, i);
+    }
+}
+
+// Pick a random word of any length, from the -D difficulty band if one was given, into goal_word, which holds
+// MAX_WORD_LENGTH + 1 bytes. Returns the word length, or -1 if the dictionary is empty
+int random_goal_word(char *goal_word, unsigned int *seed) {
+    return dictionary_random_word(goal_word, MAX_WORD_LENGTH + 1, seed, DICTIONARY_ANY, DICTIONARY_ANY, goal_band);
+}
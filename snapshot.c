@@ -0,0 +1,207 @@
+#include <stdlib.h>     // Standard library functions (malloc, free)
+#include <string.h>     // String manipulation functions (memcpy, memset, memchr, strncpy)
+#include <unistd.h>     // POSIX API functions (close, ftruncate)
+#include <fcntl.h>      // File control options (open)
+#include <time.h>       // Load time measurement (clock_gettime)
+#include <sys/mman.h>   // Memory mapped files (mmap, munmap)
+#include <errno.h>      // Error codes (errno)
+#include <sys/stat.h>   // File size (fstat)
+#include "snapshot.h"
+#include "log.h"        // Load summary and open failures
+
+// The snapshot file is mapped shared, so a record is in the page cache as soon as a worker has copied
+// a room into it and survives the process dying. Nothing is written on the guess path: workers copy
+// rooms that changed on a timer, see server.c
+static int snapshot_fd = -1;
+static char *mapping = NULL;
+static size_t mapping_size = 0;
+static size_t room_size = 0;
+static int rooms_per_worker = 0;
+
+// Records of games in progress read back from the previous run, copied out before the file is reset
+static char *restored = NULL;
+static int restored_count = 0;
+
+static size_t record_size(int player_count) {
+    size_t size = sizeof(struct snapshot_room) + player_count * sizeof(struct snapshot_player);
+    return (size + 63) & ~(size_t)63;
+}
+
+// A record is worth restoring if it wasn't torn, holds a game and every field is in range
+static int record_valid(const struct snapshot_room *record, int player_count) {
+    if ((record->sequence & 1) != 0 || record->id <= 0 ||
+        memchr(record->goal_word, '\0', sizeof(record->goal_word)) == NULL || record->goal_word[0] == '\0') {
+        return 0;
+    }
+
+    int players = 0;
+    for (int i = 0; i < player_count; i++) {
+        const struct snapshot_player *player = &record->players[i];
+        if (player->token == 0) {
+            continue;
+        }
+        if (memchr(player->name, '\0', sizeof(player->name)) == NULL || player->guesses_left < 0) {
+            return 0;
+        }
+        players++;
+    }
+    return players > 0;
+}
+
+// Copy every game in progress out of the previous run's file, if it has the same room size
+static void load_previous(int fd, int player_count) {
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < SNAPSHOT_HEADER_SIZE) {
+        return;
+    }
+
+    char *previous = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (previous == MAP_FAILED) {
+        return;
+    }
+
+    const struct snapshot_header *header = (const struct snapshot_header *)previous;
+    size_t previous_room_size = record_size(header->player_count);
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SNAPSHOT_VERSION ||
+        header->room_size != previous_room_size ||
+        SNAPSHOT_HEADER_SIZE + (size_t)header->worker_count * header->rooms_per_worker * previous_room_size > (size_t)info.st_size) {
+        log_warn("Snapshot: ignoring unrecognised file");
+        munmap(previous, info.st_size);
+        return;
+    }
+    if ((int)header->player_count != player_count) {
+        log_warn("Snapshot: rooms were for %u players, not %d, games in progress are discarded", header->player_count, player_count);
+        munmap(previous, info.st_size);
+        return;
+    }
+
+    int total = header->worker_count * header->rooms_per_worker;
+    restored = malloc((size_t)total * room_size);
+    if (restored == NULL) {
+        log_error("Memory allocation failed: %s", strerror(errno));
+        munmap(previous, info.st_size);
+        return;
+    }
+
+    for (int i = 0; i < total; i++) {
+        const struct snapshot_room *record = (const struct snapshot_room *)(previous + SNAPSHOT_HEADER_SIZE + i * room_size);
+        if (record_valid(record, player_count)) {
+            memcpy(restored + restored_count * room_size, record, room_size);
+            restored_count++;
+        }
+    }
+    munmap(previous, info.st_size);
+}
+
+// Open the snapshot file at path, keeping the games in progress it holds for snapshot_restored(), and
+// reset it to an empty file laid out for worker_count workers. Returns 0 on success, -1 on failure
+int snapshot_open(const char *path, int worker_count, int player_count, int rooms) {
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    snapshot_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (snapshot_fd < 0) {
+        log_error("Snapshot open failed: %s", strerror(errno));
+        return -1;
+    }
+
+    room_size = record_size(player_count);
+    rooms_per_worker = rooms;
+    load_previous(snapshot_fd, player_count);
+
+    // Truncating first zeroes every record, so rooms closed in the previous run don't come back
+    mapping_size = SNAPSHOT_HEADER_SIZE + (size_t)worker_count * rooms * room_size;
+    if (ftruncate(snapshot_fd, 0) < 0 || ftruncate(snapshot_fd, mapping_size) < 0) {
+        log_error("Snapshot resize failed: %s", strerror(errno));
+        return -1;
+    }
+
+    mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, snapshot_fd, 0);
+    if (mapping == MAP_FAILED) {
+        mapping = NULL;
+        log_error("Snapshot mmap failed: %s", strerror(errno));
+        return -1;
+    }
+
+    struct snapshot_header *header = (struct snapshot_header *)mapping;
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->worker_count = worker_count;
+    header->player_count = player_count;
+    header->rooms_per_worker = rooms;
+    header->room_size = room_size;
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    double elapsed_ms = (finished.tv_sec - started.tv_sec) * 1000.0 + (finished.tv_nsec - started.tv_nsec) / 1e6;
+    log_info("Snapshot: read %d games in progress from %s in %.2f ms", restored_count, path, elapsed_ms);
+    return 0;
+}
+
+int snapshot_restored_count(void) {
+    return restored_count;
+}
+
+// The index'th game read back by snapshot_open()
+const struct snapshot_room *snapshot_restored(int index) {
+    return (const struct snapshot_room *)(restored + index * room_size);
+}
+
+// Drop the restored records once their rooms have been rebuilt
+void snapshot_free_restored(void) {
+    free(restored);
+    restored = NULL;
+    restored_count = 0;
+}
+
+// Record index of worker's section, written only by that worker
+struct snapshot_room *snapshot_record(int worker, int index) {
+    return (struct snapshot_room *)(mapping + SNAPSHOT_HEADER_SIZE + ((size_t)worker * rooms_per_worker + index) * room_size);
+}
+
+// Copy a room into its record. Players who have left have an empty slot
+void snapshot_write_room(struct snapshot_room *record, const struct room *room) {
+    __atomic_store_n(&record->sequence, record->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    record->id = room->id;
+    memcpy(record->goal_word, room->goal_word, sizeof(record->goal_word));
+    for (int i = 0; i < room->player_count; i++) {
+        struct snapshot_player *player = &record->players[i];
+        if (room->connections[i] == NULL && !room->detached[i]) {
+            player->token = 0;
+            continue;
+        }
+
+        player->token = room->tokens[i];
+        player->progress = room->progress[i];
+        player->guesses_left = room->guesses_left[i];
+        player->finished = room->game_finished[i];
+        player->score = room->leaderboard[i];
+        strncpy(player->name, room->player_names[i], sizeof(player->name) - 1);
+        player->name[sizeof(player->name) - 1] = '\0';
+    }
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&record->sequence, record->sequence + 1, __ATOMIC_RELAXED);
+}
+
+// Free a record once its game is over
+void snapshot_clear_room(struct snapshot_room *record) {
+    __atomic_store_n(&record->sequence, record->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->id = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&record->sequence, record->sequence + 1, __ATOMIC_RELAXED);
+}
+
+void snapshot_close(void) {
+    if (mapping != NULL) {
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+    }
+    if (snapshot_fd >= 0) {
+        close(snapshot_fd);
+        snapshot_fd = -1;
+    }
+    snapshot_free_restored();
+}
@@ -0,0 +1,54 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>     // Fixed width integer types (uint32_t, uint64_t)
+#include "room.h"       // Room and player state
+
+// Snapshot file layout, in host byte order: a SNAPSHOT_HEADER_SIZE byte header, then one section per
+// worker of rooms_per_worker room records of room_size bytes each. Every record is a snapshot_room
+// followed by player_count snapshot_player slots. Workers only write their own section
+#define SNAPSHOT_MAGIC "HMSNAP\0\0"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 64
+
+struct snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t worker_count;
+    uint32_t player_count;        // Slots in every room record
+    uint32_t rooms_per_worker;
+    uint32_t room_size;           // Bytes per room record
+    uint32_t reserved;
+};
+
+// A player slot. Slots without a player have a zero token
+struct snapshot_player {
+    uint64_t token;               // Resume token the player reattaches with
+    uint64_t progress;            // Revealed positions of the goal word, see struct room
+    int32_t guesses_left;
+    int32_t finished;
+    int32_t score;                // Final score, once finished
+    int32_t reserved;
+    char name[PLAYER_NAME_SIZE];
+};
+
+// A room whose game is in progress. The sequence is odd while the record is being written, so a
+// record torn by a crash is skipped when the snapshot is loaded. Free records have an id of 0
+struct snapshot_room {
+    uint32_t sequence;
+    int32_t id;
+    char goal_word[MAX_WORD_LENGTH + 1];
+    struct snapshot_player players[];
+};
+
+// Function Declarations
+int snapshot_open(const char *path, int worker_count, int player_count, int rooms_per_worker);
+int snapshot_restored_count(void);
+const struct snapshot_room *snapshot_restored(int index);
+void snapshot_free_restored(void);
+struct snapshot_room *snapshot_record(int worker, int index);
+void snapshot_write_room(struct snapshot_room *record, const struct room *room);
+void snapshot_clear_room(struct snapshot_room *record);
+void snapshot_close(void);
+
+#endif
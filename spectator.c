@@ -0,0 +1,130 @@
+#include <stddef.h>     // NULL
+#include "buffer.h"     // Shared output chunks
+#include "connection.h"
+#include "spectator.h"
+
+// Spectators watch a room from the worker that runs it. Event frames are encoded once, into the rooms
+// events chunk, as they happen. When the worker next flushes, that chunk is queued by reference on every
+// spectator, so thousands of spectators cost one encode per event and no copies of it
+
+static void unlink_publish(struct room *room) {
+    if (!room->publish_queued) {
+        return;
+    }
+
+    if (room->publish_prev != NULL) {
+        room->publish_prev->publish_next = room->publish_next;
+    } else {
+        *room->publish_list = room->publish_next;
+    }
+    if (room->publish_next != NULL) {
+        room->publish_next->publish_prev = room->publish_prev;
+    }
+    room->publish_prev = NULL;
+    room->publish_next = NULL;
+    room->publish_queued = 0;
+}
+
+static void schedule_publish(struct room *room) {
+    if (room->publish_queued) {
+        return;
+    }
+
+    room->publish_prev = NULL;
+    room->publish_next = *room->publish_list;
+    if (*room->publish_list != NULL) {
+        (*room->publish_list)->publish_prev = room;
+    }
+    *room->publish_list = room;
+    room->publish_queued = 1;
+}
+
+// Start sending the events of room to connection. The caller sends the state of the game so far, so
+// events encoded before this point go only to the spectators who were already watching
+void spectator_add(struct room *room, struct connection *connection) {
+    spectators_publish(room);
+
+    connection->room = room;
+    connection->player = 0;
+    connection->phase = PHASE_SPECTATING;
+    connection->lobby_prev = NULL;
+    connection->lobby_next = room->spectators;
+    if (room->spectators != NULL) {
+        room->spectators->lobby_prev = connection;
+    }
+    room->spectators = connection;
+    room->spectator_count++;
+}
+
+// Stop sending events to a spectator. Events it has already been queued are still written
+void spectator_remove(struct room *room, struct connection *connection) {
+    if (connection->lobby_prev != NULL) {
+        connection->lobby_prev->lobby_next = connection->lobby_next;
+    } else {
+        room->spectators = connection->lobby_next;
+    }
+    if (connection->lobby_next != NULL) {
+        connection->lobby_next->lobby_prev = connection->lobby_prev;
+    }
+    connection->lobby_prev = NULL;
+    connection->lobby_next = NULL;
+    connection->room = NULL;
+    room->spectator_count--;
+}
+
+// Space for an event frame of length bytes at the end of the rooms events. Returns NULL while nobody is
+// watching. If memory runs out every spectator is dropped on the next flush, as they would miss the event
+unsigned char *spectator_event_space(struct room *room, int length) {
+    if (room->spectators == NULL) {
+        return NULL;
+    }
+
+    struct output_chunk *events = room->events;
+    if (events != NULL && events->capacity - events->length < length) {
+        spectators_publish(room);
+        events = NULL;
+    }
+
+    if (events == NULL) {
+        events = output_chunk_create_shared(length > OUTPUT_CHUNK_SIZE ? length : OUTPUT_CHUNK_SIZE);
+        if (events == NULL) {
+            for (struct connection *connection = room->spectators; connection != NULL; connection = connection->lobby_next) {
+                connection->send_failed = 1;
+                connection_schedule_flush(connection);
+            }
+            return NULL;
+        }
+        room->events = events;
+        schedule_publish(room);
+    }
+
+    unsigned char *space = events->data + events->length;
+    events->length += length;
+    return space;
+}
+
+// Queue the events encoded so far on every spectator of room, sharing the one chunk
+void spectators_publish(struct room *room) {
+    struct output_chunk *events = room->events;
+
+    unlink_publish(room);
+    if (events == NULL) {
+        return;
+    }
+
+    room->events = NULL;
+    for (struct connection *connection = room->spectators; connection != NULL; connection = connection->lobby_next) {
+        if (output_queue_append_shared(&connection->output, events) < 0) {
+            connection->send_failed = 1;
+        }
+        connection_schedule_flush(connection);
+    }
+    output_chunk_release(events);
+}
+
+// Publish the events of every room on a workers publish list, before its connections are flushed
+void spectators_publish_all(struct room **publish_list) {
+    while (*publish_list != NULL) {
+        spectators_publish(*publish_list);
+    }
+}
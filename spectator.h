@@ -0,0 +1,14 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+struct room;
+struct connection;
+
+// Function Declarations
+void spectator_add(struct room *room, struct connection *connection);
+void spectator_remove(struct room *room, struct connection *connection);
+unsigned char *spectator_event_space(struct room *room, int length);
+void spectators_publish(struct room *room);
+void spectators_publish_all(struct room **publish_list);
+
+#endif
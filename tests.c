@@ -0,0 +1,816 @@
+#include <stdio.h>      // Standard input/output functions (printf, fprintf)
+#include <stdlib.h>     // Standard library functions (calloc, free, mkstemp)
+#include <string.h>     // String manipulation functions (memset, memcpy, strcmp)
+#include <unistd.h>     // POSIX API functions (read, write, close, dup2, unlink)
+#include <fcntl.h>      // File control options (fcntl, O_NONBLOCK)
+#include <sys/socket.h> // Connected socket pairs (socketpair)
+#include <signal.h>     // Signal handling (signal, SIG_IGN)
+#include "reactor.h"    // Event dispatch
+#include "connection.h" // Connections to frame input for
+#include "protocol.h"   // Frame parser
+#include "leaderboard.h" // Ranked scores
+#include "lobby.h"      // Match sizes
+#include "snapshot.h"   // Torn record detection
+#include "admission.h"  // Token bucket
+#include "game.h"       // Guess evaluation
+#include "buffer.h"     // Output chunk queue
+#include "names.h"      // Interned usernames
+#include "dictionary.h" // Word lists for bots to guess from
+#include "bot.h"        // Bot guesses
+
+// Unit tests, one function per module. Run with make check, exits non-zero if any check fails
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        checks++; \
+        if (!(condition)) { \
+            failures++; \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+// Function Declarations
+static void test_reactor_dispatch(void);
+static void test_frame_parser(void);
+static void test_leaderboard_order(void);
+static void test_lobby_match_size(void);
+static void test_snapshot_torn_records(void);
+static void test_admission_refill(void);
+static void test_timer_wheel(void);
+static void test_guess_masks(void);
+static void test_output_queue(void);
+static void test_name_claims(void);
+static void test_bot_guesses(void);
+static void test_difficulty_bands(void);
+
+int main(void) {
+    test_reactor_dispatch();
+    test_frame_parser();
+    test_leaderboard_order();
+    test_lobby_match_size();
+    test_snapshot_torn_records();
+    test_admission_refill();
+    test_timer_wheel();
+    test_guess_masks();
+    test_output_queue();
+    test_name_claims();
+    test_bot_guesses();
+    test_difficulty_bands();
+
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
+
+// Events seen by on_readable(), which drains the socket and stops the loop
+struct dispatched {
+    struct reactor *reactor;
+    int fd;
+    uint32_t events;
+    int calls;
+    int bytes;
+};
+
+static void on_readable(int fd, uint32_t events, void *arg) {
+    struct dispatched *dispatched = arg;
+    char bytes[64];
+    ssize_t received;
+
+    dispatched->fd = fd;
+    dispatched->events = events;
+    dispatched->calls++;
+    while ((received = read(fd, bytes, sizeof(bytes))) > 0) {
+        dispatched->bytes += received;
+    }
+    reactor_stop(dispatched->reactor);
+}
+
+static void test_reactor_dispatch(void) {
+    struct reactor reactor;
+    CHECK(reactor_init(&reactor, REACTOR_EPOLL) == 0);
+    CHECK(reactor.backend == REACTOR_EPOLL);
+
+    // A descriptor well past the initial handler table, so registering it has to grow the table
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    int fd = dup2(pair[0], 300);
+    CHECK(fd == 300);
+    close(pair[0]);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    struct dispatched dispatched = {&reactor, -1, 0, 0, 0};
+    CHECK(reactor_add(&reactor, fd, EPOLLIN | EPOLLRDHUP, on_readable, &dispatched) == 0);
+    CHECK(reactor.handler_capacity > fd);
+
+    // Data waiting is dispatched once to the handler registered for its fd
+    CHECK(write(pair[1], "hello", 5) == 5);
+    reactor_run(&reactor);
+    CHECK(dispatched.calls == 1 && dispatched.fd == fd && dispatched.bytes == 5);
+    CHECK((dispatched.events & EPOLLIN) != 0);
+
+    // Edge-triggered: once drained, only new data raises the next event
+    CHECK(write(pair[1], "again", 5) == 5);
+    reactor_run(&reactor);
+    CHECK(dispatched.calls == 2 && dispatched.bytes == 10);
+
+    // The peer closing is reported with the read side
+    close(pair[1]);
+    reactor_run(&reactor);
+    CHECK(dispatched.calls == 3 && (dispatched.events & EPOLLRDHUP) != 0);
+
+    reactor_close(&reactor, fd);
+    CHECK(reactor.handlers[fd].callback == NULL);
+    reactor_destroy(&reactor);
+}
+
+// Write bytes into the client end of the pair and read them into the connections input ring
+static void feed(struct connection *connection, int client, const void *bytes, size_t length) {
+    CHECK(write(client, bytes, length) == (ssize_t)length);
+    input_buffer_fill(&connection->input, connection->reactor, connection->fd, 0);
+}
+
+static void test_frame_parser(void) {
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    fcntl(pair[0], F_SETFL, O_NONBLOCK);
+
+    struct reactor reactor;
+    memset(&reactor, 0, sizeof(reactor));
+    reactor.backend = REACTOR_EPOLL; // Reads are plain readv() calls, nothing is registered
+    struct connection *flush_list = NULL;
+    struct connection *connection = connection_create(pair[0], &reactor, NULL, &flush_list);
+
+    char name[PLAYER_NAME_SIZE];
+    uint64_t request = 0;
+
+    // The hello and a name frame arriving a few bytes at a time
+    const unsigned char hello[] = {0, 'H', 'M', PROTOCOL_V2};
+    const unsigned char name_frame[] = {0, 4, MSG_NAME, 'A', 'd', 'a'};
+    feed(connection, pair[1], hello, 2);
+    CHECK(protocol_next_name(connection, name, sizeof(name), &request) == 0);
+    feed(connection, pair[1], hello + 2, 2);
+    feed(connection, pair[1], name_frame, 2);
+    CHECK(protocol_next_name(connection, name, sizeof(name), &request) == 0);
+    CHECK(connection->protocol == PROTOCOL_V2);
+    feed(connection, pair[1], name_frame + 2, 3);
+    CHECK(protocol_next_name(connection, name, sizeof(name), &request) == 0);
+    feed(connection, pair[1], name_frame + 5, 1);
+    CHECK(protocol_next_name(connection, name, sizeof(name), &request) == 1 && strcmp(name, "Ada") == 0);
+
+    // Frames pipelined together come out one at a time, a requeue request is noted whichever phase it lands in
+    const unsigned char pipelined[] = {0, 1, MSG_REQUEUE, 0, 1, MSG_READY, 0, 2, MSG_GUESS, 'E', 0, 2, MSG_GUESS, 'T'};
+    char guess = 0;
+    feed(connection, pair[1], pipelined, sizeof(pipelined));
+    CHECK(protocol_next_ready(connection) == 1 && connection->requeue);
+    CHECK(protocol_next_guess(connection, &guess) == 1 && guess == 'E');
+    CHECK(protocol_next_guess(connection, &guess) == 1 && guess == 'T');
+    CHECK(protocol_next_guess(connection, &guess) == 0);
+
+    // Frames wrapping around the end of the ring
+    for (int i = 0; i < INPUT_BUFFER_SIZE; i++) {
+        const unsigned char frame[] = {0, 2, MSG_GUESS, (unsigned char)('A' + i % 26)};
+        feed(connection, pair[1], frame, sizeof(frame));
+        CHECK(protocol_next_guess(connection, &guess) == 1 && guess == 'A' + i % 26);
+    }
+
+    // A resume token instead of a name
+    connection->protocol = PROTOCOL_V2;
+    const unsigned char resume[] = {0, 9, MSG_RESUME, 1, 2, 3, 4, 5, 6, 7, 8};
+    feed(connection, pair[1], resume, sizeof(resume));
+    CHECK(protocol_next_name(connection, name, sizeof(name), &request) == 2 && request == 0x0102030405060708ULL);
+
+    // A frame longer than PROTOCOL_MAX_PAYLOAD, or with no type byte, breaks the protocol straight from its header
+    const unsigned char oversized[] = {(PROTOCOL_MAX_PAYLOAD + 2) >> 8, (PROTOCOL_MAX_PAYLOAD + 2) & 0xFF, MSG_NAME};
+    feed(connection, pair[1], oversized, sizeof(oversized));
+    CHECK(protocol_next_name(connection, name, sizeof(name), &request) == -1);
+    input_buffer_skip(&connection->input, input_buffer_used(&connection->input));
+    const unsigned char empty[] = {0, 0, MSG_GUESS};
+    feed(connection, pair[1], empty, sizeof(empty));
+    CHECK(protocol_next_guess(connection, &guess) == -1);
+
+    // The largest frame allowed is accepted, and a name longer than the buffer is cut short
+    input_buffer_skip(&connection->input, input_buffer_used(&connection->input));
+    unsigned char largest[PROTOCOL_HEADER_SIZE + PROTOCOL_MAX_PAYLOAD] = {(PROTOCOL_MAX_PAYLOAD + 1) >> 8, (PROTOCOL_MAX_PAYLOAD + 1) & 0xFF, MSG_NAME};
+    memset(largest + PROTOCOL_HEADER_SIZE, 'x', PROTOCOL_MAX_PAYLOAD);
+    feed(connection, pair[1], largest, sizeof(largest));
+    CHECK(protocol_next_name(connection, name, sizeof(name), &request) == 1 && strlen(name) == sizeof(name) - 1);
+
+    connection_destroy(connection);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+static void test_leaderboard_order(void) {
+    struct leaderboard leaderboard;
+    CHECK(leaderboard_init(&leaderboard) == 0);
+
+    leaderboard_insert(&leaderboard, "carol", 30);
+    struct leaderboard_entry *bob = leaderboard_insert(&leaderboard, "bob", 50);
+    leaderboard_insert(&leaderboard, "alice", 30);
+    leaderboard_insert(&leaderboard, "dave", 10);
+
+    // Highest score first, equal scores by name
+    const char *expected[] = {"bob", "alice", "carol", "dave"};
+    int n = 0;
+    for (struct leaderboard_entry *entry = leaderboard_first(&leaderboard); entry != NULL; entry = leaderboard_next(entry)) {
+        CHECK(n < 4 && strcmp(entry->name, expected[n]) == 0);
+        CHECK(leaderboard_rank(&leaderboard, entry) == n + 1);
+        n++;
+    }
+    CHECK(n == 4);
+
+    // Adding to a total moves the entry to its new place
+    struct leaderboard_entry *dave = leaderboard_add_score(&leaderboard, "dave", 45, 1);
+    CHECK(dave != NULL && dave->score == 55 && dave->games == 1);
+    CHECK(leaderboard_rank(&leaderboard, dave) == 1);
+    CHECK(leaderboard_rank(&leaderboard, bob) == 2);
+    CHECK(leaderboard.length == 4);
+
+    char *text = NULL;
+    int capacity = 0;
+    CHECK(leaderboard_format(&leaderboard, 3, &text, &capacity) > 0 && strcmp(text, "dave:55,bob:50,alice:30,") == 0);
+    free(text);
+
+    leaderboard_remove(&leaderboard, bob);
+    CHECK(leaderboard_find(&leaderboard, "bob") == NULL);
+    CHECK(leaderboard_rank(&leaderboard, leaderboard_find(&leaderboard, "alice")) == 2);
+    leaderboard_destroy(&leaderboard);
+}
+
+static void test_lobby_match_size(void) {
+    struct lobby lobby;
+    struct connection players[4];
+    memset(players, 0, sizeof(players));
+    lobby_init(&lobby);
+
+    // Nobody queued, or fewer than the smallest game, never starts one
+    CHECK(lobby_match_size(&lobby, 0, 2, 4, 1000) == 0);
+    lobby_enter(&lobby, &players[0]);
+    lobby_enqueue(&lobby, &players[0], 100);
+    CHECK(lobby_match_size(&lobby, 5000, 2, 4, 1000) == 0);
+
+    // A smaller game waits until the longest waiting player has waited max_wait
+    lobby_enter(&lobby, &players[1]);
+    lobby_enqueue(&lobby, &players[1], 600);
+    CHECK(lobby_match_size(&lobby, 1099, 2, 4, 1000) == 0);
+    CHECK(lobby_match_size(&lobby, 1100, 2, 4, 1000) == 2);
+    CHECK(lobby_next_match(&lobby, 2, 1000) == 1100);
+
+    // A full game starts straight away
+    for (int i = 2; i < 4; i++) {
+        lobby_enter(&lobby, &players[i]);
+        lobby_enqueue(&lobby, &players[i], 700);
+    }
+    CHECK(lobby_match_size(&lobby, 700, 2, 4, 1000) == 4);
+    CHECK(lobby_match_size(&lobby, 700, 2, 3, 1000) == 3);
+
+    // Leaving the queue moves the wait on to the next player
+    CHECK(lobby_take(&lobby) == &players[0]);
+    CHECK(lobby_match_size(&lobby, 1100, 2, 4, 1000) == 0);
+    CHECK(lobby_match_size(&lobby, 1600, 2, 4, 1000) == 3);
+}
+
+static void test_snapshot_torn_records(void) {
+    char path[] = "/tmp/hangman_tests_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+
+    // Lay out a file for one worker of four 2 player rooms, the way snapshot_open() does
+    int player_count = 2;
+    size_t room_size = (sizeof(struct snapshot_room) + player_count * sizeof(struct snapshot_player) + 63) & ~(size_t)63;
+    size_t size = SNAPSHOT_HEADER_SIZE + 4 * room_size;
+    unsigned char *file = calloc(1, size);
+    struct snapshot_header *header = (struct snapshot_header *)file;
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->worker_count = 1;
+    header->player_count = player_count;
+    header->rooms_per_worker = 4;
+    header->room_size = room_size;
+
+    for (int i = 0; i < 4; i++) {
+        struct snapshot_room *record = (struct snapshot_room *)(file + SNAPSHOT_HEADER_SIZE + i * room_size);
+        record->sequence = 2;
+        record->id = i + 1;
+        strcpy(record->goal_word, "HANGMAN");
+        record->players[0].token = 100 + i;
+        record->players[0].guesses_left = 5;
+        strcpy(record->players[0].name, "Ada");
+    }
+    struct snapshot_room *torn = (struct snapshot_room *)(file + SNAPSHOT_HEADER_SIZE + 1 * room_size);
+    torn->sequence = 3; // Caught mid write
+    struct snapshot_room *unterminated = (struct snapshot_room *)(file + SNAPSHOT_HEADER_SIZE + 2 * room_size);
+    memset(unterminated->players[0].name, 'x', sizeof(unterminated->players[0].name));
+    struct snapshot_room *empty = (struct snapshot_room *)(file + SNAPSHOT_HEADER_SIZE + 3 * room_size);
+    empty->players[0].token = 0;
+
+    CHECK(write(fd, file, size) == (ssize_t)size);
+    close(fd);
+    free(file);
+
+    // Only the first record is whole, holds a game and has every field in range
+    CHECK(snapshot_open(path, 1, player_count, 4) == 0);
+    CHECK(snapshot_restored_count() == 1);
+    CHECK(snapshot_restored(0)->id == 1);
+    snapshot_free_restored();
+    snapshot_close();
+    unlink(path);
+}
+
+static void test_admission_refill(void) {
+    struct admission admission;
+    int admitted = 0;
+
+    // 1000 connections/s: a burst of ADMISSION_BURST_MS worth, then one more per millisecond
+    admission_init(&admission, 1000, 1000000, 0);
+    while (admission_check(&admission, 0, 0) == ADMIT) {
+        admitted++;
+    }
+    CHECK(admitted == 1000 * ADMISSION_BURST_MS / 1000);
+    CHECK(admission_check(&admission, 0, 999) == SHED_RATE);
+    CHECK(admission_check(&admission, 0, 1000) == ADMIT);
+    CHECK(admission_check(&admission, 0, 1000) == SHED_RATE);
+
+    // Refilling stops at the burst size however long the bucket sat full
+    admitted = 0;
+    while (admission_check(&admission, 0, 60000000) == ADMIT) {
+        admitted++;
+    }
+    CHECK(admitted == 1000 * ADMISSION_BURST_MS / 1000);
+
+    // A rate below one per burst still lets one connection through, then refills a fraction at a time
+    admission_init(&admission, 2, 1000000, 0);
+    CHECK(admission_check(&admission, 0, 0) == ADMIT);
+    CHECK(admission_check(&admission, 0, 499999) == SHED_RATE);
+    CHECK(admission_check(&admission, 0, 500000) == ADMIT);
+
+    // A full lobby sheds whatever the bucket holds, and every shed connection is reported
+    admission_init(&admission, 0, 10, 0);
+    CHECK(admission_check(&admission, 9, 0) == ADMIT);
+    CHECK(admission_check(&admission, 10, 0) == SHED_LOBBY_FULL);
+    CHECK(admission_take_report(&admission, 1000) == 0);
+    CHECK(admission_take_report(&admission, ADMISSION_REPORT_MS * 1000) == 1);
+}
+
+// A timer that records the tick it fired on
+struct test_timer {
+    struct reactor_timer timer;
+    struct reactor *reactor;
+    uint64_t fired_on;
+    int fired;
+};
+
+static void on_timer(void *arg) {
+    struct test_timer *test = arg;
+    test->fired++;
+    test->fired_on = test->reactor->current_tick;
+}
+
+static void stop_reactor(void *arg) {
+    reactor_stop(arg);
+}
+
+// Run the loop through the next ticks ticks without waiting for them, by moving the reactors start back
+static void advance(struct reactor *reactor, uint64_t ticks) {
+    struct reactor_timer stop;
+    reactor_timer_init(&stop, stop_reactor, reactor);
+    reactor_timer_arm(reactor, &stop, ticks * REACTOR_TICK_MS);
+    reactor->start_ms -= ticks * REACTOR_TICK_MS;
+    reactor_run(reactor);
+}
+
+static void test_timer_wheel(void) {
+    struct reactor reactor;
+    CHECK(reactor_init(&reactor, REACTOR_EPOLL) == 0);
+
+    // Delays either side of each level's span, so timers start on all four levels and fire on the ticks where
+    // levels 1, 2 and 3 cascade. Then many more at random delays, every other one cancelled
+    const uint64_t edges[] = {1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 8192, 262143, 262144, 262145, 524288,
+                              (1 << 24) - 64, (1 << 24) - 2};
+    int edge_count = sizeof(edges) / sizeof(edges[0]);
+    int count = edge_count + 100000;
+    struct test_timer *timers = calloc(count, sizeof(struct test_timer));
+    int unarmed = 0;
+    srand(1);
+    for (int i = 0; i < count; i++) {
+        uint64_t ticks = i < edge_count ? edges[i] : 1 + (uint64_t)rand() % ((1 << 24) - 2);
+        timers[i].reactor = &reactor;
+        reactor_timer_init(&timers[i].timer, on_timer, &timers[i]);
+        reactor_timer_arm(&reactor, &timers[i].timer, ticks * REACTOR_TICK_MS);
+        unarmed += !reactor_timer_armed(&timers[i].timer);
+    }
+    CHECK(unarmed == 0 && reactor.timer_count == count);
+
+    int levels_used[REACTOR_WHEEL_LEVELS] = {0};
+    for (int level = 0; level < REACTOR_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < REACTOR_WHEEL_SIZE; slot++) {
+            levels_used[level] |= reactor.wheel[level][slot] != NULL;
+        }
+    }
+    CHECK(levels_used[0] && levels_used[1] && levels_used[2] && levels_used[3]);
+
+    for (int i = edge_count; i < count; i += 2) {
+        reactor_timer_cancel(&reactor, &timers[i].timer);
+        unarmed += !reactor_timer_armed(&timers[i].timer);
+    }
+    CHECK(unarmed == (count - edge_count + 1) / 2);
+    reactor_timer_cancel(&reactor, &timers[edge_count].timer); // Cancelling twice does nothing
+    CHECK(reactor.timer_count == count - (count - edge_count + 1) / 2);
+
+    // Re-arming moves a timer rather than adding it again
+    reactor_timer_arm(&reactor, &timers[0].timer, 5 * REACTOR_TICK_MS);
+    CHECK(reactor.timer_count == count - (count - edge_count + 1) / 2);
+
+    // Partway through, timers due so far have fired and none due later has
+    advance(&reactor, 4096);
+    int early = 0;
+    int late = 0;
+    for (int i = 0; i < count; i++) {
+        if (timers[i].fired && timers[i].timer.expires > reactor.current_tick) {
+            early++;
+        }
+        if (!timers[i].fired && reactor_timer_armed(&timers[i].timer) && timers[i].timer.expires <= reactor.current_tick) {
+            late++;
+        }
+    }
+    CHECK(early == 0 && late == 0);
+    CHECK(timers[0].fired == 1 && timers[0].fired_on == timers[0].timer.expires);
+
+    // Run the wheel all the way round: every armed timer fires once, on its tick, and no cancelled one does
+    advance(&reactor, 1 << 24);
+    int wrong = 0;
+    for (int i = 0; i < count; i++) {
+        int cancelled = i >= edge_count && (i - edge_count) % 2 == 0;
+        if (cancelled ? timers[i].fired != 0 : timers[i].fired != 1 || timers[i].fired_on != timers[i].timer.expires) {
+            wrong++;
+        }
+    }
+    CHECK(wrong == 0);
+    CHECK(reactor.timer_count == 0);
+
+    free(timers);
+    reactor_destroy(&reactor);
+}
+
+static void test_guess_masks(void) {
+    struct game_word word;
+    uint64_t progress = 0;
+
+    CHECK(game_word_init(&word, "") == -1);
+    CHECK(game_word_init(&word, "BANANA") == 0);
+    CHECK(word.length == 6 && word.complete_mask == 0x3F);
+
+    // Each guess reveals every position of its letter, a wrong one reveals nothing
+    CHECK(evaluate_guess(&word, &progress, 'A') == 0x2A && progress == 0x2A);
+    CHECK(evaluate_guess(&word, &progress, 'Z') == 0 && progress == 0x2A);
+    CHECK(!is_word_guessed(&word, progress));
+    CHECK(evaluate_guess(&word, &progress, 'N') == 0x14);
+    // Guessing a letter again reveals it again but changes nothing
+    CHECK(evaluate_guess(&word, &progress, 'A') == 0x2A && progress == 0x3E);
+    CHECK(evaluate_guess(&word, &progress, 'B') == 0x01);
+    CHECK(is_word_guessed(&word, progress));
+
+    // The longest word fills the whole mask, one letter longer doesn't fit
+    char longest[MAX_WORD_LENGTH + 2];
+    memset(longest, 'Q', MAX_WORD_LENGTH);
+    longest[MAX_WORD_LENGTH - 1] = 'U';
+    longest[MAX_WORD_LENGTH] = '\0';
+    CHECK(game_word_init(&word, longest) == 0 && word.complete_mask == ~(uint64_t)0);
+    progress = 0;
+    CHECK(evaluate_guess(&word, &progress, 'U') == (uint64_t)1 << 63);
+    evaluate_guess(&word, &progress, 'Q');
+    CHECK(is_word_guessed(&word, progress));
+    longest[MAX_WORD_LENGTH] = 'Q';
+    longest[MAX_WORD_LENGTH + 1] = '\0';
+    CHECK(game_word_init(&word, longest) == -1);
+}
+
+// Append length bytes continuing the test pattern to a queue and to the copy of what should arrive
+static void queue_pattern(struct output_queue *queue, unsigned char *expected, size_t *queued, int length) {
+    unsigned char message[16384];
+    for (int i = 0; i < length; i++) {
+        message[i] = (unsigned char)((*queued + i) % 251);
+    }
+    memcpy(expected + *queued, message, length);
+    *queued += length;
+    CHECK(output_queue_append(queue, message, length) == 0);
+}
+
+static void test_output_queue(void) {
+    signal(SIGPIPE, SIG_IGN);
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    fcntl(pair[0], F_SETFL, O_NONBLOCK);
+    fcntl(pair[1], F_SETFL, O_NONBLOCK);
+
+    struct reactor reactor;
+    memset(&reactor, 0, sizeof(reactor));
+    reactor.backend = REACTOR_EPOLL; // Writes are plain writev() calls
+    struct output_queue queue;
+    struct output_queue other;
+    output_queue_init(&queue);
+    output_queue_init(&other);
+
+    size_t total = 2 * 1024 * 1024;
+    unsigned char *expected = malloc(total);
+    unsigned char *received = malloc(total);
+    size_t queued = 0;
+
+    // Small messages are packed into one chunk, a large one gets a chunk of its own
+    for (int i = 0; i < 100; i++) {
+        queue_pattern(&queue, expected, &queued, 10);
+    }
+    CHECK(queue.count == 1 && queue.pending == 1000);
+    queue_pattern(&queue, expected, &queued, 10000);
+    CHECK(queue.count == 2 && queue.pending == 11000);
+
+    // A shared chunk is referenced, not copied, and nothing is packed into it afterwards
+    struct output_chunk *shared = output_chunk_create_shared(64);
+    for (int i = 0; i < 64; i++) {
+        shared->data[i] = (unsigned char)((queued + i) % 251);
+    }
+    shared->length = 64;
+    memcpy(expected + queued, shared->data, 64);
+    queued += 64;
+    CHECK(output_queue_append_shared(&queue, shared) == 0 && output_queue_append_shared(&other, shared) == 0);
+    CHECK(shared->refs == 3);
+    queue_pattern(&queue, expected, &queued, 10);
+    CHECK(queue.count == 4);
+
+    // Enough full chunks to grow the ring, pass OUTPUT_MAX_IOVECS and fill the socket
+    while (queued + OUTPUT_CHUNK_SIZE <= total) {
+        queue_pattern(&queue, expected, &queued, OUTPUT_CHUNK_SIZE);
+    }
+    CHECK(queue.capacity > OUTPUT_MAX_IOVECS && queue.pending == queued);
+
+    // Flush while the peer reads: the socket fills, writes are cut short part way into a chunk, and what
+    // arrives is every byte queued, in order
+    size_t read_total = 0;
+    int pending_seen = 0;
+    int offset_seen = 0;
+    enum output_status status;
+    for (;;) {
+        status = output_queue_flush(&queue, &reactor, pair[0]);
+        ssize_t n;
+        while ((n = read(pair[1], received + read_total, total - read_total)) > 0) {
+            read_total += n;
+        }
+        if (status != OUTPUT_PENDING) {
+            break;
+        }
+        pending_seen++;
+        offset_seen |= queue.offset > 0;
+        CHECK(queue.pending <= queued - read_total);
+    }
+    CHECK(status == OUTPUT_FLUSHED && pending_seen > 0 && offset_seen);
+    CHECK(queue.count == 0 && queue.pending == 0 && queue.spare != NULL);
+    CHECK(read_total == queued && memcmp(received, expected, queued) == 0);
+
+    // Written shared chunks are released by each queue in turn
+    CHECK(shared->refs == 2);
+    output_queue_destroy(&other);
+    CHECK(shared->refs == 1);
+    output_chunk_release(shared);
+
+    // Once the peer has gone, flushing reports an error
+    close(pair[1]);
+    queued = 0;
+    queue_pattern(&queue, expected, &queued, 10);
+    CHECK(output_queue_flush(&queue, &reactor, pair[0]) == OUTPUT_ERROR);
+
+    output_queue_destroy(&queue);
+    close(pair[0]);
+    free(expected);
+    free(received);
+}
+
+static int compare_pointers(const void *a, const void *b) {
+    const char *x = *(const char *const *)a;
+    const char *y = *(const char *const *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void test_name_claims(void) {
+    const char *ada = NULL;
+    const char *other = NULL;
+
+    // A name is held by one claim unless duplicates are allowed, which share the same copy
+    CHECK(names_claim("Ada", 0, &ada) == NAME_CLAIMED && strcmp(ada, "Ada") == 0);
+    CHECK(names_claim("Ada", 0, &other) == NAME_TAKEN && other == NULL);
+    CHECK(names_claim("Ada", 1, &other) == NAME_CLAIMED && other == ada);
+    names_release(other);
+    CHECK(names_claim("Ada", 0, &other) == NAME_TAKEN);
+
+    // Once the last claim is given up the name is free, and its entry is reused by the next claim
+    const char *old = ada;
+    names_release(ada);
+    CHECK(names_claim("Ada", 0, &ada) == NAME_CLAIMED && ada == old);
+    names_release(ada);
+
+    // Many names at once: all distinct, all refused a second time, and all claimed again from the same entries
+    // once released
+    enum { COUNT = 20000 };
+    const char **first = malloc(COUNT * sizeof(const char *));
+    const char **second = malloc(COUNT * sizeof(const char *));
+    char name[32];
+    int claimed = 0;
+    int taken = 0;
+    for (int i = 0; i < COUNT; i++) {
+        snprintf(name, sizeof(name), "player%d", i);
+        claimed += names_claim(name, 0, &first[i]) == NAME_CLAIMED && strcmp(first[i], name) == 0;
+    }
+    for (int i = 0; i < COUNT; i++) {
+        snprintf(name, sizeof(name), "player%d", i);
+        taken += names_claim(name, 0, &other) == NAME_TAKEN;
+    }
+    CHECK(claimed == COUNT && taken == COUNT);
+    qsort(first, COUNT, sizeof(const char *), compare_pointers);
+    int distinct = 1;
+    for (int i = 1; i < COUNT; i++) {
+        distinct &= first[i] != first[i - 1];
+    }
+    CHECK(distinct);
+
+    for (int i = 0; i < COUNT; i++) {
+        names_release(first[i]);
+    }
+    claimed = 0;
+    for (int i = 0; i < COUNT; i++) {
+        snprintf(name, sizeof(name), "player%d", i);
+        claimed += names_claim(name, 0, &second[i]) == NAME_CLAIMED;
+    }
+    qsort(second, COUNT, sizeof(const char *), compare_pointers);
+    CHECK(claimed == COUNT && memcmp(first, second, COUNT * sizeof(const char *)) == 0);
+    for (int i = 0; i < COUNT; i++) {
+        names_release(second[i]);
+    }
+    free(first);
+    free(second);
+
+    // A name too long for any size class has an entry of its own, and is free again once released
+    char long_name[200];
+    memset(long_name, 'L', sizeof(long_name) - 1);
+    long_name[sizeof(long_name) - 1] = '\0';
+    CHECK(names_claim(long_name, 0, &other) == NAME_CLAIMED && strcmp(other, long_name) == 0);
+    CHECK(names_claim(long_name, 0, &ada) == NAME_TAKEN);
+    names_release(other);
+    CHECK(names_claim(long_name, 0, &other) == NAME_CLAIMED);
+    names_release(other);
+}
+
+// Load a word list written out to a temporary file
+static int load_words(const char *text) {
+    char path[] = "/tmp/hangman_tests_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0 && write(fd, text, strlen(text)) == (ssize_t)strlen(text));
+    close(fd);
+    int result = dictionary_load(path);
+    unlink(path);
+    return result;
+}
+
+// Play a bot against word until it has guessed it. Returns the wrong guesses it made, or -1 if it ran out of letters
+static int play_bot(struct bot *bot, const char *word) {
+    struct game_word goal;
+    uint64_t progress = 0;
+    int wrong = 0;
+    game_word_init(&goal, word);
+
+    while (!is_word_guessed(&goal, progress)) {
+        char guess = bot_next_guess(bot);
+        if (guess == 0) {
+            return -1;
+        }
+        uint64_t revealed = evaluate_guess(&goal, &progress, guess);
+        bot_observe(bot, guess, revealed);
+        wrong += revealed == 0;
+    }
+    return wrong;
+}
+
+static void test_bot_guesses(void) {
+    CHECK(load_words("[test]\nCRANE\nCRATE\nTRACE\nGRACE\nBRAVE\nPLANT\nZZZ\nQUIZ\nJAZZY\n") == 0);
+
+    // The first guess is the letter in the most candidates of the goal words length: A is in all six five
+    // letter words, the other lengths don't count
+    struct bot *bot = bot_create(NULL, 0, 5, NULL);
+    CHECK(bot_next_guess(bot) == 'A' && bot->filter.count == 7);
+    bot_observe(bot, 'A', 0x04);
+    CHECK(bot_next_guess(bot) == 'E' && bot->filter.count == 6);
+
+    // A wrong letter drops every candidate containing it, and revealed letters drop those without them in place
+    bot_observe(bot, 'E', 0);
+    CHECK(bot_next_guess(bot) == 'T' && bot->filter.count == 1);
+    bot_destroy(bot);
+
+    // Every word is solved, with no more wrong guesses than it had rival candidates, and the last guess leaves
+    // only the goal word
+    const char *words[] = {"CRANE", "CRATE", "TRACE", "GRACE", "BRAVE", "PLANT", "JAZZY"};
+    for (int i = 0; i < 7; i++) {
+        bot = bot_create(NULL, 0, 5, NULL);
+        int wrong = play_bot(bot, words[i]);
+        CHECK(wrong >= 0 && wrong < 7);
+        bot_next_guess(bot);
+        CHECK(bot->filter.count == 1);
+        bot_destroy(bot);
+    }
+
+    // A word the dictionary doesn't have is still solved, from letter frequency once no candidate fits
+    bot = bot_create(NULL, 0, 5, NULL);
+    CHECK(play_bot(bot, "XYLYL") >= 0 && bot->filter.count == 0);
+    bot_destroy(bot);
+
+    // Reloading the dictionary rebuilds the candidates from the new words
+    bot = bot_create(NULL, 0, 5, NULL);
+    CHECK(bot_next_guess(bot) == 'A');
+    bot_observe(bot, 'A', 0);
+    CHECK(bot_next_guess(bot) == 'E' && bot->filter.count == 0);
+    CHECK(load_words("[test]\nOTTER\nOLIVE\nMOTOR\nROBOT\n") == 0);
+    bot_observe(bot, 'E', 0);
+    CHECK(bot_next_guess(bot) == 'T' && bot->filter.count == 2);
+    bot_destroy(bot);
+    dictionary_unload();
+
+    // Every slot a room can have gets its own bot name, numbered once the names start to repeat
+    struct bot *bots[PROTOCOL_MAX_PLAYERS];
+    int duplicates = 0;
+    for (int i = 0; i < PROTOCOL_MAX_PLAYERS; i++) {
+        bots[i] = bot_create(NULL, i, 5, NULL);
+        for (int j = 0; j < i; j++) {
+            duplicates += strcmp(bots[i]->name, bots[j]->name) == 0;
+        }
+    }
+    CHECK(duplicates == 0 && bot_name_reserved(bots[PROTOCOL_MAX_PLAYERS - 1]->name));
+    CHECK(strcmp(bots[3]->name, BOT_NAME_PREFIX "Edsger") == 0);
+    CHECK(strcmp(bots[19]->name, BOT_NAME_PREFIX "Edsger 19") == 0);
+    for (int i = 0; i < PROTOCOL_MAX_PLAYERS; i++) {
+        bot_destroy(bots[i]);
+    }
+}
+
+static void test_difficulty_bands(void) {
+    const char *words[] = {"BALL", "BELL", "BILL", "BULL", "CALL", "CELL", "FALL", "FELL", "FILL", "FULL",
+                           "HALL", "HELL", "HILL", "HULL", "MALL", "MILL", "PILL", "POLL", "PULL", "TALL",
+                           "TELL", "TILL", "TOLL", "WALL", "WELL", "WILL", "QUIZ", "JAZZ", "FUZZ", "BUZZ"};
+    enum { WORDS = sizeof(words) / sizeof(words[0]) };
+    char list[WORDS * 5 + 16] = "[test]\n";
+    for (int i = 0; i < WORDS; i++) {
+        strcat(list, words[i]);
+        strcat(list, "\n");
+    }
+    CHECK(load_words(list) == 0);
+    CHECK(dictionary_find_band("easy") == DICTIONARY_EASY && dictionary_find_band("hard") == DICTIONARY_HARD);
+    CHECK(dictionary_find_band("impossible") == DICTIONARY_ANY);
+
+    // A words score counts the wrong guesses a bot makes on it, so replay one on each word
+    int wrong[WORDS];
+    for (int i = 0; i < WORDS; i++) {
+        struct bot *bot = bot_create(NULL, 0, 4, NULL);
+        wrong[i] = play_bot(bot, words[i]);
+        bot_destroy(bot);
+    }
+
+    // Find each words band by drawing from every band until all of its words have come up
+    int band_of[WORDS];
+    int band_size[DICTIONARY_BANDS] = {0};
+    int misdrawn = 0;
+    unsigned int seed = 1;
+    char word[MAX_WORD_LENGTH + 1];
+    for (int i = 0; i < WORDS; i++) {
+        band_of[i] = -1;
+    }
+    for (int band = 0; band < DICTIONARY_BANDS; band++) {
+        for (int draw = 0; draw < 2000; draw++) {
+            misdrawn += dictionary_random_word(word, sizeof(word), &seed, DICTIONARY_ANY, DICTIONARY_ANY, band) != 4;
+            for (int i = 0; i < WORDS; i++) {
+                if (strcmp(word, words[i]) == 0 && band_of[i] != band) {
+                    misdrawn += band_of[i] != -1;
+                    band_of[i] = band;
+                    band_size[band]++;
+                }
+            }
+        }
+    }
+
+    CHECK(misdrawn == 0);
+
+    // Every word is in one band, the bands are a third each, and no word is in an easier band than a word
+    // the bot got wrong more often
+    for (int i = 0; i < WORDS; i++) {
+        CHECK(band_of[i] != -1 && wrong[i] >= 0);
+    }
+    CHECK(band_size[0] == WORDS / 3 && band_size[1] == WORDS / 3 && band_size[2] == WORDS / 3);
+    int misordered = 0;
+    for (int i = 0; i < WORDS; i++) {
+        for (int j = 0; j < WORDS; j++) {
+            misordered += band_of[i] < band_of[j] && wrong[i] > wrong[j];
+        }
+    }
+    CHECK(misordered == 0);
+
+    // The bands are restrictions like any other: a length that none of a band has finds nothing
+    CHECK(dictionary_random_word(word, sizeof(word), &seed, 5, DICTIONARY_ANY, DICTIONARY_EASY) == -1);
+    dictionary_unload();
+}
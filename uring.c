@@ -0,0 +1,281 @@
+#include <stdlib.h>     // Standard library functions (calloc, free)
+#include <stdint.h>     // Pointer sized integers (uintptr_t)
+#include <string.h>     // String manipulation functions (memset)
+#include <unistd.h>     // POSIX API functions (close, syscall)
+#include <errno.h>      // Error codes (EINTR, ETIME)
+#include <sys/mman.h>   // Shared ring mappings (mmap, munmap)
+#include <sys/syscall.h> // io_uring system call numbers
+#include "uring.h"
+
+static int sys_setup(unsigned int entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, void *arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int sys_register(int fd, unsigned int opcode, void *arg, unsigned int count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+// Create a ring with room for entries submissions. Completions only run when the ring is entered by
+// the thread that issues its requests (DEFER_TASKRUN), so a burst of them is reaped in one go. That thread
+// is the one that calls uring_enable(), so the ring can be set up before it is handed to its thread.
+// Kernels without those flags get a plain ring. Returns 0, or -1 with errno set
+int uring_init(struct uring *ring, unsigned int entries) {
+    static const unsigned int flag_sets[] = {
+        IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED | IORING_SETUP_CQSIZE,
+        IORING_SETUP_COOP_TASKRUN | IORING_SETUP_CQSIZE,
+        IORING_SETUP_CQSIZE
+    };
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    for (size_t i = 0; i < sizeof(flag_sets) / sizeof(flag_sets[0]) && ring->fd < 0; i++) {
+        memset(&params, 0, sizeof(params));
+        params.flags = flag_sets[i];
+        params.cq_entries = entries * 4; // Multishot operations post many completions per submission
+        ring->fd = sys_setup(entries, &params);
+    }
+    if (ring->fd < 0) {
+        return -1;
+    }
+    ring->features = params.features;
+    ring->disabled = (params.flags & IORING_SETUP_R_DISABLED) != 0;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        uring_destroy(ring);
+        return -1;
+    }
+    if (ring->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            uring_destroy(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_destroy(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring;
+    ring->sq_head = (unsigned int *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+    ring->sq_mask = *(unsigned int *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sqe_tail = *ring->sq_tail;
+
+    char *cq = ring->cq_ring;
+    ring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned int *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Submission slot i always holds sqe i
+    for (unsigned int i = 0; i < ring->sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+    return 0;
+}
+
+void uring_destroy(struct uring *ring) {
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+// Start the ring if it was created disabled, making the calling thread the only one that may submit to it.
+// Returns 0, or -1 with errno set
+int uring_enable(struct uring *ring) {
+    if (!ring->disabled) {
+        return 0;
+    }
+    if (sys_register(ring->fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0) < 0) {
+        return -1;
+    }
+    ring->disabled = 0;
+    return 0;
+}
+
+// Whether the kernel knows opcode. Returns 0 if it doesn't, or can't say
+int uring_supports(struct uring *ring, int opcode) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (probe == NULL) {
+        return 0;
+    }
+
+    int supported = 0;
+    if (sys_register(ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0 && opcode <= probe->last_op) {
+        supported = (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    free(probe);
+    return supported;
+}
+
+// Next free submission entry, cleared, or NULL if every entry is waiting to be submitted
+struct io_uring_sqe *uring_get_sqe(struct uring *ring) {
+    unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Publish every entry handed out and enter the kernel once: submitting them, and if wait_for is set
+// waiting up to timeout_ms (-1 for no limit) for that many completions.
+// Returns 0, or -1 with errno set. Running out of time is not an error
+int uring_submit(struct uring *ring, unsigned int wait_for, int timeout_ms) {
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    unsigned int to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec timeout;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    unsigned int flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    if (wait_for > 0 && timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (unsigned long long)(uintptr_t)&timeout;
+    }
+
+    for (;;) {
+        int result = sys_enter(ring->fd, to_submit, wait_for, flags, &arg, sizeof(arg));
+        if (result >= 0) {
+            return 0;
+        }
+        if (errno == ETIME) {
+            return 0;
+        }
+        if (errno == EINTR) {
+            to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        if (errno == EBUSY || errno == EAGAIN) {
+            // Too many completions waiting, they are reaped before anything else is submitted
+            return 0;
+        }
+        return -1;
+    }
+}
+
+// Oldest completion not yet seen, or NULL
+struct io_uring_cqe *uring_peek_cqe(struct uring *ring) {
+    unsigned int head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void uring_cqe_seen(struct uring *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// Map entries buffers of buffer_size bytes, hand them all to the kernel and register them as group.
+// Returns 0, or -1 with errno set
+int uring_buffers_init(struct uring *ring, struct uring_buffers *buffers, int group, unsigned int entries, size_t buffer_size) {
+    memset(buffers, 0, sizeof(*buffers));
+    buffers->entries = entries;
+    buffers->group = group;
+    buffers->buffer_size = buffer_size;
+
+    buffers->ring_size = entries * sizeof(struct io_uring_buf);
+    buffers->ring = mmap(NULL, buffers->ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers->ring == MAP_FAILED) {
+        buffers->ring = NULL;
+        return -1;
+    }
+    buffers->data = mmap(NULL, entries * buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers->data == MAP_FAILED) {
+        buffers->data = NULL;
+        uring_buffers_destroy(ring, buffers);
+        return -1;
+    }
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (unsigned long long)(uintptr_t)buffers->ring;
+    registration.ring_entries = entries;
+    registration.bgid = (unsigned short)group;
+    if (sys_register(ring->fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        uring_buffers_destroy(ring, buffers);
+        return -1;
+    }
+
+    for (unsigned int id = 0; id < entries; id++) {
+        uring_buffers_add(buffers, (int)id);
+    }
+    uring_buffers_publish(buffers);
+    return 0;
+}
+
+void uring_buffers_destroy(struct uring *ring, struct uring_buffers *buffers) {
+    if (buffers->ring != NULL && ring->fd >= 0) {
+        struct io_uring_buf_reg registration;
+        memset(&registration, 0, sizeof(registration));
+        registration.bgid = (unsigned short)buffers->group;
+        sys_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+    }
+    if (buffers->data != NULL) {
+        munmap(buffers->data, buffers->entries * buffers->buffer_size);
+    }
+    if (buffers->ring != NULL) {
+        munmap(buffers->ring, buffers->ring_size);
+    }
+    memset(buffers, 0, sizeof(*buffers));
+}
+
+char *uring_buffer(struct uring_buffers *buffers, int id) {
+    return buffers->data + (size_t)id * buffers->buffer_size;
+}
+
+// Give buffer id back to the kernel. It can be picked again once uring_buffers_publish() is called
+void uring_buffers_add(struct uring_buffers *buffers, int id) {
+    struct io_uring_buf *entry = &buffers->ring->bufs[buffers->tail & (buffers->entries - 1)];
+    entry->addr = (unsigned long long)(uintptr_t)uring_buffer(buffers, id);
+    entry->len = (unsigned int)buffers->buffer_size;
+    entry->bid = (unsigned short)id;
+    buffers->tail++;
+}
+
+void uring_buffers_publish(struct uring_buffers *buffers) {
+    __atomic_store_n(&buffers->ring->tail, buffers->tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,63 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>     // Size type (size_t)
+#include <linux/io_uring.h> // Ring layout, opcodes and flags
+
+// Minimal io_uring over the raw system calls: the shared submission and completion rings and a
+// provided buffer ring. Only the owning thread may use it
+
+struct uring {
+    int fd;
+    unsigned int features;
+    int disabled;               // Created with IORING_SETUP_R_DISABLED, nothing is submitted until uring_enable()
+
+    // Submission queue, sqe_tail counts entries handed out but not yet published to the kernel
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_array;
+    unsigned int sq_mask;
+    unsigned int sq_entries;
+    unsigned int sqe_tail;
+    struct io_uring_sqe *sqes;
+
+    // Completion queue
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;              // Same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+// Buffers the kernel picks from for receives that set IOSQE_BUFFER_SELECT, see IORING_REGISTER_PBUF_RING
+struct uring_buffers {
+    struct io_uring_buf_ring *ring;
+    size_t ring_size;
+    unsigned int entries;       // A power of two
+    unsigned short tail;        // Local tail, published by uring_buffers_publish()
+    int group;
+    char *data;                 // entries buffers of buffer_size bytes each
+    size_t buffer_size;
+};
+
+// Function Declarations
+int uring_init(struct uring *ring, unsigned int entries);
+void uring_destroy(struct uring *ring);
+int uring_enable(struct uring *ring);
+int uring_supports(struct uring *ring, int opcode);
+struct io_uring_sqe *uring_get_sqe(struct uring *ring);
+int uring_submit(struct uring *ring, unsigned int wait_for, int timeout_ms);
+struct io_uring_cqe *uring_peek_cqe(struct uring *ring);
+void uring_cqe_seen(struct uring *ring);
+int uring_buffers_init(struct uring *ring, struct uring_buffers *buffers, int group, unsigned int entries, size_t buffer_size);
+void uring_buffers_destroy(struct uring *ring, struct uring_buffers *buffers);
+char *uring_buffer(struct uring_buffers *buffers, int id);
+void uring_buffers_add(struct uring_buffers *buffers, int id);
+void uring_buffers_publish(struct uring_buffers *buffers);
+
+#endif